@@ -0,0 +1,91 @@
+/* bootloader_start.c
+ *
+ * The stock ESP-IDF bootloader entry, plus one decision: boot factory
+ * directly when recovery is requested. The main app is never loaded, so
+ * entering recovery costs no main-app boot.
+ */
+
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "bootloader_init.h"
+#include "bootloader_utility.h"
+#include "bootloader_common.h"
+#include "recovery_mailbox.h"
+
+static const char *TAG = "boot";
+
+static recovery_entry_t recovery_requested(const recovery_mailbox_t *mb);
+
+void __attribute__((noreturn)) call_start_cpu0(void)
+{
+    // 1. Hardware initialization
+    if (bootloader_init() != ESP_OK)
+        bootloader_reset();
+
+#ifdef CONFIG_BOOTLOADER_SKIP_VALIDATE_IN_DEEP_SLEEP
+    bootloader_utility_load_boot_image_from_deep_sleep();
+#endif
+
+    // 2. Load partition table
+    bootloader_state_t bs = {0};
+    if (!bootloader_utility_load_partition_table(&bs))
+    {
+        ESP_LOGE(TAG, "load partition table error!");
+        bootloader_reset();
+    }
+
+    recovery_mailbox_t mb;
+    recovery_mailbox_load(&mb);
+    int boot_index;
+
+    // 3. Recovery requested: boot factory before otadata is looked at, so a
+    // freshly installed image keeps its first boot (and its rollback state).
+    recovery_entry_t entry = bs.factory.offset ? recovery_requested(&mb) : RECOVERY_ENTRY_NONE;
+    if (entry != RECOVERY_ENTRY_NONE)
+    {
+        ESP_LOGW(TAG, "Recovery requested (%s), booting factory", recovery_mailbox_entry_name(entry));
+        mb.request = 0; // One-shot: the reset after recovery boots the main app again
+        mb.boot_count = 0;
+        mb.entry = entry;
+        boot_index = FACTORY_INDEX;
+    }
+    else
+    {
+        // 3b. Normal selection, including the rollback state machine
+        boot_index = bootloader_utility_get_selected_boot_partition(&bs);
+        if (boot_index == INVALID_INDEX)
+            bootloader_reset();
+        if (boot_index != FACTORY_INDEX && mb.boot_count < UINT8_MAX)
+            mb.boot_count++;
+    }
+    recovery_mailbox_store(&mb);
+
+    // 4. Load the app image (falls back through the other partitions if it is invalid)
+    bootloader_utility_load_boot_image(&bs, boot_index);
+}
+
+static recovery_entry_t recovery_requested(const recovery_mailbox_t *mb)
+{
+#if CONFIG_RECOVERY_BOOT_GPIO >= 0
+    if (bootloader_common_check_long_hold_gpio_level(CONFIG_RECOVERY_BOOT_GPIO, CONFIG_RECOVERY_BOOT_GPIO_HOLD_SEC,
+                                                     CONFIG_RECOVERY_BOOT_GPIO_LEVEL) == GPIO_LONG_HOLD)
+        return RECOVERY_ENTRY_GPIO;
+#endif
+
+    if (mb->request)
+        return RECOVERY_ENTRY_REQUEST;
+
+#if CONFIG_RECOVERY_BOOT_COUNT_LIMIT > 0
+    if (mb->boot_count >= CONFIG_RECOVERY_BOOT_COUNT_LIMIT)
+        return RECOVERY_ENTRY_BOOT_LOOP;
+#endif
+
+    return RECOVERY_ENTRY_NONE;
+}
+
+// Return global reent struct if any newlib functions are linked to bootloader
+struct _reent *__getreent(void)
+{
+    return _GLOBAL_REENT;
+}
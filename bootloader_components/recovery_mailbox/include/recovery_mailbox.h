@@ -0,0 +1,248 @@
+#pragma once
+
+#include "sdkconfig.h"
+#include "bootloader_common.h"
+#include "esp_rom_crc.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Recovery mailbox: a small record in the RTC area the bootloader reserves
+ * (CONFIG_BOOTLOADER_CUSTOM_RESERVE_RTC). It survives every reset except a
+ * power loss and is shared by the bootloader, the main app and this recovery app.
+ * The main app adds this directory to its EXTRA_COMPONENT_DIRS and builds with
+ * the same CONFIG_BOOTLOADER_CUSTOM_RESERVE_RTC_SIZE.
+ *
+ * Main app -> recovery: why recovery is entered and what to do there
+ * (recovery_mailbox_request_action()). Recovery -> main app: the outcome
+ * (recovery_mailbox_get_result()). A layout change bumps RECOVERY_MAILBOX_VERSION;
+ * a reader then sees an empty mailbox rather than misreading it.
+ */
+
+#if !CONFIG_BOOTLOADER_CUSTOM_RESERVE_RTC
+#error "recovery_mailbox needs CONFIG_BOOTLOADER_CUSTOM_RESERVE_RTC"
+#endif
+
+#define RECOVERY_MAILBOX_MAGIC 0x58424d52 // "RMBX"
+#define RECOVERY_MAILBOX_VERSION 2
+#define RECOVERY_MAILBOX_URL_LEN 160
+
+// Why the bootloader sent us to factory.
+typedef enum
+{
+    RECOVERY_ENTRY_NONE = 0,  // Booted factory the ordinary way (otadata)
+    RECOVERY_ENTRY_GPIO,      // Strap held at reset
+    RECOVERY_ENTRY_REQUEST,   // The main app asked for it
+    RECOVERY_ENTRY_BOOT_LOOP, // CONFIG_RECOVERY_BOOT_COUNT_LIMIT reached
+} recovery_entry_t;
+
+// What the recovery app should do when it comes up.
+typedef enum
+{
+    RECOVERY_ACTION_NONE = 0,       // Full discovery: golden auto-restore, STA, AP fallback
+    RECOVERY_ACTION_FETCH_URL,      // Download url over STA and install it
+    RECOVERY_ACTION_RESTORE_GOLDEN, // Restore golden_index from the library
+    RECOVERY_ACTION_AP_ONLY,        // Skip the STA attempt, wait for an upload on the AP
+} recovery_action_t;
+
+// Word sized throughout: RTC slow memory is accessed 32 bits at a time.
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;      // sizeof(recovery_mailbox_t), rejects other layouts
+    uint8_t request;    // Non-zero: main app asks the bootloader for factory
+    uint8_t boot_count; // Main-app boots since its last healthy report
+    uint8_t entry;      // recovery_entry_t, set by the bootloader
+    uint8_t action;     // recovery_action_t, set by the main app
+
+    // Parameters, main app -> recovery
+    uint16_t reason;       // App-defined code, logged by the recovery app
+    uint16_t golden_index; // RECOVERY_ACTION_RESTORE_GOLDEN
+    char url[RECOVERY_MAILBOX_URL_LEN]; // RECOVERY_ACTION_FETCH_URL, null-terminated
+
+    // Result, recovery -> main app
+    uint8_t result_action; // recovery_action_t the result belongs to, 0 if none yet
+    uint8_t reserved[3];
+    int32_t result; // esp_err_t
+
+    uint32_t crc32; // esp_rom_crc32_le(0, ...) over all fields above
+} recovery_mailbox_t;
+
+_Static_assert(sizeof(recovery_mailbox_t) % 4 == 0, "recovery_mailbox_t must be word sized");
+_Static_assert(sizeof(recovery_mailbox_t) <= CONFIG_BOOTLOADER_CUSTOM_RESERVE_RTC_SIZE,
+               "CONFIG_BOOTLOADER_CUSTOM_RESERVE_RTC_SIZE is too small for recovery_mailbox_t");
+
+static inline volatile uint32_t *recovery_mailbox_rtc(void)
+{
+    return (volatile uint32_t *)bootloader_common_get_rtc_retain_mem()->custom;
+}
+
+static inline uint32_t recovery_mailbox_crc(const recovery_mailbox_t *mb)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)mb, offsetof(recovery_mailbox_t, crc32));
+}
+
+/**
+ * @brief Copies the mailbox out of RTC memory.
+ * @return false if it is empty or damaged (after a power loss); *out is then a fresh mailbox.
+ */
+static inline bool recovery_mailbox_load(recovery_mailbox_t *out)
+{
+    volatile uint32_t *rtc = recovery_mailbox_rtc();
+    uint32_t *dst = (uint32_t *)out;
+    for (size_t i = 0; i < sizeof(*out) / 4; i++)
+        dst[i] = rtc[i];
+
+    if (out->magic == RECOVERY_MAILBOX_MAGIC && out->version == RECOVERY_MAILBOX_VERSION &&
+        out->size == sizeof(*out) && out->crc32 == recovery_mailbox_crc(out))
+        return true;
+
+    const recovery_mailbox_t fresh = {
+        .magic = RECOVERY_MAILBOX_MAGIC,
+        .version = RECOVERY_MAILBOX_VERSION,
+        .size = sizeof(fresh),
+    };
+    *out = fresh;
+    return false;
+}
+
+/**
+ * @brief Seals (CRC) and writes the mailbox back.
+ */
+static inline void recovery_mailbox_store(recovery_mailbox_t *mb)
+{
+    mb->crc32 = recovery_mailbox_crc(mb);
+    volatile uint32_t *rtc = recovery_mailbox_rtc();
+    const uint32_t *src = (const uint32_t *)mb;
+    for (size_t i = 0; i < sizeof(*mb) / 4; i++)
+        rtc[i] = src[i];
+}
+
+/**
+ * @brief Main app: boot recovery on the next reset, without touching otadata.
+ * Follow with esp_restart(). Recovery is entered once; the reset after it boots the main app again.
+ */
+static inline void recovery_mailbox_request_entry(void)
+{
+    recovery_mailbox_t mb;
+    recovery_mailbox_load(&mb);
+    mb.request = 1;
+    recovery_mailbox_store(&mb);
+}
+
+/**
+ * @brief Main app: resets the bootloader's boot-loop counter. Call once initialization succeeded.
+ */
+static inline void recovery_mailbox_report_healthy(void)
+{
+    recovery_mailbox_t mb;
+    recovery_mailbox_load(&mb);
+    if (mb.boot_count == 0)
+        return;
+    mb.boot_count = 0;
+    recovery_mailbox_store(&mb);
+}
+
+/**
+ * @brief Main app: like recovery_mailbox_request_entry(), with instructions.
+ * @param[in] url  For RECOVERY_ACTION_FETCH_URL, otherwise NULL. Truncated to RECOVERY_MAILBOX_URL_LEN - 1.
+ */
+static inline void recovery_mailbox_request_action(recovery_action_t action, uint16_t reason, const char *url,
+                                                   uint16_t golden_index)
+{
+    recovery_mailbox_t mb;
+    recovery_mailbox_load(&mb);
+    mb.request = 1;
+    mb.action = action;
+    mb.reason = reason;
+    mb.golden_index = golden_index;
+    memset(mb.url, 0, sizeof(mb.url));
+    if (url)
+        strncpy(mb.url, url, sizeof(mb.url) - 1);
+    mb.result_action = RECOVERY_ACTION_NONE;
+    mb.result = 0;
+    recovery_mailbox_store(&mb);
+}
+
+/**
+ * @brief Main app: outcome of the last requested action.
+ * @return false if recovery has not reported one (not run yet, or power was lost).
+ */
+static inline bool recovery_mailbox_get_result(recovery_action_t *action, int32_t *result)
+{
+    recovery_mailbox_t mb;
+    if (!recovery_mailbox_load(&mb) || mb.result_action == RECOVERY_ACTION_NONE)
+        return false;
+    *action = (recovery_action_t)mb.result_action;
+    *result = mb.result;
+    return true;
+}
+
+/**
+ * @brief Recovery app: reads the mailbox and consumes entry and action, so a
+ * reset in the middle of the action does not repeat it.
+ * @return false if the mailbox is empty; *out is then a fresh mailbox.
+ */
+static inline bool recovery_mailbox_take(recovery_mailbox_t *out)
+{
+    if (!recovery_mailbox_load(out))
+        return false;
+
+    recovery_mailbox_t mb = *out;
+    mb.entry = RECOVERY_ENTRY_NONE;
+    mb.action = RECOVERY_ACTION_NONE;
+    recovery_mailbox_store(&mb);
+    out->url[sizeof(out->url) - 1] = '\0';
+    return true;
+}
+
+/**
+ * @brief Recovery app: reports the outcome of an action to the main app.
+ */
+static inline void recovery_mailbox_post_result(recovery_action_t action, int32_t result)
+{
+    recovery_mailbox_t mb;
+    recovery_mailbox_load(&mb);
+    mb.result_action = action;
+    mb.result = result;
+    recovery_mailbox_store(&mb);
+}
+
+/**
+ * @brief Human readable recovery_entry_t.
+ */
+static inline const char *recovery_mailbox_entry_name(recovery_entry_t entry)
+{
+    switch (entry)
+    {
+    case RECOVERY_ENTRY_GPIO:
+        return "gpio";
+    case RECOVERY_ENTRY_REQUEST:
+        return "request";
+    case RECOVERY_ENTRY_BOOT_LOOP:
+        return "boot_loop";
+    default:
+        return "none";
+    }
+}
+
+/**
+ * @brief Human readable recovery_action_t.
+ */
+static inline const char *recovery_mailbox_action_name(recovery_action_t action)
+{
+    switch (action)
+    {
+    case RECOVERY_ACTION_FETCH_URL:
+        return "fetch_url";
+    case RECOVERY_ACTION_RESTORE_GOLDEN:
+        return "restore_golden";
+    case RECOVERY_ACTION_AP_ONLY:
+        return "ap_only";
+    default:
+        return "none";
+    }
+}
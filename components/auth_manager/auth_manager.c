@@ -1,5 +1,7 @@
 #include "auth_manager.h"
 #include "storage_manager.h"
+#include "event_bus.h"
+#include "heap_monitor.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "esp_random.h"
@@ -32,6 +34,16 @@ static void generate_new_session(void)
     s_last_activity_time = esp_timer_get_time();
 
     storage_set_session_token(s_session_token);
+    event_bus_publish_simple(EVENT_SESSION_CREATED);
+}
+
+static esp_err_t reject(httpd_req_t *req, const char *msg)
+{
+    // An upload sent without a valid cookie is not worth receiving just to keep the connection.
+    if (req->content_len > HTTP_DRAIN_MAX)
+        httpd_resp_set_hdr(req, "Connection", "close");
+    httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, msg);
+    return ESP_FAIL;
 }
 
 /* --- PUBLIC API --- */
@@ -40,28 +52,22 @@ esp_err_t auth_guard(httpd_req_t *req)
 {
     // 1. Check if we even have a session active in RAM
     if (s_session_token[0] == '\0')
-    {
-        httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "No active session. Log in first.");
-        return ESP_FAIL;
-    }
+        return reject(req, "No active session. Log in first.");
 
     // 2. Check Timeout
     int64_t now = esp_timer_get_time();
     if ((now - s_last_activity_time) > SESSION_TIMEOUT_US)
     {
         s_session_token[0] = '\0'; // Invalidate
-        httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Session expired.");
-        return ESP_FAIL;
+        event_bus_publish_simple(EVENT_SESSION_EXPIRED);
+        return reject(req, "Session expired.");
     }
 
     // 3. Extract Cookie Header
     // "Cookie: access_token=abc12345..."
     char cookie_buf[256];
     if (httpd_req_get_hdr_value_str(req, "Cookie", cookie_buf, sizeof(cookie_buf)) != ESP_OK)
-    {
-        httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Missing Cookie Header.");
-        return ESP_FAIL;
-    }
+        return reject(req, "Missing Cookie Header.");
 
     // 4. Validate Token
     // We search for our token string inside the cookie header.
@@ -74,13 +80,12 @@ esp_err_t auth_guard(httpd_req_t *req)
         return ESP_OK;
     }
 
-    httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Invalid Token.");
-    return ESP_FAIL;
+    return reject(req, "Invalid Token.");
 }
 
 /* --- LOGIN HANDLER --- */
 
-static esp_err_t login_post_handler(httpd_req_t *req)
+static esp_err_t login_handle(httpd_req_t *req)
 {
     char buf[256]; // Buffer for JSON body
     int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
@@ -100,7 +105,7 @@ static esp_err_t login_post_handler(httpd_req_t *req)
     if (!root)
     {
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Invalid JSON");
-        return ESP_FAIL;
+        return ESP_OK; // Answered; httpd discards any unread rest of the body
     }
 
     cJSON *pass_item = cJSON_GetObjectItem(root, "password");
@@ -108,7 +113,7 @@ static esp_err_t login_post_handler(httpd_req_t *req)
     {
         cJSON_Delete(root);
         httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing password field");
-        return ESP_FAIL;
+        return ESP_OK;
     }
 
     // 2. Verify against Storage (NVS/Kconfig)
@@ -135,6 +140,7 @@ static esp_err_t login_post_handler(httpd_req_t *req)
     {
         // --- FAILURE ---
         ESP_LOGW(TAG, "Login failed. Wrong password.");
+        event_bus_publish_simple(EVENT_LOGIN_FAILED);
         // Add a small delay to prevent brute-force timing attacks
         vTaskDelay(pdMS_TO_TICKS(1000));
         httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Wrong Password");
@@ -144,6 +150,15 @@ static esp_err_t login_post_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
+static esp_err_t login_post_handler(httpd_req_t *req)
+{
+    // Attribute login allocations to auth_manager rather than the HTTP server.
+    heap_tag_t prev_tag = heap_monitor_scope_set(HEAP_TAG_AUTH);
+    esp_err_t ret = login_handle(req);
+    heap_monitor_scope_set(prev_tag);
+    return ret;
+}
+
 void auth_manager_init(httpd_handle_t server)
 {
     // We try to fill the RAM cache. If it fails (no key), it stays empty (requires login).
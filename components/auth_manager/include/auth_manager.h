@@ -2,6 +2,15 @@
 #include "esp_http_server.h"
 #include "esp_err.h"
 
+/**
+ * Keep-alive limit for early answers (401, 400, 500 before the body is read).
+ * httpd reads off and discards what a handler leaves unread, so the next request
+ * on the connection parses correctly; up to this many bytes that is cheaper than
+ * a new connection. Larger bodies (uploads) get "Connection: close" instead and
+ * the handler returns ESP_FAIL, which drops the socket without receiving them.
+ */
+#define HTTP_DRAIN_MAX 4096
+
 /**
  * @brief Initializes the Auth System.
  * Registers the POST /login route.
@@ -13,5 +22,6 @@ void auth_manager_init(httpd_handle_t server);
  * Call this at the start of any handler you want to protect.
  * @return ESP_OK if authorized.
  * @return ESP_FAIL if unauthorized (and sends 401 response automatically).
+ *         The 401 carries "Connection: close" if the body exceeds HTTP_DRAIN_MAX.
  */
 esp_err_t auth_guard(httpd_req_t *req);
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include "event_bus.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "EVENT_BUS";
+
+// Registry. Written only during init; publishers read it lock-free.
+static event_subscriber_t *s_subs[EVENT_BUS_MAX_SUBSCRIBERS];
+static atomic_uint s_sub_count = 0;
+static portMUX_TYPE s_register_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *const s_type_names[EVENT_TYPE_MAX] = {
+    [EVENT_WIFI_STA_CONNECTED] = "wifi_sta_connected",
+    [EVENT_WIFI_STA_FAILED] = "wifi_sta_failed",
+    [EVENT_WIFI_AP_STARTED] = "wifi_ap_started",
+    [EVENT_OTA_STARTED] = "ota_started",
+    [EVENT_OTA_PROGRESS] = "ota_progress",
+    [EVENT_OTA_FINISHED] = "ota_finished",
+    [EVENT_OTA_FAILED] = "ota_failed",
+    [EVENT_SESSION_CREATED] = "session_created",
+    [EVENT_SESSION_EXPIRED] = "session_expired",
+    [EVENT_LOGIN_FAILED] = "login_failed",
+    [EVENT_RESTART_PENDING] = "restart_pending",
+};
+
+/* --- PUBLIC API --- */
+
+esp_err_t event_bus_subscribe(event_subscriber_t *sub, uint32_t mask)
+{
+    if (!sub || !sub->records || !sub->seq)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t err = ring_mpsc_init(&sub->queue, sub->records, sub->seq, sizeof(event_t), sub->depth);
+    if (err != ESP_OK)
+        return err;
+
+    sub->mask = mask;
+    atomic_init(&sub->dropped, 0);
+    sub->wake = xSemaphoreCreateBinaryStatic(&sub->wake_buf);
+
+    err = ESP_ERR_NO_MEM;
+    taskENTER_CRITICAL(&s_register_lock);
+    uint32_t n = atomic_load(&s_sub_count);
+    if (n < EVENT_BUS_MAX_SUBSCRIBERS)
+    {
+        s_subs[n] = sub;
+        atomic_store(&s_sub_count, n + 1);
+        err = ESP_OK;
+    }
+    taskEXIT_CRITICAL(&s_register_lock);
+
+    if (err != ESP_OK)
+        ESP_LOGE(TAG, "Subscriber table full (%d).", EVENT_BUS_MAX_SUBSCRIBERS);
+    return err;
+}
+
+void event_bus_publish(const event_t *event)
+{
+    if (!event || event->type >= EVENT_TYPE_MAX)
+        return;
+
+    int64_t now = esp_timer_get_time();
+    uint32_t n = atomic_load(&s_sub_count);
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        event_subscriber_t *sub = s_subs[i];
+        if (!(sub->mask & EVENT_MASK(event->type)))
+            continue;
+
+        event_t *slot = ring_mpsc_reserve(&sub->queue);
+        if (!slot)
+        {
+            atomic_fetch_add(&sub->dropped, 1);
+            continue;
+        }
+
+        *slot = *event;
+        slot->timestamp_us = now;
+        ring_mpsc_commit(&sub->queue, slot);
+        xSemaphoreGive(sub->wake); // Binary semaphore: never blocks
+    }
+}
+
+void event_bus_publish_simple(event_type_t type)
+{
+    event_t event = {.type = type};
+    event_bus_publish(&event);
+}
+
+bool event_bus_receive(event_subscriber_t *sub, event_t *out, TickType_t wait)
+{
+    while (true)
+    {
+        event_t *slot = ring_mpsc_peek(&sub->queue);
+        if (slot)
+        {
+            *out = *slot;
+            ring_mpsc_release(&sub->queue);
+            return true;
+        }
+
+        if (xSemaphoreTake(sub->wake, wait) != pdTRUE)
+            return false;
+    }
+}
+
+uint32_t event_bus_dropped(event_subscriber_t *sub)
+{
+    return atomic_load(&sub->dropped);
+}
+
+const char *event_bus_type_name(event_type_t type)
+{
+    if (type >= EVENT_TYPE_MAX || !s_type_names[type])
+        return "unknown";
+    return s_type_names[type];
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "esp_err.h"
+#include "ring_buffer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Internal publish/subscribe bus.
+ * Publishing never blocks and never allocates: each subscriber owns a
+ * bounded queue, and an event that does not fit is dropped and counted
+ * for that subscriber only. A slow subscriber cannot stall a publisher.
+ */
+
+#define EVENT_BUS_MAX_SUBSCRIBERS 8
+
+typedef enum
+{
+    EVENT_WIFI_STA_CONNECTED = 0,
+    EVENT_WIFI_STA_FAILED,
+    EVENT_WIFI_AP_STARTED,
+    EVENT_OTA_STARTED,  // data.ota.total
+    EVENT_OTA_PROGRESS, // data.ota.done / total
+    EVENT_OTA_FINISHED, // data.ota.done
+    EVENT_OTA_FAILED,   // data.result.err
+    EVENT_SESSION_CREATED,
+    EVENT_SESSION_EXPIRED,
+    EVENT_LOGIN_FAILED,
+    EVENT_RESTART_PENDING,
+    EVENT_TYPE_MAX
+} event_type_t;
+
+#define EVENT_MASK(type) (1u << (type))
+#define EVENT_MASK_ALL ((1u << EVENT_TYPE_MAX) - 1)
+
+typedef struct
+{
+    event_type_t type;
+    int64_t timestamp_us;
+    union
+    {
+        struct
+        {
+            uint32_t done;
+            uint32_t total;
+        } ota;
+        struct
+        {
+            int32_t err;
+        } result;
+    } data;
+} event_t;
+
+typedef struct
+{
+    ring_mpsc_t queue;
+    uint32_t mask;
+    atomic_uint dropped;
+    SemaphoreHandle_t wake;
+    StaticSemaphore_t wake_buf;
+    event_t *records;
+    atomic_uint *seq;
+    size_t depth;
+} event_subscriber_t;
+
+/**
+ * @brief Defines a subscriber with static storage for `count` events.
+ * count must be a power of two.
+ */
+#define EVENT_SUBSCRIBER_DEFINE(name, count) \
+    static event_t name##_records[count];    \
+    static atomic_uint name##_seq[count];    \
+    static event_subscriber_t name = {       \
+        .records = name##_records,           \
+        .seq = name##_seq,                   \
+        .depth = (count)}
+
+/**
+ * @brief Registers a subscriber for the event types in mask.
+ * Call during init; subscribers cannot be removed.
+ * @return ESP_ERR_NO_MEM if EVENT_BUS_MAX_SUBSCRIBERS is reached.
+ */
+esp_err_t event_bus_subscribe(event_subscriber_t *sub, uint32_t mask);
+
+/**
+ * @brief Publishes an event to every interested subscriber. Never blocks.
+ * timestamp_us is filled in by the bus.
+ */
+void event_bus_publish(const event_t *event);
+
+/**
+ * @brief Shorthand for events without payload.
+ */
+void event_bus_publish_simple(event_type_t type);
+
+/**
+ * @brief Takes the oldest event from the subscriber's queue.
+ * @param[in] wait  Ticks to wait for an event (0 = poll).
+ * @return true if *out was filled.
+ */
+bool event_bus_receive(event_subscriber_t *sub, event_t *out, TickType_t wait);
+
+/**
+ * @brief Number of events dropped for this subscriber because its queue was full.
+ */
+uint32_t event_bus_dropped(event_subscriber_t *sub);
+
+/**
+ * @brief Human-readable event name, for logs.
+ */
+const char *event_bus_type_name(event_type_t type);
@@ -0,0 +1,226 @@
+#include "golden_library.h"
+#include "ota_manager.h"
+#include "storage_manager.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "rom/miniz.h"
+#include <string.h>
+
+static const char *TAG = "GOLDEN_LIBRARY";
+
+#define INDEX_SIZE 4096
+#define READ_CHUNK 4096
+
+static const esp_partition_t *find_library(void)
+{
+    return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                    CONFIG_GOLDEN_PARTITION_LABEL);
+}
+
+/* Inflates the entry straight into the OTA writer.
+ * The 32 KB dictionary doubles as the output buffer; both it and the
+ * decompressor state (~11 KB) go to PSRAM when present. */
+static esp_err_t inflate_to_ota(const esp_partition_t *lib, const golden_entry_t *entry)
+{
+    const uint32_t caps = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+    tinfl_decompressor *inflator = heap_caps_malloc_prefer(sizeof(tinfl_decompressor), 2, caps, MALLOC_CAP_DEFAULT);
+    uint8_t *dict = heap_caps_malloc_prefer(TINFL_LZ_DICT_SIZE, 2, caps, MALLOC_CAP_DEFAULT);
+    uint8_t *in = heap_caps_malloc(READ_CHUNK, MALLOC_CAP_DEFAULT);
+
+    esp_err_t err = (inflator && dict && in) ? ESP_OK : ESP_ERR_NO_MEM;
+    if (err == ESP_OK)
+        tinfl_init(inflator);
+
+    size_t comp_pos = 0;
+    size_t in_ofs = 0, in_avail = 0;
+    size_t dict_ofs = 0;
+    size_t produced = 0;
+
+    while (err == ESP_OK)
+    {
+        if (in_avail == 0 && comp_pos < entry->comp_size)
+        {
+            size_t n = entry->comp_size - comp_pos;
+            if (n > READ_CHUNK)
+                n = READ_CHUNK;
+            err = esp_partition_read(lib, entry->offset + comp_pos, in, n);
+            if (err != ESP_OK)
+                break;
+            comp_pos += n;
+            in_ofs = 0;
+            in_avail = n;
+        }
+
+        size_t in_bytes = in_avail;
+        size_t out_bytes = TINFL_LZ_DICT_SIZE - dict_ofs;
+        int flags = TINFL_FLAG_PARSE_ZLIB_HEADER;
+        if (comp_pos < entry->comp_size)
+            flags |= TINFL_FLAG_HAS_MORE_INPUT;
+
+        tinfl_status status = tinfl_decompress(inflator, in + in_ofs, &in_bytes, dict, dict + dict_ofs,
+                                               &out_bytes, flags);
+        in_ofs += in_bytes;
+        in_avail -= in_bytes;
+
+        if (out_bytes > 0)
+        {
+            err = ota_manager_write(dict + dict_ofs, out_bytes);
+            dict_ofs = (dict_ofs + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+            produced += out_bytes;
+        }
+
+        if (status == TINFL_STATUS_DONE)
+            break;
+        if (status < TINFL_STATUS_DONE ||
+            (status == TINFL_STATUS_NEEDS_MORE_INPUT && comp_pos >= entry->comp_size && in_avail == 0))
+        {
+            ESP_LOGE(TAG, "Inflate failed (%d) after %u bytes", (int)status, (unsigned)produced);
+            err = ESP_ERR_INVALID_RESPONSE;
+        }
+    }
+
+    if (err == ESP_OK && produced != entry->image_size)
+    {
+        ESP_LOGE(TAG, "Size mismatch: %u inflated, %u expected", (unsigned)produced, (unsigned)entry->image_size);
+        err = ESP_ERR_INVALID_SIZE;
+    }
+
+    heap_caps_free(in);
+    heap_caps_free(dict);
+    heap_caps_free(inflator);
+    return err;
+}
+
+static bool main_app_installed(void)
+{
+    esp_app_desc_t desc;
+    for (size_t i = 0; i < esp_ota_get_app_partition_count(); i++)
+    {
+        const esp_partition_t *slot = esp_partition_find_first(ESP_PARTITION_TYPE_APP,
+                                                               ESP_PARTITION_SUBTYPE_APP_OTA_MIN + i, NULL);
+        if (slot && esp_ota_get_partition_description(slot, &desc) == ESP_OK)
+            return true;
+    }
+    return false;
+}
+
+/* --- PUBLIC API --- */
+
+esp_err_t golden_library_get_index(golden_index_t *out)
+{
+    if (!out)
+        return ESP_ERR_INVALID_ARG;
+
+    const esp_partition_t *lib = find_library();
+    if (!lib)
+        return ESP_ERR_NOT_FOUND;
+
+    esp_err_t err = esp_partition_read(lib, 0, out, sizeof(*out));
+    if (err != ESP_OK)
+        return err;
+
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)out, offsetof(golden_index_t, crc32));
+    if (out->magic != GOLDEN_MAGIC || out->format != GOLDEN_FORMAT ||
+        out->count > GOLDEN_MAX_ENTRIES || crc != out->crc32)
+        return ESP_ERR_INVALID_CRC;
+
+    for (size_t i = 0; i < out->count; i++)
+    {
+        const golden_entry_t *e = &out->entries[i];
+        if (e->offset < INDEX_SIZE || e->offset > lib->size || e->comp_size > lib->size - e->offset)
+            return ESP_ERR_INVALID_SIZE;
+        out->entries[i].version[sizeof(e->version) - 1] = '\0';
+    }
+    return ESP_OK;
+}
+
+esp_err_t golden_library_restore(size_t idx)
+{
+    static golden_index_t index; // Too large for the httpd stack
+    esp_err_t err = golden_library_get_index(&index);
+    if (err != ESP_OK)
+        return err;
+    if (idx >= index.count)
+        return ESP_ERR_INVALID_ARG;
+
+    const golden_entry_t *entry = &index.entries[idx];
+
+    // Same image already in a slot: nothing to copy.
+    if (ota_manager_activate_installed(entry->sha256) == ESP_OK)
+    {
+        ESP_LOGI(TAG, "'%s' is already installed", entry->version);
+        return ESP_OK;
+    }
+
+    err = ota_manager_begin(entry->image_size);
+    if (err != ESP_OK)
+        return err;
+
+    ESP_LOGI(TAG, "Restoring '%s' (%u -> %u bytes)", entry->version,
+             (unsigned)entry->comp_size, (unsigned)entry->image_size);
+
+    int64_t t0 = esp_timer_get_time();
+    err = inflate_to_ota(find_library(), entry);
+    if (err != ESP_OK)
+    {
+        ota_manager_abort();
+        return err;
+    }
+
+    err = ota_manager_finish();
+    if (err == ESP_OK)
+        ESP_LOGI(TAG, "Restored '%s' in %lld ms", entry->version, (esp_timer_get_time() - t0) / 1000);
+    return err;
+}
+
+esp_err_t golden_library_auto_restore(bool boot_loop, bool *restored)
+{
+    if (!restored)
+        return ESP_ERR_INVALID_ARG;
+    *restored = false;
+
+#if CONFIG_GOLDEN_AUTO_RESTORE
+    golden_index_t index;
+    if (golden_library_get_index(&index) != ESP_OK || index.count == 0)
+        return ESP_OK; // No library on this module
+
+    bool flagged = false;
+    storage_take_boot_loop_flag(&flagged);
+    boot_loop = boot_loop || flagged;
+
+    bool slot_empty = !main_app_installed();
+
+    uint8_t attempt = 0;
+    storage_get_golden_attempt(&attempt);
+
+    if (!boot_loop && !slot_empty)
+    {
+        // Entered recovery for another reason: the last restore (if any) held up.
+        if (attempt != 0)
+            storage_set_golden_attempt(0);
+        return ESP_OK;
+    }
+
+    if (attempt >= index.count)
+    {
+        ESP_LOGW(TAG, "All %u golden images were tried, staying in recovery.", index.count);
+        return ESP_OK;
+    }
+
+    ESP_LOGW(TAG, "%s: restoring golden image %u/%u", boot_loop ? "Boot loop reported" : "No main app installed",
+             attempt + 1, index.count);
+
+    // Count the attempt first, so a crash mid-restore moves on to the next entry.
+    storage_set_golden_attempt(attempt + 1);
+    esp_err_t err = golden_library_restore(attempt);
+    *restored = (err == ESP_OK);
+    return err;
+#else
+    (void)boot_loop;
+    return ESP_OK;
+#endif
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Golden image library: known-good main-app images kept zlib-compressed in a
+ * data partition, so the OTA slot can be restored from local flash.
+ *
+ * Partition layout (built by tools/mkgolden.py):
+ *   0x0000  golden_index_t (one sector)
+ *   0x1000  compressed images, each 4 KB aligned
+ */
+
+#define GOLDEN_MAGIC 0x42494c47 // "GLIB"
+#define GOLDEN_FORMAT 1
+#define GOLDEN_MAX_ENTRIES 8
+
+typedef struct
+{
+    char version[32];    // Null-terminated, from the app descriptor
+    uint8_t sha256[32];  // SHA-256 of the plain .bin, as in POST /ota/digest
+    uint32_t offset;     // From the partition start
+    uint32_t comp_size;  // Compressed bytes
+    uint32_t image_size; // Decompressed bytes, i.e. what is streamed to ota_manager
+    uint32_t reserved;
+} golden_entry_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t format;
+    uint16_t count;
+    golden_entry_t entries[GOLDEN_MAX_ENTRIES]; // Preferred (newest) first
+    uint32_t crc32;                             // esp_rom_crc32_le(0, ...) over all fields above
+} golden_index_t;
+
+/**
+ * @brief Reads and validates the library index.
+ * @return ESP_OK on success.
+ * @return ESP_ERR_NOT_FOUND if there is no library partition.
+ * @return ESP_ERR_INVALID_CRC if the index is missing or damaged.
+ */
+esp_err_t golden_library_get_index(golden_index_t *out);
+
+/**
+ * @brief Restores library entry idx into the OTA slot and makes it the boot partition.
+ * If the slot already holds that image, only the boot partition is switched.
+ * The stream goes through ota_manager, so signatures and encryption rules apply.
+ * @return ESP_OK if the image will boot next.
+ * @return ESP_ERR_INVALID_ARG if idx is not in the index.
+ */
+esp_err_t golden_library_restore(size_t idx);
+
+/**
+ * @brief Restores automatically if a boot loop was reported or the OTA
+ * slot is empty (CONFIG_GOLDEN_AUTO_RESTORE). Call after storage_init().
+ * @param[in] boot_loop  The bootloader detected a boot loop (recovery_mailbox.h);
+ *                       the main app's NVS flag is checked as well.
+ * @param[out] restored  true if a restore happened and the caller should reboot.
+ */
+esp_err_t golden_library_auto_restore(bool boot_loop, bool *restored);
@@ -0,0 +1,275 @@
+#include "heap_monitor.h"
+#include "esp_heap_caps.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "cJSON.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "HEAP_MONITOR";
+
+#define MAX_SCOPES 4
+#define MAX_PROBES 32 // Bounds the time spent inside the allocator
+
+static const char *const s_tag_names[HEAP_TAG_MAX] = {
+    [HEAP_TAG_OTHER] = "other",
+    [HEAP_TAG_SERVER] = "server_manager",
+    [HEAP_TAG_AUTH] = "auth_manager",
+    [HEAP_TAG_CJSON] = "cjson",
+    [HEAP_TAG_LWIP] = "lwip",
+    [HEAP_TAG_WIFI] = "wifi",
+};
+
+// Attribution sources
+static TaskHandle_t s_task_lwip = NULL;
+static TaskHandle_t s_task_wifi = NULL;
+static TaskHandle_t s_task_httpd = NULL;
+static DRAM_ATTR struct
+{
+    TaskHandle_t task;
+    heap_tag_t tag;
+} s_scopes[MAX_SCOPES];
+
+static DRAM_ATTR heap_tag_stats_t s_tags[HEAP_TAG_MAX];
+static DRAM_ATTR uint32_t s_untracked = 0;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#if CONFIG_HEAP_USE_HOOKS
+
+#define SLOT_COUNT CONFIG_HEAP_MONITOR_SLOTS
+_Static_assert((SLOT_COUNT & (SLOT_COUNT - 1)) == 0, "HEAP_MONITOR_SLOTS must be a power of two");
+
+// Live allocation table: open addressing, linear probing, backward-shift delete.
+typedef struct
+{
+    uintptr_t ptr;
+    uint32_t meta; // size << 8 | tag
+} slot_t;
+
+static DRAM_ATTR slot_t s_table[SLOT_COUNT];
+
+/* --- HOOK HELPERS (IRAM) --- */
+
+static uint32_t slot_index(uintptr_t ptr)
+{
+    return ((ptr >> 3) * 2654435761u) & (SLOT_COUNT - 1);
+}
+
+static heap_tag_t current_tag(void)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+
+    for (int i = 0; i < MAX_SCOPES; i++)
+    {
+        if (s_scopes[i].task == task && s_scopes[i].tag != HEAP_TAG_NONE)
+            return s_scopes[i].tag;
+    }
+
+    if (task == s_task_lwip)
+        return HEAP_TAG_LWIP;
+    if (task == s_task_wifi)
+        return HEAP_TAG_WIFI;
+    if (task == s_task_httpd)
+        return HEAP_TAG_SERVER;
+    return HEAP_TAG_OTHER;
+}
+
+static void table_remove(uint32_t i)
+{
+    uint32_t j = i;
+    while (true)
+    {
+        j = (j + 1) & (SLOT_COUNT - 1);
+        if (s_table[j].ptr == 0)
+            break;
+
+        // Entry j may move into the hole at i only if its home slot is not in (i, j].
+        uint32_t k = slot_index(s_table[j].ptr);
+        bool stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+        if (stays)
+            continue;
+
+        s_table[i] = s_table[j];
+        i = j;
+    }
+    s_table[i].ptr = 0;
+}
+
+static void account(heap_tag_t tag, int32_t bytes, int32_t count)
+{
+    heap_tag_stats_t *t = &s_tags[tag];
+    t->live_bytes += bytes;
+    t->live_count += count;
+    if (bytes > 0)
+    {
+        t->total_count++;
+        if (t->live_bytes > t->peak_bytes)
+            t->peak_bytes = t->live_bytes;
+    }
+}
+
+/* --- IDF HEAP HOOKS --- */
+
+void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    if (!ptr)
+        return;
+
+    uintptr_t key = (uintptr_t)ptr;
+    heap_tag_t tag = current_tag();
+
+    portENTER_CRITICAL_SAFE(&s_lock);
+    uint32_t i = slot_index(key);
+    int probes = 0;
+    while (s_table[i].ptr != 0 && s_table[i].ptr != key && probes < MAX_PROBES)
+    {
+        i = (i + 1) & (SLOT_COUNT - 1);
+        probes++;
+    }
+
+    if (s_table[i].ptr == key)
+    {
+        // In-place realloc: replace the old size.
+        uint32_t old = s_table[i].meta;
+        account(old & 0xff, -(int32_t)(old >> 8), -1);
+    }
+
+    if (s_table[i].ptr == key || s_table[i].ptr == 0)
+    {
+        s_table[i].ptr = key;
+        s_table[i].meta = ((uint32_t)size << 8) | tag;
+        account(tag, size, 1);
+    }
+    else
+    {
+        s_untracked++;
+    }
+    portEXIT_CRITICAL_SAFE(&s_lock);
+}
+
+void esp_heap_trace_free_hook(void *ptr)
+{
+    if (!ptr)
+        return;
+
+    uintptr_t key = (uintptr_t)ptr;
+
+    portENTER_CRITICAL_SAFE(&s_lock);
+    uint32_t i = slot_index(key);
+    for (int probes = 0; probes <= MAX_PROBES && s_table[i].ptr != 0; probes++)
+    {
+        if (s_table[i].ptr == key)
+        {
+            uint32_t meta = s_table[i].meta;
+            account(meta & 0xff, -(int32_t)(meta >> 8), -1);
+            table_remove(i);
+            break;
+        }
+        i = (i + 1) & (SLOT_COUNT - 1);
+    }
+    portEXIT_CRITICAL_SAFE(&s_lock);
+}
+
+#endif // CONFIG_HEAP_USE_HOOKS
+
+/* --- cJSON ALLOCATOR --- */
+
+static void *cjson_malloc(size_t size)
+{
+    heap_tag_t prev = heap_monitor_scope_set(HEAP_TAG_CJSON);
+    void *ptr = malloc(size);
+    heap_monitor_scope_set(prev);
+    return ptr;
+}
+
+/* --- INTERNAL HELPERS --- */
+
+static void region_stats(heap_region_stats_t *out, uint32_t caps)
+{
+    multi_heap_info_t info = {0};
+    heap_caps_get_info(&info, caps);
+
+    out->free_bytes = info.total_free_bytes;
+    out->largest_free_block = info.largest_free_block;
+    out->min_free_bytes = info.minimum_free_bytes;
+    out->fragmentation_pct = (info.total_free_bytes > 0)
+                                 ? 100 - (uint8_t)((uint64_t)info.largest_free_block * 100 / info.total_free_bytes)
+                                 : 0;
+}
+
+/* --- PUBLIC API --- */
+
+esp_err_t heap_monitor_init(void)
+{
+    for (int i = 0; i < MAX_SCOPES; i++)
+        s_scopes[i].tag = HEAP_TAG_NONE;
+
+    cJSON_Hooks hooks = {.malloc_fn = cjson_malloc, .free_fn = free};
+    cJSON_InitHooks(&hooks);
+
+#if !CONFIG_HEAP_USE_HOOKS
+    ESP_LOGW(TAG, "CONFIG_HEAP_USE_HOOKS is off; only fragmentation is reported.");
+#endif
+    return ESP_OK;
+}
+
+void heap_monitor_bind_tasks(void)
+{
+    // Names as created by IDF: lwIP "tiT", Wi-Fi "wifi", HTTP server "httpd".
+    s_task_lwip = xTaskGetHandle("tiT");
+    s_task_wifi = xTaskGetHandle("wifi");
+    s_task_httpd = xTaskGetHandle("httpd");
+}
+
+heap_tag_t heap_monitor_scope_set(heap_tag_t tag)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    heap_tag_t prev = HEAP_TAG_NONE;
+    int free_slot = -1;
+
+    portENTER_CRITICAL_SAFE(&s_lock);
+    int i = 0;
+    for (; i < MAX_SCOPES; i++)
+    {
+        if (s_scopes[i].task == task)
+            break;
+        if (free_slot < 0 && s_scopes[i].tag == HEAP_TAG_NONE)
+            free_slot = i;
+    }
+
+    if (i < MAX_SCOPES)
+    {
+        prev = s_scopes[i].tag;
+        s_scopes[i].tag = tag;
+    }
+    else if (free_slot >= 0 && tag != HEAP_TAG_NONE)
+    {
+        s_scopes[free_slot].task = task;
+        s_scopes[free_slot].tag = tag;
+    }
+    portEXIT_CRITICAL_SAFE(&s_lock);
+    return prev;
+}
+
+void heap_monitor_get_stats(heap_monitor_stats_t *out)
+{
+    if (!out)
+        return;
+
+    portENTER_CRITICAL_SAFE(&s_lock);
+    memcpy(out->tags, s_tags, sizeof(out->tags));
+    out->untracked_count = s_untracked;
+    portEXIT_CRITICAL_SAFE(&s_lock);
+
+    region_stats(&out->internal, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    region_stats(&out->psram, MALLOC_CAP_SPIRAM);
+}
+
+const char *heap_monitor_tag_name(heap_tag_t tag)
+{
+    if (tag >= HEAP_TAG_MAX)
+        return "unknown";
+    return s_tag_names[tag];
+}
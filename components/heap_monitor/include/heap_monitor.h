@@ -0,0 +1,76 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Per-component heap accounting.
+ * Allocations are attributed through the IDF heap hooks
+ * (CONFIG_HEAP_USE_HOOKS): first by an explicit scope set on the calling
+ * task, otherwise by which task allocates (lwIP, Wi-Fi, httpd).
+ */
+
+typedef enum
+{
+    HEAP_TAG_OTHER = 0,
+    HEAP_TAG_SERVER,
+    HEAP_TAG_AUTH,
+    HEAP_TAG_CJSON,
+    HEAP_TAG_LWIP,
+    HEAP_TAG_WIFI,
+    HEAP_TAG_MAX,
+    HEAP_TAG_NONE = 0xff // No scope override
+} heap_tag_t;
+
+typedef struct
+{
+    uint32_t live_bytes;
+    uint32_t peak_bytes;
+    uint32_t live_count;
+    uint32_t total_count; // Allocations since boot
+} heap_tag_stats_t;
+
+typedef struct
+{
+    uint32_t free_bytes;
+    uint32_t largest_free_block;
+    uint32_t min_free_bytes;
+    uint8_t fragmentation_pct; // 100 - largest block as % of free; 0 = contiguous
+} heap_region_stats_t;
+
+typedef struct
+{
+    heap_tag_stats_t tags[HEAP_TAG_MAX];
+    uint32_t untracked_count; // Allocations missed because the table was full
+    heap_region_stats_t internal;
+    heap_region_stats_t psram;
+} heap_monitor_stats_t;
+
+/**
+ * @brief Routes cJSON allocations through the monitor.
+ * Call before any other component uses cJSON.
+ */
+esp_err_t heap_monitor_init(void);
+
+/**
+ * @brief Resolves the Wi-Fi, lwIP and HTTP server task handles used for attribution.
+ * Call again after those tasks have been started.
+ */
+void heap_monitor_bind_tasks(void);
+
+/**
+ * @brief Attributes allocations made by the calling task to tag until reset.
+ * @return The previous scope, to be restored with another call.
+ */
+heap_tag_t heap_monitor_scope_set(heap_tag_t tag);
+
+/**
+ * @brief Snapshot of per-tag counters and fragmentation of internal RAM and PSRAM.
+ */
+void heap_monitor_get_stats(heap_monitor_stats_t *out);
+
+/**
+ * @brief Tag name, for logs and JSON.
+ */
+const char *heap_monitor_tag_name(heap_tag_t tag);
@@ -0,0 +1,290 @@
+#include "heap_monitor.h"
+#include "esp_heap_caps.h"
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The linux target's heap does not call the allocation hooks, so the tests
+ * call them directly with made-up addresses. Nothing is ever dereferenced.
+ */
+
+#define SLOT_COUNT CONFIG_HEAP_MONITOR_SLOTS
+#define MAX_PROBES 32               // As in heap_monitor.c
+#define FAKE_BASE 0x40000000u       // Multiple of 8 * SLOT_COUNT: does not move the home slot
+#define MODEL_KEYS 24               // Fewer than MAX_PROBES: the random test never overflows
+#define MODEL_STEPS 20000
+
+// Defined by heap_monitor; on target the heap calls them.
+void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps);
+void esp_heap_trace_free_hook(void *ptr);
+
+/* --- HELPERS --- */
+
+static heap_tag_stats_t tag_stats(heap_tag_t tag)
+{
+    heap_monitor_stats_t stats;
+    heap_monitor_get_stats(&stats);
+    return stats.tags[tag];
+}
+
+static uint32_t untracked(void)
+{
+    heap_monitor_stats_t stats;
+    heap_monitor_get_stats(&stats);
+    return stats.untracked_count;
+}
+
+static void alloc_as(heap_tag_t tag, void *ptr, size_t size)
+{
+    heap_tag_t prev = heap_monitor_scope_set(tag);
+    esp_heap_trace_alloc_hook(ptr, size, MALLOC_CAP_8BIT);
+    heap_monitor_scope_set(prev);
+}
+
+// The n-th address whose home slot is slot. Mirrors slot_index() in heap_monitor.c.
+static void *key_for_slot(uint32_t slot, uint32_t n)
+{
+    for (uint32_t x = 0; x < SLOT_COUNT; x++)
+    {
+        if (((x * 2654435761u) & (SLOT_COUNT - 1)) == slot)
+            return (void *)(uintptr_t)(FAKE_BASE + 8 * (x + n * SLOT_COUNT));
+    }
+    return NULL;
+}
+
+/* --- TABLE --- */
+
+static void test_alloc_and_free(void)
+{
+    heap_tag_stats_t before = tag_stats(HEAP_TAG_AUTH);
+    void *p = key_for_slot(5, 0);
+
+    alloc_as(HEAP_TAG_AUTH, p, 100);
+    heap_tag_stats_t during = tag_stats(HEAP_TAG_AUTH);
+    TEST_ASSERT_EQUAL_UINT32(before.live_bytes + 100, during.live_bytes);
+    TEST_ASSERT_EQUAL_UINT32(before.live_count + 1, during.live_count);
+    TEST_ASSERT_EQUAL_UINT32(before.total_count + 1, during.total_count);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(during.live_bytes, during.peak_bytes);
+
+    // Freed from any scope: the tag is stored with the entry
+    esp_heap_trace_free_hook(p);
+    heap_tag_stats_t after = tag_stats(HEAP_TAG_AUTH);
+    TEST_ASSERT_EQUAL_UINT32(before.live_bytes, after.live_bytes);
+    TEST_ASSERT_EQUAL_UINT32(before.live_count, after.live_count);
+    TEST_ASSERT_EQUAL_UINT32(during.total_count, after.total_count);
+    TEST_ASSERT_EQUAL_UINT32(during.peak_bytes, after.peak_bytes);
+
+    // Unknown and NULL pointers are ignored
+    esp_heap_trace_free_hook(p);
+    esp_heap_trace_free_hook(NULL);
+    esp_heap_trace_alloc_hook(NULL, 64, MALLOC_CAP_8BIT);
+    TEST_ASSERT_EQUAL_UINT32(before.live_count, tag_stats(HEAP_TAG_AUTH).live_count);
+}
+
+static void test_realloc_in_place(void)
+{
+    heap_tag_stats_t before = tag_stats(HEAP_TAG_AUTH);
+    void *p = key_for_slot(9, 0);
+
+    alloc_as(HEAP_TAG_AUTH, p, 100);
+    alloc_as(HEAP_TAG_AUTH, p, 300); // Same address, new size
+    heap_tag_stats_t during = tag_stats(HEAP_TAG_AUTH);
+    TEST_ASSERT_EQUAL_UINT32(before.live_bytes + 300, during.live_bytes);
+    TEST_ASSERT_EQUAL_UINT32(before.live_count + 1, during.live_count);
+
+    esp_heap_trace_free_hook(p);
+    TEST_ASSERT_EQUAL_UINT32(before.live_bytes, tag_stats(HEAP_TAG_AUTH).live_bytes);
+}
+
+// Entries displaced by collisions must still be found after the entries
+// before them are freed (backward-shift delete), also across the table end.
+static void test_collisions_wrap(void)
+{
+    heap_tag_stats_t before = tag_stats(HEAP_TAG_AUTH);
+    const uint32_t home = SLOT_COUNT - 2;
+    void *chain[6];
+    for (uint32_t n = 0; n < 6; n++) // Occupies the last two slots and the first four
+    {
+        chain[n] = key_for_slot(home, n);
+        alloc_as(HEAP_TAG_AUTH, chain[n], 10);
+    }
+    void *at_zero = key_for_slot(0, 0); // Home slot taken by the chain: lands behind it
+    alloc_as(HEAP_TAG_AUTH, at_zero, 1000);
+
+    esp_heap_trace_free_hook(chain[0]);
+    esp_heap_trace_free_hook(chain[3]);
+    TEST_ASSERT_EQUAL_UINT32(before.live_bytes + 4 * 10 + 1000, tag_stats(HEAP_TAG_AUTH).live_bytes);
+
+    esp_heap_trace_free_hook(at_zero);
+    TEST_ASSERT_EQUAL_UINT32(before.live_bytes + 4 * 10, tag_stats(HEAP_TAG_AUTH).live_bytes);
+    for (uint32_t n = 1; n < 6; n++)
+    {
+        if (n != 3)
+            esp_heap_trace_free_hook(chain[n]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(before.live_bytes, tag_stats(HEAP_TAG_AUTH).live_bytes);
+    TEST_ASSERT_EQUAL_UINT32(before.live_count, tag_stats(HEAP_TAG_AUTH).live_count);
+}
+
+static void test_probe_limit(void)
+{
+    heap_tag_stats_t before = tag_stats(HEAP_TAG_AUTH);
+    uint32_t lost = untracked();
+    void *keys[MAX_PROBES + 2];
+
+    // The home slot and MAX_PROBES more are searched; one more does not fit
+    for (uint32_t n = 0; n < MAX_PROBES + 2; n++)
+    {
+        keys[n] = key_for_slot(40, n);
+        alloc_as(HEAP_TAG_AUTH, keys[n], 1);
+    }
+    TEST_ASSERT_EQUAL_UINT32(lost + 1, untracked());
+    TEST_ASSERT_EQUAL_UINT32(before.live_count + MAX_PROBES + 1, tag_stats(HEAP_TAG_AUTH).live_count);
+
+    for (uint32_t n = 0; n < MAX_PROBES + 2; n++)
+        esp_heap_trace_free_hook(keys[n]); // The untracked one is not found and not counted
+    TEST_ASSERT_EQUAL_UINT32(before.live_count, tag_stats(HEAP_TAG_AUTH).live_count);
+    TEST_ASSERT_EQUAL_UINT32(before.live_bytes, tag_stats(HEAP_TAG_AUTH).live_bytes);
+}
+
+// Random allocations and frees of a few keys packed around the table end,
+// checked against a plain array after every step.
+static void test_random_against_model(void)
+{
+    heap_tag_stats_t before = tag_stats(HEAP_TAG_AUTH);
+    uint32_t lost = untracked();
+    void *keys[MODEL_KEYS];
+    uint32_t sizes[MODEL_KEYS] = {0}; // 0: not allocated
+    uint32_t live_bytes = 0, live_count = 0;
+
+    for (uint32_t i = 0; i < MODEL_KEYS; i++)
+        keys[i] = key_for_slot((SLOT_COUNT - 4 + i / 3) & (SLOT_COUNT - 1), i % 3);
+
+    srand(1);
+    for (int step = 0; step < MODEL_STEPS; step++)
+    {
+        uint32_t i = rand() % MODEL_KEYS;
+        if (sizes[i] == 0 || rand() % 4 == 0) // Sometimes an in-place realloc
+        {
+            uint32_t size = 1 + rand() % 4096;
+            alloc_as(HEAP_TAG_AUTH, keys[i], size);
+            live_count += (sizes[i] == 0);
+            live_bytes += size - sizes[i];
+            sizes[i] = size;
+        }
+        else
+        {
+            esp_heap_trace_free_hook(keys[i]);
+            live_bytes -= sizes[i];
+            live_count--;
+            sizes[i] = 0;
+        }
+
+        heap_tag_stats_t now = tag_stats(HEAP_TAG_AUTH);
+        TEST_ASSERT_EQUAL_UINT32(before.live_bytes + live_bytes, now.live_bytes);
+        TEST_ASSERT_EQUAL_UINT32(before.live_count + live_count, now.live_count);
+    }
+    TEST_ASSERT_EQUAL_UINT32(lost, untracked());
+
+    for (uint32_t i = 0; i < MODEL_KEYS; i++)
+    {
+        if (sizes[i])
+            esp_heap_trace_free_hook(keys[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(before.live_bytes, tag_stats(HEAP_TAG_AUTH).live_bytes);
+}
+
+/* --- TAGS --- */
+
+static void test_scope_nesting(void)
+{
+    TEST_ASSERT_EQUAL(HEAP_TAG_NONE, heap_monitor_scope_set(HEAP_TAG_SERVER));
+    TEST_ASSERT_EQUAL(HEAP_TAG_SERVER, heap_monitor_scope_set(HEAP_TAG_CJSON));
+
+    heap_tag_stats_t cjson = tag_stats(HEAP_TAG_CJSON);
+    void *p = key_for_slot(70, 0);
+    esp_heap_trace_alloc_hook(p, 48, MALLOC_CAP_8BIT); // Innermost scope wins
+    TEST_ASSERT_EQUAL_UINT32(cjson.live_bytes + 48, tag_stats(HEAP_TAG_CJSON).live_bytes);
+    esp_heap_trace_free_hook(p);
+
+    TEST_ASSERT_EQUAL(HEAP_TAG_CJSON, heap_monitor_scope_set(HEAP_TAG_SERVER));
+    TEST_ASSERT_EQUAL(HEAP_TAG_SERVER, heap_monitor_scope_set(HEAP_TAG_NONE));
+
+    // No scope and not a known task
+    heap_tag_stats_t other = tag_stats(HEAP_TAG_OTHER);
+    esp_heap_trace_alloc_hook(p, 16, MALLOC_CAP_8BIT);
+    TEST_ASSERT_EQUAL_UINT32(other.live_bytes + 16, tag_stats(HEAP_TAG_OTHER).live_bytes);
+    esp_heap_trace_free_hook(p);
+    TEST_ASSERT_EQUAL_UINT32(other.live_bytes, tag_stats(HEAP_TAG_OTHER).live_bytes);
+}
+
+typedef struct
+{
+    void *ptr;
+    SemaphoreHandle_t done;
+} task_job_t;
+
+static void alloc_task(void *arg)
+{
+    task_job_t *job = arg;
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // Until heap_monitor_bind_tasks() has run
+    esp_heap_trace_alloc_hook(job->ptr, 200, MALLOC_CAP_8BIT);
+    xSemaphoreGive(job->done);
+    vTaskDelete(NULL);
+}
+
+static void test_task_attribution(void)
+{
+    // Named like the IDF tasks heap_monitor_bind_tasks() looks up
+    static const struct
+    {
+        const char *name;
+        heap_tag_t tag;
+    } cases[] = {{"httpd", HEAP_TAG_SERVER}, {"tiT", HEAP_TAG_LWIP}, {"wifi", HEAP_TAG_WIFI}};
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+    {
+        task_job_t job = {.ptr = key_for_slot(80 + c, 0), .done = xSemaphoreCreateBinary()};
+        TEST_ASSERT_NOT_NULL(job.done);
+        heap_tag_stats_t before = tag_stats(cases[c].tag);
+
+        TaskHandle_t task = NULL;
+        TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(alloc_task, cases[c].name, 4096, &job, 5, &task));
+        heap_monitor_bind_tasks();
+        xTaskNotifyGive(task);
+        TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(job.done, pdMS_TO_TICKS(5000)));
+        vSemaphoreDelete(job.done);
+
+        TEST_ASSERT_EQUAL_UINT32(before.live_bytes + 200, tag_stats(cases[c].tag).live_bytes);
+        esp_heap_trace_free_hook(job.ptr); // Freed by another task: still charged back to the owner
+        TEST_ASSERT_EQUAL_UINT32(before.live_bytes, tag_stats(cases[c].tag).live_bytes);
+    }
+}
+
+static void test_tag_names(void)
+{
+    TEST_ASSERT_EQUAL_STRING("server_manager", heap_monitor_tag_name(HEAP_TAG_SERVER));
+    TEST_ASSERT_EQUAL_STRING("cjson", heap_monitor_tag_name(HEAP_TAG_CJSON));
+    TEST_ASSERT_EQUAL_STRING("unknown", heap_monitor_tag_name(HEAP_TAG_MAX));
+    TEST_ASSERT_EQUAL_STRING("unknown", heap_monitor_tag_name(HEAP_TAG_NONE));
+}
+
+void app_main(void)
+{
+    ESP_ERROR_CHECK(heap_monitor_init());
+
+    UNITY_BEGIN();
+    RUN_TEST(test_alloc_and_free);
+    RUN_TEST(test_realloc_in_place);
+    RUN_TEST(test_collisions_wrap);
+    RUN_TEST(test_probe_limit);
+    RUN_TEST(test_random_against_model);
+    RUN_TEST(test_scope_nesting);
+    RUN_TEST(test_task_attribution);
+    RUN_TEST(test_tag_names);
+    exit(UNITY_END());
+}
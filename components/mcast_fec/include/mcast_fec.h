@@ -0,0 +1,64 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Receive side of the multicast OTA block code (no radio, no sockets).
+ * The image is cut into blocks of block_size, the blocks into groups of k,
+ * and each group carries r repair blocks: repair block j is the sum over the
+ * group's data blocks i of d_i / ((k + j) ^ i) in GF(2^8), polynomial 0x11d,
+ * the last block zero-padded. That is what tools/mcast_send.py sends.
+ * Blocks may arrive in any order and more than once; a group is rebuilt as
+ * soon as any k of its k + r blocks are held.
+ */
+
+#define MCAST_FEC_MAX_K 32
+#define MCAST_FEC_MAX_R 8
+#define MCAST_FEC_REPAIR_CACHE 4 // Groups whose repair blocks are held at once
+
+typedef struct
+{
+    uint32_t group; // UINT32_MAX when free
+    uint32_t seq;   // Oldest is evicted first
+    uint8_t have;   // Bitmask of repair indices held
+    uint8_t *blocks;
+} mcast_fec_slot_t;
+
+typedef struct
+{
+    uint32_t image_size;
+    uint16_t block_size;
+    uint8_t k;
+    uint8_t r;
+    uint32_t n_blocks;
+    uint32_t n_groups;
+    uint32_t groups_left;
+    uint8_t *image; // n_blocks * block_size, PSRAM when present; NULL when closed
+    uint8_t *have;  // Bitmap of data blocks held
+    uint8_t *count; // Data blocks held (or rebuilt) per group
+    mcast_fec_slot_t repair[MCAST_FEC_REPAIR_CACHE];
+    uint8_t *repair_mem;
+    uint32_t repair_seq;
+} mcast_fec_t;
+
+/**
+ * @brief Allocates the image and the repair cache for one transfer.
+ * @return ESP_ERR_INVALID_ARG if k or r is out of range or a size is 0.
+ * @return ESP_ERR_NO_MEM if the image does not fit.
+ */
+esp_err_t mcast_fec_open(mcast_fec_t *fec, uint32_t image_size, uint16_t block_size, uint8_t k, uint8_t r);
+
+/** @brief Frees what mcast_fec_open() allocated. Safe on a closed or failed fec. */
+void mcast_fec_close(mcast_fec_t *fec);
+
+/**
+ * @brief Takes one block of block_size bytes.
+ * @param index  < k: data block, else repair block index - k.
+ * Out-of-range, duplicate and late blocks are ignored.
+ */
+void mcast_fec_add(mcast_fec_t *fec, uint32_t group, uint8_t index, const uint8_t *block);
+
+/** @brief True once every data block of the group is held or rebuilt. */
+bool mcast_fec_group_done(const mcast_fec_t *fec, uint32_t group);
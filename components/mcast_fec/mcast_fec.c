@@ -0,0 +1,293 @@
+#include "mcast_fec.h"
+#include "esp_heap_caps.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define GF_POLY 0x11d
+
+static uint8_t s_gf_exp[512];
+static uint8_t s_gf_log[256];
+
+/* --- GF(2^8) CAUCHY CODE --- */
+
+static void gf_init(void)
+{
+    unsigned x = 1;
+    for (int i = 0; i < 255; i++)
+    {
+        s_gf_exp[i] = x;
+        s_gf_log[x] = i;
+        x <<= 1;
+        if (x & 0x100)
+            x ^= GF_POLY;
+    }
+    for (int i = 255; i < 512; i++)
+        s_gf_exp[i] = s_gf_exp[i - 255];
+}
+
+static uint8_t gf_mul(uint8_t a, uint8_t b)
+{
+    return (a && b) ? s_gf_exp[s_gf_log[a] + s_gf_log[b]] : 0;
+}
+
+static uint8_t gf_inv(uint8_t a)
+{
+    return s_gf_exp[255 - s_gf_log[a]];
+}
+
+/* Weight of data block i in repair block j: 1 / (x_j + y_i) with x_j = k + j, y_i = i.
+ * Every square submatrix of a Cauchy matrix is invertible, so any e lost
+ * blocks are rebuilt from any e repair blocks. */
+static uint8_t coef(uint8_t k, uint8_t j, uint8_t i)
+{
+    return gf_inv((uint8_t)((k + j) ^ i));
+}
+
+/* dst ^= c * src */
+static void gf_mul_add(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len)
+{
+    if (c == 0)
+        return;
+
+    uint8_t row[256];
+    for (int v = 0; v < 256; v++)
+        row[v] = gf_mul(c, v);
+    for (size_t n = 0; n < len; n++)
+        dst[n] ^= row[src[n]];
+}
+
+/* Inverts the e x e matrix m in place (Gauss-Jordan). */
+static bool gf_invert(uint8_t m[MCAST_FEC_MAX_R][MCAST_FEC_MAX_R], int e)
+{
+    uint8_t inv[MCAST_FEC_MAX_R][MCAST_FEC_MAX_R] = {0};
+    for (int i = 0; i < e; i++)
+        inv[i][i] = 1;
+
+    for (int col = 0; col < e; col++)
+    {
+        int pivot = col;
+        while (pivot < e && m[pivot][col] == 0)
+            pivot++;
+        if (pivot == e)
+            return false;
+
+        for (int c = 0; c < e; c++)
+        {
+            uint8_t t = m[col][c];
+            m[col][c] = m[pivot][c];
+            m[pivot][c] = t;
+            t = inv[col][c];
+            inv[col][c] = inv[pivot][c];
+            inv[pivot][c] = t;
+        }
+
+        uint8_t scale = gf_inv(m[col][col]);
+        for (int c = 0; c < e; c++)
+        {
+            m[col][c] = gf_mul(m[col][c], scale);
+            inv[col][c] = gf_mul(inv[col][c], scale);
+        }
+
+        for (int r = 0; r < e; r++)
+        {
+            uint8_t f = m[r][col];
+            if (r == col || f == 0)
+                continue;
+            for (int c = 0; c < e; c++)
+            {
+                m[r][c] ^= gf_mul(f, m[col][c]);
+                inv[r][c] ^= gf_mul(f, inv[col][c]);
+            }
+        }
+    }
+
+    memcpy(m, inv, sizeof(inv));
+    return true;
+}
+
+/* --- GROUPS --- */
+
+static bool block_held(const mcast_fec_t *fec, uint32_t b)
+{
+    return fec->have[b >> 3] & (1u << (b & 7));
+}
+
+static void block_mark(mcast_fec_t *fec, uint32_t b)
+{
+    fec->have[b >> 3] |= 1u << (b & 7);
+}
+
+static uint8_t group_size(const mcast_fec_t *fec, uint32_t g)
+{
+    uint32_t left = fec->n_blocks - g * fec->k;
+    return (left < fec->k) ? left : fec->k;
+}
+
+static mcast_fec_slot_t *repair_find(mcast_fec_t *fec, uint32_t g, bool create)
+{
+    mcast_fec_slot_t *victim = &fec->repair[0];
+    for (int i = 0; i < MCAST_FEC_REPAIR_CACHE; i++)
+    {
+        if (fec->repair[i].group == g)
+            return &fec->repair[i];
+        if (fec->repair[i].seq < victim->seq) // Free slots have seq 0
+            victim = &fec->repair[i];
+    }
+    if (!create || fec->r == 0)
+        return NULL;
+
+    victim->group = g;
+    victim->seq = ++fec->repair_seq;
+    victim->have = 0;
+    return victim;
+}
+
+/* Rebuilds the missing data blocks of group g from the cached repair blocks.
+ * The repair blocks are turned into syndromes in place. */
+static void group_decode(mcast_fec_t *fec, uint32_t g, mcast_fec_slot_t *slot)
+{
+    const size_t bs = fec->block_size;
+    const uint8_t k = fec->k;
+    const uint32_t first = g * k;
+    const uint8_t kg = group_size(fec, g);
+
+    uint8_t lost[MCAST_FEC_MAX_R], rows[MCAST_FEC_MAX_R];
+    int e = 0, m = 0;
+    for (uint8_t i = 0; i < kg && e < MCAST_FEC_MAX_R; i++)
+    {
+        if (!block_held(fec, first + i))
+            lost[e++] = i;
+    }
+    for (uint8_t j = 0; j < fec->r && m < e; j++)
+    {
+        if (slot->have & (1u << j))
+            rows[m++] = j;
+    }
+    if (m < e)
+        return;
+
+    uint8_t mat[MCAST_FEC_MAX_R][MCAST_FEC_MAX_R];
+    for (int a = 0; a < e; a++)
+    {
+        uint8_t *syn = slot->blocks + rows[a] * bs;
+        for (uint8_t i = 0; i < kg; i++)
+        {
+            if (block_held(fec, first + i))
+                gf_mul_add(syn, fec->image + (first + i) * bs, coef(k, rows[a], i), bs);
+        }
+        for (int b = 0; b < e; b++)
+            mat[a][b] = coef(k, rows[a], lost[b]);
+    }
+    if (!gf_invert(mat, e))
+        return;
+
+    for (int b = 0; b < e; b++)
+    {
+        uint8_t *dst = fec->image + (first + lost[b]) * bs;
+        memset(dst, 0, bs);
+        for (int a = 0; a < e; a++)
+            gf_mul_add(dst, slot->blocks + rows[a] * bs, mat[b][a], bs);
+        block_mark(fec, first + lost[b]);
+    }
+    fec->count[g] = kg;
+}
+
+/* --- PUBLIC API --- */
+
+esp_err_t mcast_fec_open(mcast_fec_t *fec, uint32_t image_size, uint16_t block_size, uint8_t k, uint8_t r)
+{
+    if (image_size == 0 || block_size == 0 || k == 0 || k > MCAST_FEC_MAX_K || r > MCAST_FEC_MAX_R)
+        return ESP_ERR_INVALID_ARG;
+    if (s_gf_exp[0] == 0)
+        gf_init();
+
+    const uint32_t caps = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+    memset(fec, 0, sizeof(*fec));
+    fec->image_size = image_size;
+    fec->block_size = block_size;
+    fec->k = k;
+    fec->r = r;
+    fec->n_blocks = (image_size + block_size - 1) / block_size;
+    fec->n_groups = (fec->n_blocks + k - 1) / k;
+    fec->groups_left = fec->n_groups;
+
+    // Zeroed, so the padding of the last block matches what the sender encoded.
+    fec->image = heap_caps_calloc_prefer(fec->n_blocks, block_size, 2, caps, MALLOC_CAP_DEFAULT);
+    fec->have = calloc((fec->n_blocks + 7) / 8, 1);
+    fec->count = calloc(fec->n_groups, 1);
+    if (r > 0)
+        fec->repair_mem = heap_caps_malloc_prefer(MCAST_FEC_REPAIR_CACHE * r * block_size, 2, caps, MALLOC_CAP_DEFAULT);
+
+    if (!fec->image || !fec->have || !fec->count || (r > 0 && !fec->repair_mem))
+    {
+        mcast_fec_close(fec);
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (int i = 0; i < MCAST_FEC_REPAIR_CACHE; i++)
+    {
+        fec->repair[i].group = UINT32_MAX;
+        fec->repair[i].blocks = fec->repair_mem ? fec->repair_mem + i * r * block_size : NULL;
+    }
+    return ESP_OK;
+}
+
+void mcast_fec_close(mcast_fec_t *fec)
+{
+    heap_caps_free(fec->image);
+    heap_caps_free(fec->repair_mem);
+    free(fec->have);
+    free(fec->count);
+    memset(fec, 0, sizeof(*fec));
+}
+
+void mcast_fec_add(mcast_fec_t *fec, uint32_t group, uint8_t index, const uint8_t *block)
+{
+    const size_t bs = fec->block_size;
+    if (!fec->image || group >= fec->n_groups)
+        return;
+
+    const uint8_t kg = group_size(fec, group);
+    if (fec->count[group] >= kg)
+        return; // Already complete
+
+    if (index < fec->k)
+    {
+        uint32_t b = group * fec->k + index;
+        if (index >= kg || block_held(fec, b))
+            return;
+        memcpy(fec->image + b * bs, block, bs);
+        block_mark(fec, b);
+        fec->count[group]++;
+    }
+    else
+    {
+        uint8_t j = index - fec->k;
+        if (j >= fec->r)
+            return;
+        mcast_fec_slot_t *slot = repair_find(fec, group, true);
+        if (slot->have & (1u << j))
+            return;
+        memcpy(slot->blocks + j * bs, block, bs);
+        slot->have |= 1u << j;
+    }
+
+    mcast_fec_slot_t *slot = repair_find(fec, group, false);
+    if (slot && fec->count[group] < kg && fec->count[group] + __builtin_popcount(slot->have) >= kg)
+        group_decode(fec, group, slot);
+
+    if (fec->count[group] >= kg)
+    {
+        fec->groups_left--;
+        if (slot)
+        {
+            slot->group = UINT32_MAX;
+            slot->seq = 0;
+        }
+    }
+}
+
+bool mcast_fec_group_done(const mcast_fec_t *fec, uint32_t group)
+{
+    return group < fec->n_groups && fec->count[group] >= group_size(fec, group);
+}
@@ -0,0 +1,412 @@
+#include "mcast_fec.h"
+#include "unity.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Repair blocks come from a reference encoder written the slow way (bitwise
+ * multiply, inverse by exponentiation), checked against vectors from
+ * tools/mcast_send.py, so the device tables and the sender are both pinned.
+ */
+
+#define GOLDEN_K 5
+#define GOLDEN_R 3
+#define GOLDEN_BS 16
+#define GOLDEN_SIZE 101 // 7 blocks, the last one padded; groups of 5 and 2
+
+#define SMALL_K 4 // Exhaustive patterns: 2^k lost sets times 2^k held sets
+#define SMALL_BS 8
+
+#define RANDOM_RUNS 200
+#define MAX_ROUNDS 50 // The sender would give up long before
+
+typedef struct
+{
+    uint32_t group;
+    uint8_t index;
+} packet_t;
+
+/* python3 -c "import sys; sys.path.insert(0, 'tools'); import mcast_send as m
+ * img = bytes((n * 7 + 3) & 0xff for n in range(101)) + bytes(11)
+ * b = [img[i:i + 16] for i in range(0, 112, 16)]
+ * [print(x.hex()) for g in (0, 1) for x in m.repair_blocks(b[g * 5:g * 5 + 5], 5, 3)]" */
+static const uint8_t s_golden_repair[2][GOLDEN_R][GOLDEN_BS] = {
+    {
+        {0x87, 0xb3, 0x2c, 0x18, 0xff, 0xb8, 0xce, 0x03, 0xf1, 0x3a, 0x4c, 0xb1, 0x56, 0x62, 0x38, 0x0c},
+        {0xb7, 0x00, 0xbd, 0x0a, 0x67, 0x31, 0xc7, 0x0e, 0x7a, 0x97, 0x61, 0xc2, 0xaf, 0x18, 0x2f, 0x98},
+        {0x44, 0x7e, 0xe3, 0xd9, 0xcf, 0x93, 0x1c, 0x24, 0xdc, 0xaa, 0x25, 0xc6, 0xd0, 0xea, 0x7a, 0x40},
+    },
+    {
+        {0xee, 0x5d, 0x7e, 0xcd, 0x57, 0xe5, 0x40, 0x4d, 0x4e, 0x1a, 0xbf, 0x79, 0x2b, 0xdd, 0xda, 0x2c},
+        {0xd4, 0x5a, 0xc5, 0x4b, 0x31, 0x19, 0x60, 0xe5, 0x69, 0x17, 0x6e, 0xcb, 0xb0, 0x3d, 0xb7, 0x3a},
+        {0xdc, 0x52, 0xa2, 0x2c, 0x56, 0x75, 0x1f, 0xad, 0x15, 0x79, 0x13, 0x5f, 0x5e, 0x5d, 0x58, 0x5b},
+    },
+};
+
+static uint32_t s_rand = 0x2545f491;
+
+/* --- REFERENCE ENCODER --- */
+
+static uint8_t ref_mul(uint8_t a, uint8_t b)
+{
+    unsigned p = 0, x = a;
+    for (; b; b >>= 1)
+    {
+        if (b & 1)
+            p ^= x;
+        x <<= 1;
+        if (x & 0x100)
+            x ^= 0x11d;
+    }
+    return p;
+}
+
+// a^254 = 1 / a
+static uint8_t ref_inv(uint8_t a)
+{
+    uint8_t p = 1;
+    for (int n = 0; n < 254; n++)
+        p = ref_mul(p, a);
+    return p;
+}
+
+/* A whole image in the sender's layout: padded blocks, then r repair blocks per group. */
+typedef struct
+{
+    uint32_t size;
+    uint16_t bs;
+    uint8_t k, r;
+    uint32_t n_blocks, n_groups;
+    uint8_t *data;   // n_blocks * bs, zero-padded
+    uint8_t *repair; // n_groups * r * bs
+} stream_t;
+
+static const uint8_t *stream_block(const stream_t *st, uint32_t g, uint8_t index)
+{
+    if (index < st->k)
+        return st->data + (g * st->k + index) * st->bs;
+    return st->repair + (g * st->r + index - st->k) * st->bs;
+}
+
+static uint8_t stream_group_size(const stream_t *st, uint32_t g)
+{
+    uint32_t left = st->n_blocks - g * st->k;
+    return (left < st->k) ? left : st->k;
+}
+
+static void stream_init(stream_t *st, const uint8_t *image, uint32_t size, uint16_t bs, uint8_t k, uint8_t r)
+{
+    st->size = size;
+    st->bs = bs;
+    st->k = k;
+    st->r = r;
+    st->n_blocks = (size + bs - 1) / bs;
+    st->n_groups = (st->n_blocks + k - 1) / k;
+    st->data = calloc(st->n_blocks, bs);
+    st->repair = calloc(st->n_groups * (r ? r : 1), bs);
+    TEST_ASSERT_NOT_NULL(st->data);
+    TEST_ASSERT_NOT_NULL(st->repair);
+    memcpy(st->data, image, size);
+
+    for (uint32_t g = 0; g < st->n_groups; g++)
+    {
+        for (uint8_t j = 0; j < r; j++)
+        {
+            uint8_t *out = (uint8_t *)stream_block(st, g, k + j);
+            for (uint8_t i = 0; i < stream_group_size(st, g); i++)
+            {
+                uint8_t c = ref_inv((uint8_t)((k + j) ^ i));
+                const uint8_t *in = stream_block(st, g, i);
+                for (uint16_t n = 0; n < bs; n++)
+                    out[n] ^= ref_mul(c, in[n]);
+            }
+        }
+    }
+}
+
+static void stream_free(stream_t *st)
+{
+    free(st->data);
+    free(st->repair);
+}
+
+/* --- HELPERS --- */
+
+// xorshift32
+static uint32_t next_rand(void)
+{
+    s_rand ^= s_rand << 13;
+    s_rand ^= s_rand >> 17;
+    s_rand ^= s_rand << 5;
+    return s_rand;
+}
+
+static void shuffle(packet_t *p, size_t n)
+{
+    for (size_t i = n; i > 1; i--)
+    {
+        size_t j = next_rand() % i;
+        packet_t t = p[i - 1];
+        p[i - 1] = p[j];
+        p[j] = t;
+    }
+}
+
+static void open_for(mcast_fec_t *fec, const stream_t *st)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, mcast_fec_open(fec, st->size, st->bs, st->k, st->r));
+    TEST_ASSERT_EQUAL_UINT32(st->n_groups, fec->n_groups);
+}
+
+static void assert_complete(const mcast_fec_t *fec, const stream_t *st)
+{
+    TEST_ASSERT_EQUAL_UINT32(0, fec->groups_left);
+    for (uint32_t g = 0; g < st->n_groups; g++)
+        TEST_ASSERT_TRUE(mcast_fec_group_done(fec, g));
+    TEST_ASSERT_EQUAL_MEMORY(st->data, fec->image, st->n_blocks * st->bs);
+}
+
+/* Lists the group's packets, minus `lost` randomly chosen ones. */
+static size_t group_packets(const stream_t *st, uint32_t g, int lost, packet_t *out)
+{
+    packet_t all[MCAST_FEC_MAX_K + MCAST_FEC_MAX_R];
+    size_t n = 0;
+    for (uint8_t i = 0; i < stream_group_size(st, g); i++)
+        all[n++] = (packet_t){g, i};
+    for (uint8_t j = 0; j < st->r; j++)
+        all[n++] = (packet_t){g, st->k + j};
+    shuffle(all, n);
+    n -= lost;
+    memcpy(out, all, n * sizeof(*out));
+    return n;
+}
+
+static void make_image(uint8_t *image, uint32_t size)
+{
+    for (uint32_t n = 0; n < size; n++)
+        image[n] = next_rand();
+}
+
+/* --- TESTS --- */
+
+static void test_reference_matches_sender(void)
+{
+    uint8_t image[GOLDEN_SIZE];
+    for (int n = 0; n < GOLDEN_SIZE; n++)
+        image[n] = (n * 7 + 3) & 0xff;
+
+    stream_t st;
+    stream_init(&st, image, GOLDEN_SIZE, GOLDEN_BS, GOLDEN_K, GOLDEN_R);
+    TEST_ASSERT_EQUAL_UINT32(2, st.n_groups);
+    TEST_ASSERT_EQUAL_MEMORY(s_golden_repair, st.repair, sizeof(s_golden_repair));
+    stream_free(&st);
+}
+
+/* The sender's own repair blocks rebuild both groups, the short last one included. */
+static void test_golden_rebuild(void)
+{
+    uint8_t image[GOLDEN_SIZE];
+    for (int n = 0; n < GOLDEN_SIZE; n++)
+        image[n] = (n * 7 + 3) & 0xff;
+    stream_t st;
+    stream_init(&st, image, GOLDEN_SIZE, GOLDEN_BS, GOLDEN_K, GOLDEN_R);
+
+    mcast_fec_t fec;
+    open_for(&fec, &st);
+    // Group 0: data 1 and 3 only, then all repair blocks. Group 1: repair 2 and 0.
+    mcast_fec_add(&fec, 0, GOLDEN_K + 2, s_golden_repair[0][2]);
+    mcast_fec_add(&fec, 1, GOLDEN_K + 2, s_golden_repair[1][2]);
+    mcast_fec_add(&fec, 0, 3, stream_block(&st, 0, 3));
+    mcast_fec_add(&fec, 0, GOLDEN_K + 0, s_golden_repair[0][0]);
+    TEST_ASSERT_FALSE(mcast_fec_group_done(&fec, 0));
+    mcast_fec_add(&fec, 0, 1, stream_block(&st, 0, 1));
+    TEST_ASSERT_FALSE(mcast_fec_group_done(&fec, 0));
+    mcast_fec_add(&fec, 0, GOLDEN_K + 1, s_golden_repair[0][1]);
+    TEST_ASSERT_TRUE(mcast_fec_group_done(&fec, 0));
+    TEST_ASSERT_FALSE(mcast_fec_group_done(&fec, 1));
+    mcast_fec_add(&fec, 1, GOLDEN_K + 0, s_golden_repair[1][0]);
+
+    assert_complete(&fec, &st);
+    mcast_fec_close(&fec);
+    stream_free(&st);
+}
+
+/* Every set of lost data blocks against every set of repair blocks held:
+ * decodes exactly when there are at least as many, which walks the
+ * inversion through every square submatrix of the code. */
+static void test_every_loss_pattern(void)
+{
+    uint8_t image[SMALL_K * SMALL_BS];
+    make_image(image, sizeof(image));
+    stream_t st;
+    stream_init(&st, image, sizeof(image), SMALL_BS, SMALL_K, SMALL_K);
+
+    for (unsigned lost = 0; lost < (1u << SMALL_K); lost++)
+    {
+        for (unsigned held = 0; held < (1u << SMALL_K); held++)
+        {
+            mcast_fec_t fec;
+            open_for(&fec, &st);
+            for (uint8_t j = 0; j < SMALL_K; j++)
+            {
+                if (held & (1u << j))
+                    mcast_fec_add(&fec, 0, SMALL_K + j, stream_block(&st, 0, SMALL_K + j));
+            }
+            for (uint8_t i = 0; i < SMALL_K; i++)
+            {
+                if (!(lost & (1u << i)))
+                    mcast_fec_add(&fec, 0, i, stream_block(&st, 0, i));
+            }
+
+            if (__builtin_popcount(held) >= __builtin_popcount(lost))
+                assert_complete(&fec, &st);
+            else
+                TEST_ASSERT_FALSE(mcast_fec_group_done(&fec, 0));
+            mcast_fec_close(&fec);
+        }
+    }
+    stream_free(&st);
+}
+
+/* Random sizes and codes; each group loses up to r blocks and arrives
+ * shuffled with the other groups of its window (no more groups in flight
+ * than the repair cache holds, as the sender paces them). One pass rebuilds all. */
+static void test_random_loss_one_pass(void)
+{
+    for (int run = 0; run < RANDOM_RUNS; run++)
+    {
+        uint8_t k = 1 + next_rand() % MCAST_FEC_MAX_K;
+        uint8_t r = next_rand() % (MCAST_FEC_MAX_R + 1);
+        uint16_t bs = 1 + next_rand() % 64;
+        uint32_t size = 1 + next_rand() % (bs * k * 6);
+        uint8_t *image = malloc(size);
+        make_image(image, size);
+        stream_t st;
+        stream_init(&st, image, size, bs, k, r);
+
+        mcast_fec_t fec;
+        open_for(&fec, &st);
+        packet_t *window = malloc(MCAST_FEC_REPAIR_CACHE * (k + r) * sizeof(packet_t));
+        for (uint32_t g0 = 0; g0 < st.n_groups; g0 += MCAST_FEC_REPAIR_CACHE)
+        {
+            size_t n = 0;
+            for (uint32_t g = g0; g < g0 + MCAST_FEC_REPAIR_CACHE && g < st.n_groups; g++)
+            {
+                n += group_packets(&st, g, next_rand() % (r + 1), window + n);
+            }
+            shuffle(window, n);
+            for (size_t p = 0; p < n; p++)
+                mcast_fec_add(&fec, window[p].group, window[p].index, stream_block(&st, window[p].group, window[p].index));
+        }
+
+        assert_complete(&fec, &st);
+        mcast_fec_close(&fec);
+        free(window);
+        stream_free(&st);
+        free(image);
+    }
+}
+
+/* The whole image shuffled at once with 20% loss and duplicates: repair
+ * blocks are evicted, groups lose more than r, and rounds resend only the
+ * incomplete groups, as mcast_send.py does. */
+static void test_random_loss_rounds(void)
+{
+    for (int run = 0; run < RANDOM_RUNS / 10; run++)
+    {
+        uint8_t k = 1 + next_rand() % MCAST_FEC_MAX_K;
+        uint8_t r = next_rand() % (MCAST_FEC_MAX_R + 1);
+        uint16_t bs = 1 + next_rand() % 64;
+        uint32_t size = 1 + next_rand() % (bs * k * 40);
+        uint8_t *image = malloc(size);
+        make_image(image, size);
+        stream_t st;
+        stream_init(&st, image, size, bs, k, r);
+
+        mcast_fec_t fec;
+        open_for(&fec, &st);
+        packet_t *all = malloc(st.n_groups * (k + r) * 2 * sizeof(packet_t));
+        int round = 0;
+        for (; fec.groups_left > 0 && round < MAX_ROUNDS; round++)
+        {
+            size_t n = 0;
+            for (uint32_t g = 0; g < st.n_groups; g++)
+            {
+                if (!mcast_fec_group_done(&fec, g))
+                    n += group_packets(&st, g, 0, all + n);
+            }
+            for (size_t p = 0, sent = n; p < sent; p++)
+            {
+                if (next_rand() % 8 == 0)
+                    all[n++] = all[p]; // Duplicate
+            }
+            shuffle(all, n);
+            for (size_t p = 0; p < n; p++)
+            {
+                if (next_rand() % 5 != 0)
+                    mcast_fec_add(&fec, all[p].group, all[p].index, stream_block(&st, all[p].group, all[p].index));
+            }
+        }
+
+        TEST_ASSERT_TRUE(round < MAX_ROUNDS);
+        assert_complete(&fec, &st);
+        mcast_fec_close(&fec);
+        free(all);
+        stream_free(&st);
+        free(image);
+    }
+}
+
+static void test_ignores_bad_blocks(void)
+{
+    uint8_t image[SMALL_K * SMALL_BS + 3], junk[SMALL_BS];
+    make_image(image, sizeof(image));
+    memset(junk, 0xa5, sizeof(junk));
+    stream_t st;
+    stream_init(&st, image, sizeof(image), SMALL_BS, SMALL_K, 2);
+
+    mcast_fec_t fec;
+    open_for(&fec, &st);
+    mcast_fec_add(&fec, st.n_groups, 0, junk); // No such group
+    mcast_fec_add(&fec, 1, 1, junk);           // Past the end of the short last group
+    mcast_fec_add(&fec, 0, SMALL_K + 2, junk);  // No such repair block
+    TEST_ASSERT_EQUAL_UINT32(st.n_groups, fec.groups_left);
+
+    for (uint32_t g = 0; g < st.n_groups; g++)
+    {
+        for (uint8_t i = 0; i < stream_group_size(&st, g); i++)
+        {
+            mcast_fec_add(&fec, g, i, stream_block(&st, g, i));
+            mcast_fec_add(&fec, g, i, junk); // Duplicate
+        }
+        for (uint8_t j = 0; j < 2; j++)
+            mcast_fec_add(&fec, g, SMALL_K + j, junk); // Late: the group is done
+    }
+
+    assert_complete(&fec, &st);
+    mcast_fec_close(&fec);
+    stream_free(&st);
+}
+
+static void test_open_rejects_bad_code(void)
+{
+    mcast_fec_t fec;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, mcast_fec_open(&fec, 1000, 256, 0, 2));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, mcast_fec_open(&fec, 1000, 256, MCAST_FEC_MAX_K + 1, 2));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, mcast_fec_open(&fec, 1000, 256, 8, MCAST_FEC_MAX_R + 1));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, mcast_fec_open(&fec, 0, 256, 8, 2));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, mcast_fec_open(&fec, 1000, 0, 8, 2));
+}
+
+void app_main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_reference_matches_sender);
+    RUN_TEST(test_golden_rebuild);
+    RUN_TEST(test_every_loss_pattern);
+    RUN_TEST(test_random_loss_one_pass);
+    RUN_TEST(test_random_loss_rounds);
+    RUN_TEST(test_ignores_bad_blocks);
+    RUN_TEST(test_open_rejects_bad_code);
+    exit(UNITY_END());
+}
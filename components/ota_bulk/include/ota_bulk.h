@@ -0,0 +1,33 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Bulk upload: the image over a bare TCP connection instead of the POST /ota
+ * body. It is read with lwIP's netconn API, so the socket layer never copies
+ * it: the payload of each received pbuf goes to the OTA writer by reference
+ * (ota_manager_write_ref()), and the pbuf is freed, and its bytes given back
+ * to the TCP window, only once they are programmed. The receive window bounds
+ * what is held.
+ *
+ * POST /ota/bulk {"size": N} (logged in) arms one transfer and answers
+ * {"port": P, "ticket": "<32 hex digits>"}. The client connects to P, sends
+ * the 16 ticket bytes followed by exactly N image bytes, and reads one line:
+ * "OK\n" (the device reboots into the image) or "ERR <esp_err name>\n".
+ * The image is what POST /ota takes; the same checks apply.
+ */
+
+#define OTA_BULK_TICKET_LEN 16
+
+/**
+ * @brief Opens the bulk port for one transfer, handled by a background task.
+ * @param[in]  image_size  Image bytes that will follow the ticket.
+ * @param[out] port        TCP port to connect to.
+ * @param[out] ticket      Random bytes the client sends first.
+ * @return ESP_ERR_INVALID_STATE if a transfer is already armed or running.
+ * @return ESP_ERR_INVALID_SIZE if image_size is 0.
+ * @return ESP_FAIL if the port cannot be opened.
+ */
+esp_err_t ota_bulk_arm(size_t image_size, uint16_t *port, uint8_t ticket[OTA_BULK_TICKET_LEN]);
@@ -0,0 +1,253 @@
+#include "ota_bulk.h"
+#include "ota_manager.h"
+#include "event_bus.h"
+#include "task_plan.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "lwip/api.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "OTA_BULK";
+
+#define BULK_STACK_SIZE 8192 // ota_manager_finish() (signature check) runs on it, as on httpd
+#define CLOSE_WAIT_MS 2000 // For the client to close first after the status line
+#define RESTART_DELAY_MS 2000
+
+static volatile bool s_armed = false;
+static struct netconn *s_listener = NULL;
+static struct netconn *s_conn = NULL; // The transfer; the writer task reopens its window
+static size_t s_size = 0;
+static uint8_t s_ticket[OTA_BULK_TICKET_LEN];
+
+/* --- HELPER: PBUF SLICES --- */
+
+/* Writer task, after the last slice of a chain: frees it and gives its bytes
+ * back to the receive window. netconn calls go through the tcpip thread, so
+ * this is safe next to the task blocked in netconn_recv. */
+static void release_chain(void *ctx)
+{
+    struct pbuf *p = ctx;
+    u16_t len = p->tot_len;
+    pbuf_free(p);
+    netconn_tcp_recvd(s_conn, len);
+}
+
+/* Hands the chain's bytes after skip to the writer, one slice per segment.
+ * The chain goes with the last slice; on failure the caller still owns it,
+ * but earlier slices may be queued, so the session must be aborted before freeing. */
+static esp_err_t feed_chain(struct pbuf *p, size_t skip)
+{
+    for (struct pbuf *q = p; q; q = q->next)
+    {
+        size_t off = (skip < q->len) ? skip : q->len;
+        skip -= off;
+        bool last = (q->next == NULL);
+        if (off == q->len && !last)
+            continue;
+
+        esp_err_t err = ota_manager_write_ref((const uint8_t *)q->payload + off, q->len - off,
+                                              last ? release_chain : NULL, last ? p : NULL);
+        if (err != ESP_OK)
+            return err;
+    }
+    return ESP_OK;
+}
+
+static void drop_chain(struct netconn *conn, struct pbuf *p)
+{
+    u16_t len = p->tot_len;
+    pbuf_free(p);
+    netconn_tcp_recvd(conn, len);
+}
+
+static bool ticket_ok(const uint8_t *ticket)
+{
+    uint8_t diff = 0;
+    for (size_t i = 0; i < OTA_BULK_TICKET_LEN; i++)
+        diff |= ticket[i] ^ s_ticket[i];
+    return diff == 0;
+}
+
+/* --- TRANSFER --- */
+
+/* Reads the ticket, then streams the image into a session of its own.
+ * ESP_OK once the image is validated and set to boot. */
+static esp_err_t transfer(struct netconn *conn)
+{
+    uint8_t ticket[OTA_BULK_TICKET_LEN];
+    size_t have = 0; // Ticket bytes read
+    size_t left = s_size;
+    bool open = false;
+    esp_err_t err = ESP_OK;
+
+    while (have < sizeof(ticket) || left > 0)
+    {
+        struct pbuf *p = NULL;
+        err_t lerr = netconn_recv_tcp_pbuf_flags(conn, &p, NETCONN_NOAUTORCVD);
+        if (lerr != ERR_OK)
+        {
+            ESP_LOGE(TAG, "Receive failed (%s), %u bytes missing", lwip_strerr(lerr), (unsigned)left);
+            err = (lerr == ERR_TIMEOUT) ? ESP_ERR_TIMEOUT : ESP_FAIL;
+            break;
+        }
+
+        size_t skip = 0;
+        if (have < sizeof(ticket))
+        {
+            skip = pbuf_copy_partial(p, ticket + have, sizeof(ticket) - have, 0);
+            have += skip;
+            if (have == sizeof(ticket))
+            {
+                if (!ticket_ok(ticket))
+                {
+                    ESP_LOGW(TAG, "Wrong ticket, connection dropped.");
+                    err = ESP_ERR_INVALID_ARG;
+                }
+                else
+                {
+                    err = ota_manager_begin_refs(s_size);
+                    open = (err == ESP_OK);
+                }
+            }
+        }
+
+        size_t n = p->tot_len - skip;
+        if (err == ESP_OK && n > left)
+            err = ESP_ERR_INVALID_SIZE; // More than announced
+        if (err == ESP_OK && n > 0)
+        {
+            err = feed_chain(p, skip);
+            if (err == ESP_OK)
+            {
+                left -= n;
+                continue; // The writer frees it
+            }
+        }
+
+        if (err != ESP_OK && open)
+        {
+            ota_manager_abort(); // Drains slices of p that are already queued
+            open = false;
+        }
+        drop_chain(conn, p);
+        if (err != ESP_OK)
+            break;
+    }
+
+    if (err == ESP_OK)
+        return ota_manager_finish();
+    if (open)
+        ota_manager_abort();
+    return err;
+}
+
+static void ota_bulk_task(void *param)
+{
+    struct netconn *conn = NULL;
+    err_t lerr = netconn_accept(s_listener, &conn);
+    netconn_delete(s_listener); // One connection per arming
+    s_listener = NULL;
+    if (lerr != ERR_OK)
+    {
+        ESP_LOGW(TAG, "No client within %d s, port closed.", CONFIG_OTA_BULK_ACCEPT_SEC);
+        s_armed = false;
+        vTaskDelete(NULL);
+        return;
+    }
+
+    netconn_set_recvtimeout(conn, CONFIG_OTA_BULK_IDLE_SEC * 1000);
+    s_conn = conn;
+    esp_err_t err = transfer(conn);
+
+    char line[48];
+    if (err == ESP_OK)
+    {
+        // Same figures as the POST /ota log line, for comparing the two paths
+        ota_stats_t stats;
+        ota_manager_get_stats(&stats);
+        ESP_LOGI(TAG, "OTA: %u bytes in %lld ms (%lld KB/s), flash writes %lld ms",
+                 (unsigned)stats.bytes_written, stats.elapsed_us / 1000,
+                 stats.elapsed_us > 0 ? ((int64_t)stats.bytes_written * 1000000 / stats.elapsed_us) / 1024 : 0,
+                 stats.flash_us / 1000);
+        strlcpy(line, "OK\n", sizeof(line));
+    }
+    else
+    {
+        ESP_LOGE(TAG, "Transfer failed: %s", esp_err_to_name(err));
+        snprintf(line, sizeof(line), "ERR %s\n", esp_err_to_name(err));
+    }
+    netconn_write(conn, line, strlen(line), NETCONN_COPY);
+
+    // Let the client close first, so TIME_WAIT stays on its side and the port can be bound again.
+    netconn_set_recvtimeout(conn, CLOSE_WAIT_MS);
+    struct pbuf *p = NULL;
+    while (netconn_recv_tcp_pbuf_flags(conn, &p, 0) == ERR_OK)
+        pbuf_free(p);
+
+    netconn_close(conn);
+    netconn_delete(conn);
+    s_conn = NULL;
+
+    if (err == ESP_OK)
+    {
+        event_bus_publish_simple(EVENT_RESTART_PENDING);
+        vTaskDelay(pdMS_TO_TICKS(RESTART_DELAY_MS));
+        esp_restart();
+    }
+    s_armed = false;
+    vTaskDelete(NULL);
+}
+
+/* --- PUBLIC API --- */
+
+esp_err_t ota_bulk_arm(size_t image_size, uint16_t *port, uint8_t ticket[OTA_BULK_TICKET_LEN])
+{
+    if (!port || !ticket)
+        return ESP_ERR_INVALID_ARG;
+    if (s_armed)
+        return ESP_ERR_INVALID_STATE;
+    if (image_size == 0)
+        return ESP_ERR_INVALID_SIZE;
+
+#if CONFIG_LWIP_IPV6
+    // Bound to ::, an IPv6 netconn takes IPv4 clients as well
+    struct netconn *listener = netconn_new(NETCONN_TCP_IPV6);
+    const ip_addr_t *any = IP6_ADDR_ANY;
+#else
+    struct netconn *listener = netconn_new(NETCONN_TCP);
+    const ip_addr_t *any = IP_ADDR_ANY;
+#endif
+    if (!listener)
+        return ESP_ERR_NO_MEM;
+    netconn_set_recvtimeout(listener, CONFIG_OTA_BULK_ACCEPT_SEC * 1000);
+    if (netconn_bind(listener, any, CONFIG_OTA_BULK_PORT) != ERR_OK ||
+        netconn_listen_with_backlog(listener, 1) != ERR_OK)
+    {
+        ESP_LOGE(TAG, "Cannot listen on port %d", CONFIG_OTA_BULK_PORT);
+        netconn_delete(listener);
+        return ESP_FAIL;
+    }
+
+    esp_fill_random(s_ticket, sizeof(s_ticket));
+    s_size = image_size;
+    s_listener = listener;
+    s_armed = true;
+    if (xTaskCreatePinnedToCore(ota_bulk_task, "ota_bulk", BULK_STACK_SIZE, NULL,
+                                TASK_PLAN_HTTPD_PRIORITY, NULL, TASK_PLAN_APP_CORE) != pdPASS)
+    {
+        netconn_delete(listener);
+        s_listener = NULL;
+        s_armed = false;
+        return ESP_ERR_NO_MEM;
+    }
+
+    *port = CONFIG_OTA_BULK_PORT;
+    memcpy(ticket, s_ticket, OTA_BULK_TICKET_LEN);
+    ESP_LOGI(TAG, "Armed for %u bytes on port %d", (unsigned)image_size, CONFIG_OTA_BULK_PORT);
+    return ESP_OK;
+}
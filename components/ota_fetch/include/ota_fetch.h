@@ -0,0 +1,13 @@
+#pragma once
+
+#include "esp_err.h"
+
+/**
+ * @brief Downloads an image and installs it through ota_manager (same rules
+ * as POST /ota: signature, encryption, A/B target). Blocks until done.
+ * http:// and https:// (certificate bundle) are accepted; the server must send Content-Length.
+ * @return ESP_OK if the image is installed and will boot next.
+ * @return ESP_ERR_INVALID_RESPONSE on an HTTP error status or a missing length.
+ * @return Otherwise the esp_http_client or ota_manager error.
+ */
+esp_err_t ota_fetch_url(const char *url);
@@ -0,0 +1,90 @@
+#include "ota_fetch.h"
+#include "ota_manager.h"
+#include "power_manager.h"
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "OTA_FETCH";
+
+#define FETCH_TIMEOUT_MS 10000
+#define FETCH_CHUNK 4096 // Largest single read into the writer's ring
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+
+/* Reads the body straight into the writer's ring, like the HTTP server path. */
+static esp_err_t fetch_body(esp_http_client_handle_t client, size_t len)
+{
+    size_t remaining = len;
+    while (remaining > 0)
+    {
+        void *chunk = NULL;
+        size_t space = ota_manager_reserve(&chunk, MIN(remaining, FETCH_CHUNK));
+        if (space == 0)
+            return ESP_FAIL;
+
+        int received = esp_http_client_read(client, chunk, space);
+        if (received <= 0)
+        {
+            ESP_LOGE(TAG, "Connection lost with %u bytes left", (unsigned)remaining);
+            return ESP_ERR_TIMEOUT;
+        }
+
+        esp_err_t err = ota_manager_commit(received);
+        if (err != ESP_OK)
+            return err;
+        remaining -= received;
+    }
+    return ESP_OK;
+}
+
+/* --- PUBLIC API --- */
+
+esp_err_t ota_fetch_url(const char *url)
+{
+    if (!url || !url[0])
+        return ESP_ERR_INVALID_ARG;
+
+    esp_http_client_config_t config = {
+        .url = url,
+        .timeout_ms = FETCH_TIMEOUT_MS,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (!client)
+        return ESP_ERR_NO_MEM;
+
+    // The TLS handshake and the download both run at the boost clock.
+    power_manager_boost();
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = esp_http_client_open(client, 0);
+    int64_t len = (err == ESP_OK) ? esp_http_client_fetch_headers(client) : -1;
+    int status = (err == ESP_OK) ? esp_http_client_get_status_code(client) : 0;
+    if (err == ESP_OK && (status != 200 || len <= 0))
+    {
+        ESP_LOGE(TAG, "Unusable response: HTTP %d, length %lld", status, len);
+        err = ESP_ERR_INVALID_RESPONSE;
+    }
+
+    if (err == ESP_OK)
+        err = ota_manager_begin((size_t)len);
+    if (err == ESP_OK)
+    {
+        ESP_LOGI(TAG, "Fetching %lld bytes from %s", len, url);
+        err = fetch_body(client, (size_t)len);
+        if (err == ESP_OK)
+            err = ota_manager_finish();
+        else
+            ota_manager_abort();
+    }
+
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    power_manager_release();
+
+    if (err == ESP_OK)
+        ESP_LOGI(TAG, "Installed in %lld ms", (esp_timer_get_time() - t0) / 1000);
+    else
+        ESP_LOGE(TAG, "Fetch failed: %s", esp_err_to_name(err));
+    return err;
+}
@@ -0,0 +1,232 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_partition.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define OTA_SIG_TRAILER_MAX (512 + 2 + 4) // RSA-4096 signature, sig_len, "RSIG"
+
+/**
+ * @brief Timing of the current (or last) OTA session.
+ */
+typedef struct
+{
+    size_t bytes_written;
+    int64_t elapsed_us;   // From ota_manager_begin() to now / finish
+    int64_t flash_us;     // Total time spent programming flash
+    int64_t flash_max_us; // Longest single write, i.e. the worst stall
+    bool encrypted;       // Image arrived AES-GCM encrypted
+    int64_t decrypt_us;   // Total time spent decrypting
+    bool signed_image;    // Signature verified against the built-in key
+    int64_t verify_us;    // The final signature check
+    int64_t stall_us;     // CONFIG_OTA_STALL_PROBE: time the probe core could not run flash code
+    int64_t stall_max_us; // Longest such gap
+    uint32_t stalls;      // Gaps counted
+} ota_stats_t;
+
+/**
+ * @brief Opens an OTA session on the target slot (see ota_manager_target_partition()).
+ * Nothing is erased up front: a writer task on the app core erases each sector
+ * as it programs it, so the caller can keep receiving while flash is busy.
+ * The stream may be a plain .bin or an encrypted image ("ROTAENC1" | IV | ciphertext | tag,
+ * see tools/ota_encrypt.py); encrypted images are decrypted by the writer as they arrive.
+ * With CONFIG_OTA_SIGNATURE_VERIFY the plaintext must end with a signature trailer
+ * (tools/ota_sign.py); its SHA-256 is accumulated on the fly.
+ * @param[in] image_size  Exact upload size in bytes (e.g. HTTP Content-Length).
+ * @return ESP_OK on success.
+ * @return ESP_ERR_INVALID_STATE if a session is already open.
+ * @return ESP_ERR_NOT_FOUND if there is no OTA app partition.
+ * @return ESP_ERR_INVALID_SIZE if the image does not fit the partition.
+ */
+esp_err_t ota_manager_begin(size_t image_size);
+
+/**
+ * @brief Zero-copy append, step 1: borrows up to max_len bytes of ring space.
+ * Receive straight into *out_ptr, then call ota_manager_commit().
+ * Blocks while the flash writer catches up.
+ * @return Bytes available at *out_ptr; 0 if the writer failed or stalled.
+ */
+size_t ota_manager_reserve(void **out_ptr, size_t max_len);
+
+/**
+ * @brief Zero-copy append, step 2: hands len received bytes to the writer.
+ * @return ESP_OK, or the error of an earlier failed flash write.
+ */
+esp_err_t ota_manager_commit(size_t len);
+
+/**
+ * @brief Appends a chunk to the open session (copying wrapper around reserve/commit).
+ * @return ESP_OK on success. On failure the session stays open; call ota_manager_abort().
+ */
+esp_err_t ota_manager_write(const void *data, size_t len);
+
+/**
+ * @brief Called by the writer task once a borrowed slice is programmed (or dropped after a failure).
+ */
+typedef void (*ota_release_t)(void *ctx);
+
+/**
+ * @brief Like ota_manager_begin(), for a session fed by ota_manager_write_ref() instead of the ring.
+ */
+esp_err_t ota_manager_begin_refs(size_t image_size);
+
+/**
+ * @brief Appends len bytes at data without copying them: the writer task programs
+ * them in place, then calls release(ctx). data must stay valid until then.
+ * Finish and abort return only after every queued slice is released.
+ * Blocks while the writer catches up.
+ * @param release  May be NULL, e.g. for all but the last slice of one buffer.
+ * @return ESP_OK once queued. On failure the slice is not queued and release is not called.
+ */
+esp_err_t ota_manager_write_ref(const void *data, size_t len, ota_release_t release, void *ctx);
+
+/**
+ * @brief Validates the written image and makes it the boot partition.
+ * The session is closed whatever the result.
+ * @return ESP_OK if the image is valid and will boot next.
+ * @return ESP_ERR_NOT_SUPPORTED if the image is encrypted but no key is provisioned.
+ * @return ESP_ERR_NOT_ALLOWED if the image is plain and CONFIG_OTA_REQUIRE_ENCRYPTION is set.
+ * @return ESP_ERR_INVALID_VERSION if the image has no (or a malformed) signature trailer.
+ * @return ESP_ERR_INVALID_CRC if a tag or signature does not match.
+ */
+esp_err_t ota_manager_finish(void);
+
+/**
+ * @brief An image validated by ota_manager_finish_staged().
+ */
+typedef struct
+{
+    const esp_partition_t *part;
+    size_t image_len;  // Plain image bytes programmed (signature trailer excluded)
+    uint8_t sha256[32]; // Of those bytes
+} ota_staged_t;
+
+/**
+ * @brief Like ota_manager_finish(), but leaves the boot partition alone.
+ * Used to stage images that are not main apps (e.g. a recovery update).
+ */
+esp_err_t ota_manager_finish_staged(ota_staged_t *out);
+
+/**
+ * @brief Closes the session without touching the boot partition.
+ */
+void ota_manager_abort(void);
+
+/**
+ * @brief Copies the statistics of the current or last session.
+ */
+void ota_manager_get_stats(ota_stats_t *out);
+
+/**
+ * @brief Starts the background integrity scan: a low-priority task that checks
+ * factory and the OTA slots (structure, the image's own SHA-256) and caches
+ * their digest in NVS. Partitions already scanned are skipped, so later boots
+ * cost only an NVS read each. Uploads through this module cache theirs directly.
+ * The scan pauses while an upload is running.
+ */
+esp_err_t ota_manager_scan_start(void);
+
+typedef enum
+{
+    OTA_IMAGE_UNCHECKED = 0, // Not scanned yet
+    OTA_IMAGE_OK,            // Structure and appended SHA-256 verified
+    OTA_IMAGE_CORRUPT,       // The descriptor is readable, the image is not intact
+    OTA_IMAGE_EMPTY,         // No app in the partition
+} ota_image_health_t;
+
+/**
+ * @brief Cached scan result of an app partition.
+ */
+typedef struct
+{
+    uint8_t health; // ota_image_health_t
+    uint32_t image_len;
+    uint8_t sha256[32]; // Of the whole .bin, valid when health is OTA_IMAGE_OK
+    char version[32];   // From the app descriptor, empty if there is none
+    bool confidential;  // Uploaded encrypted: the slot holds what must not go out in the clear
+} ota_image_info_t;
+
+/**
+ * @brief Scan result of an app partition (factory or OTA slot). Never blocks on the scan.
+ */
+esp_err_t ota_manager_get_image_info(const esp_partition_t *part, ota_image_info_t *out);
+
+/**
+ * @brief Boots an already installed image instead of re-uploading it.
+ * @param[in] sha256  SHA-256 of the plain .bin (before signing / encryption).
+ * @return ESP_OK if a slot holds that image and is now the boot partition.
+ * @return ESP_ERR_NOT_FOUND if no slot matches, or its digest is not known yet, or (with
+ *         CONFIG_OTA_SIGNATURE_VERIFY) its signature was not checked when it was uploaded.
+ * @return ESP_ERR_INVALID_STATE while an upload session is open.
+ */
+esp_err_t ota_manager_activate_installed(const uint8_t sha256[32]);
+
+/**
+ * @brief Copies the signature trailer (signature | sig_len | "RSIG") that came
+ * with the image now in part, so the image can be passed on as it was uploaded.
+ * @param[out]   buf  At least OTA_SIG_TRAILER_MAX bytes.
+ * @param[inout] len  In: size of buf. Out: trailer bytes; 0 without CONFIG_OTA_SIGNATURE_VERIFY.
+ * @return ESP_ERR_NOT_FOUND if the slot was not written through ota_manager,
+ *         has been rewritten since, or did not pass its integrity check.
+ */
+esp_err_t ota_manager_get_signature(const esp_partition_t *part, uint8_t *buf, size_t *len);
+
+/**
+ * @brief Slot the main app currently runs from, or NULL if unknown.
+ * Tracked in NVS, because falling back to factory erases otadata.
+ */
+const esp_partition_t *ota_manager_active_partition(void);
+
+/**
+ * @brief Slot the next upload will be written to.
+ * With two OTA slots (partitions_ab.csv) this is always the inactive one.
+ */
+const esp_partition_t *ota_manager_target_partition(void);
+
+typedef enum
+{
+    OTA_HEALTH_NONE = 0,  // Nothing installed through the recovery app yet
+    OTA_HEALTH_PENDING,   // Installed, first boot not settled
+    OTA_HEALTH_HEALTHY,   // The image confirmed itself
+    OTA_HEALTH_FAILED,    // Returned to recovery instead, see cause
+} ota_health_result_t;
+
+typedef enum
+{
+    OTA_HEALTH_CAUSE_NONE = 0,
+    OTA_HEALTH_CAUSE_CRASHED,   // Reset before confirming (ESP_OTA_IMG_ABORTED)
+    OTA_HEALTH_CAUSE_REJECTED,  // Marked itself invalid or missed the window (ESP_OTA_IMG_INVALID)
+    OTA_HEALTH_CAUSE_FELL_BACK, // Switched to factory without confirming
+} ota_health_cause_t;
+
+/**
+ * @brief Outcome of the last install's first boot (see recovery_handshake.h).
+ */
+typedef struct
+{
+    uint8_t result; // ota_health_result_t
+    uint8_t cause;  // ota_health_cause_t
+    uint8_t stage;  // Last RECOVERY_STAGE_* the image reported
+    char slot[17];
+    char version[32];
+} ota_health_t;
+
+/**
+ * @brief Reverts to the other slot if the active one failed its health check
+ * (rolled back by the bootloader, or returned to factory without confirming).
+ * Settles the pending health record first. Call early at boot.
+ * @param[out] reverted  true if the boot partition changed and the caller should reboot.
+ */
+esp_err_t ota_manager_check_rollback(bool *reverted);
+
+/**
+ * @brief Health of the last installed image; result is OTA_HEALTH_PENDING until it has booted.
+ */
+esp_err_t ota_manager_get_health(ota_health_t *out);
+
+/**
+ * @brief Human readable ota_health_cause_t.
+ */
+const char *ota_manager_health_cause_name(uint8_t cause);
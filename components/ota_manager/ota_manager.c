@@ -0,0 +1,1447 @@
+#include "ota_manager.h"
+#include "ring_buffer.h"
+#include "task_plan.h"
+#include "event_bus.h"
+#include "storage_manager.h"
+#include "recovery_handshake.h"
+#include "power_manager.h"
+#include "esp_ota_ops.h"
+#include "esp_image_format.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_heap_caps.h"
+#include "mbedtls/gcm.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/platform_util.h"
+#include <string.h>
+
+static const char *TAG = "OTA_MANAGER";
+
+#define PIPE_DATA_BIT BIT0  // Producer committed bytes
+#define PIPE_SPACE_BIT BIT1 // Writer released bytes
+#define PIPE_STOP_BIT BIT2  // Producer is done, drain and exit
+#define PIPE_DONE_BIT BIT3  // Writer exited
+
+#define WRITER_STACK_SIZE 4096
+#define SPACE_WAIT_MS 10000 // Longer than any sector erase
+#define REF_SLOTS 128       // Borrowed slices in flight; a full TCP window is ~64 segments
+#define DRAIN_WAIT_MS 30000
+#define PROGRESS_STEP (64 * 1024) // Bytes between EVENT_OTA_PROGRESS events
+
+// Encrypted image: "ROTAENC1" | IV (12) | AES-256-GCM ciphertext | tag (16).
+// The magic is authenticated as AAD. A plain image starts with 0xE9 instead.
+#define ENC_MAGIC "ROTAENC1"
+#define ENC_MAGIC_LEN 8
+#define ENC_IV_LEN 12
+#define ENC_HEADER_LEN (ENC_MAGIC_LEN + ENC_IV_LEN)
+#define ENC_TAG_LEN 16
+#define ENC_KEY_LEN 32
+#define DECRYPT_CHUNK 4096 // Plaintext scratch, internal RAM
+
+// Signed image: image | signature (DER) | sig_len (u16 LE) | "RSIG".
+// The trailer is read backwards, so it fits both ECDSA and RSA signatures.
+#define SIG_MAGIC "RSIG"
+#define SIG_MAGIC_LEN 4
+#define SIG_MAX_LEN 512 // RSA-4096
+#define SIG_TRAILER_MAX (SIG_MAX_LEN + 2 + SIG_MAGIC_LEN)
+_Static_assert(SIG_TRAILER_MAX == OTA_SIG_TRAILER_MAX, "Public trailer size");
+
+#define DIGEST_LEN 32
+#define SCAN_STACK_SIZE 4096
+#define SCAN_MAP_STEP (256 * 1024)  // Mapped at a time, keeps MMU pages free
+#define SCAN_HASH_STEP (64 * 1024)  // Bytes hashed between yields
+#define SCAN_PAUSE_MS 200           // Poll interval while an upload is running
+
+#define HEALTH_MAGIC 0x31534852 // "RHS1"
+#define PROBE_PERIOD_US 1000
+#define PROBE_SLACK_US 500 // Lateness below this is scheduling noise
+
+#if CONFIG_OTA_SIGNATURE_VERIFY
+extern const char ota_pubkey_pem_start[] asm("_binary_ota_signing_pubkey_pem_start");
+extern const char ota_pubkey_pem_end[] asm("_binary_ota_signing_pubkey_pem_end");
+#endif
+
+#if CONFIG_OTA_RING_IN_PSRAM
+#define OTA_RING_MEM RING_MEM_PSRAM
+#else
+#define OTA_RING_MEM RING_MEM_INTERNAL
+#endif
+
+// State (one session at a time)
+static esp_ota_handle_t s_handle = 0;
+static const esp_partition_t *volatile s_part = NULL; // Read by the scan task
+static const esp_partition_t *s_last_part = NULL; // Slot of the last completed session
+static int64_t s_start_us = 0;
+static size_t s_total = 0;
+static ota_stats_t s_stats = {0};
+
+// Pipeline: producer -> s_ring (or s_refs) -> writer task -> flash
+typedef struct
+{
+    const uint8_t *data;
+    size_t len;
+    ota_release_t release;
+    void *ctx;
+} ref_slice_t;
+
+static ring_spsc_t s_ring;
+static ring_mpsc_t s_refs; // Borrowed slices, when the session was opened by ota_manager_begin_refs()
+static bool s_use_refs = false;
+static EventGroupHandle_t s_pipe_events = NULL;
+static volatile esp_err_t s_write_err = ESP_OK;
+static bool s_stuck = false; // Writer missed DRAIN_WAIT_MS; the session is held until it exits
+
+// Stream decoder, owned by the writer task while the pipeline runs
+typedef enum
+{
+    STREAM_DETECT,
+    STREAM_PLAIN,
+    STREAM_ENCRYPTED,
+} stream_mode_t;
+
+/* Keeps the newest cap bytes of a stream back from the next stage,
+ * for trailers whose position is only known once the stream ends. */
+typedef struct
+{
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+} holdback_t;
+
+typedef esp_err_t (*stream_emit_t)(const uint8_t *data, size_t len);
+
+static stream_mode_t s_mode = STREAM_DETECT;
+static uint8_t s_header[ENC_HEADER_LEN];
+static size_t s_header_len = 0;
+static uint8_t s_tag_buf[ENC_TAG_LEN];
+static holdback_t s_tag = {s_tag_buf, ENC_TAG_LEN, 0}; // The GCM tag once the stream ends
+static uint8_t s_sig_buf[SIG_TRAILER_MAX];
+static holdback_t s_sig = {s_sig_buf, SIG_TRAILER_MAX, 0}; // Ends with the signature trailer
+static size_t s_trailer_len = 0;                           // Verified trailer, moved to s_sig.buf[0]
+static mbedtls_sha256_context s_sha;
+static uint8_t s_digest[DIGEST_LEN]; // SHA-256 of the image as programmed
+static uint8_t s_key[ENC_KEY_LEN];
+static bool s_have_key = false;
+static mbedtls_gcm_context s_gcm;
+static uint8_t *s_plain = NULL;
+
+/* --- EVENTS --- */
+
+static void publish_ota_event(event_type_t type, esp_err_t err)
+{
+    event_t event = {.type = type};
+    if (type == EVENT_OTA_FAILED)
+    {
+        event.data.result.err = err;
+    }
+    else
+    {
+        event.data.ota.done = s_stats.bytes_written;
+        event.data.ota.total = s_total;
+    }
+    event_bus_publish(&event);
+}
+
+/* --- STREAM DECODER --- */
+
+static esp_err_t flash_write(const void *data, size_t len)
+{
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = esp_ota_write(s_handle, data, len);
+    int64_t dt = esp_timer_get_time() - t0;
+
+    s_stats.flash_us += dt;
+    if (dt > s_stats.flash_max_us)
+        s_stats.flash_max_us = dt;
+    if (err != ESP_OK)
+        return err;
+
+    size_t before = s_stats.bytes_written;
+    s_stats.bytes_written += len;
+    if (before / PROGRESS_STEP != s_stats.bytes_written / PROGRESS_STEP)
+        publish_ota_event(EVENT_OTA_PROGRESS, ESP_OK);
+    return ESP_OK;
+}
+
+static esp_err_t holdback_feed(holdback_t *hb, const uint8_t *data, size_t len, stream_emit_t emit)
+{
+    if (hb->len + len <= hb->cap)
+    {
+        memcpy(hb->buf + hb->len, data, len);
+        hb->len += len;
+        return ESP_OK;
+    }
+
+    size_t out = hb->len + len - hb->cap;
+    size_t from_buf = (out < hb->len) ? out : hb->len;
+    size_t from_data = out - from_buf;
+
+    esp_err_t err = emit(hb->buf, from_buf);
+    if (err != ESP_OK)
+        return err;
+    memmove(hb->buf, hb->buf + from_buf, hb->len - from_buf);
+    hb->len -= from_buf;
+
+    err = emit(data, from_data);
+    if (err != ESP_OK)
+        return err;
+    memcpy(hb->buf + hb->len, data + from_data, len - from_data);
+    hb->len += len - from_data;
+    return ESP_OK;
+}
+
+static esp_err_t hash_write(const uint8_t *data, size_t len)
+{
+    if (len == 0)
+        return ESP_OK;
+    if (mbedtls_sha256_update(&s_sha, data, len) != 0)
+        return ESP_FAIL;
+    return flash_write(data, len);
+}
+
+/* Plaintext sink: with verification on, the signature trailer is held back
+ * so it is neither hashed nor programmed. */
+static esp_err_t image_write(const uint8_t *data, size_t len)
+{
+#if CONFIG_OTA_SIGNATURE_VERIFY
+    return holdback_feed(&s_sig, data, len, hash_write);
+#else
+    return hash_write(data, len);
+#endif
+}
+
+static esp_err_t decrypt_write(const uint8_t *src, size_t len)
+{
+    while (len > 0)
+    {
+        size_t n = (len < DECRYPT_CHUNK) ? len : DECRYPT_CHUNK;
+        size_t out_len = 0;
+
+        int64_t t0 = esp_timer_get_time();
+        int ret = mbedtls_gcm_update(&s_gcm, src, n, s_plain, DECRYPT_CHUNK, &out_len);
+        s_stats.decrypt_us += esp_timer_get_time() - t0;
+        if (ret != 0)
+        {
+            ESP_LOGE(TAG, "Decrypt failed: -0x%04x", (unsigned)-ret);
+            return ESP_FAIL;
+        }
+
+        esp_err_t err = image_write(s_plain, out_len);
+        if (err != ESP_OK)
+            return err;
+
+        src += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t decrypt_start(void)
+{
+    if (!s_have_key)
+    {
+        ESP_LOGE(TAG, "Encrypted image, but no key is provisioned.");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    s_plain = heap_caps_malloc(DECRYPT_CHUNK, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!s_plain)
+        return ESP_ERR_NO_MEM;
+
+    mbedtls_gcm_init(&s_gcm);
+    if (mbedtls_gcm_setkey(&s_gcm, MBEDTLS_CIPHER_ID_AES, s_key, ENC_KEY_LEN * 8) != 0 ||
+        mbedtls_gcm_starts(&s_gcm, MBEDTLS_GCM_DECRYPT, s_header + ENC_MAGIC_LEN, ENC_IV_LEN) != 0 ||
+        mbedtls_gcm_update_ad(&s_gcm, s_header, ENC_MAGIC_LEN) != 0)
+    {
+        return ESP_FAIL;
+    }
+
+    s_stats.encrypted = true;
+    return ESP_OK;
+}
+
+static esp_err_t stream_feed(const uint8_t *data, size_t len)
+{
+    if (s_mode == STREAM_DETECT)
+    {
+        size_t n = ENC_HEADER_LEN - s_header_len;
+        if (n > len)
+            n = len;
+        memcpy(s_header + s_header_len, data, n);
+        s_header_len += n;
+        data += n;
+        len -= n;
+
+        size_t cmp = (s_header_len < ENC_MAGIC_LEN) ? s_header_len : ENC_MAGIC_LEN;
+        if (memcmp(s_header, ENC_MAGIC, cmp) != 0)
+        {
+#if CONFIG_OTA_REQUIRE_ENCRYPTION
+            ESP_LOGE(TAG, "Plain image rejected, encryption is required.");
+            return ESP_ERR_NOT_ALLOWED;
+#else
+            s_mode = STREAM_PLAIN;
+            esp_err_t err = image_write(s_header, s_header_len);
+            if (err != ESP_OK)
+                return err;
+#endif
+        }
+        else if (s_header_len == ENC_HEADER_LEN)
+        {
+            esp_err_t err = decrypt_start();
+            if (err != ESP_OK)
+                return err;
+            s_mode = STREAM_ENCRYPTED;
+        }
+    }
+
+    if (len == 0)
+        return ESP_OK;
+    if (s_mode == STREAM_PLAIN)
+        return image_write(data, len);
+    // Everything but the last ENC_TAG_LEN bytes is ciphertext
+    return holdback_feed(&s_tag, data, len, decrypt_write);
+}
+
+/* Checks the GCM tag once the whole stream is in. Until then the written
+ * plaintext is unauthenticated, which is why the boot partition is only
+ * switched after this passes. */
+static esp_err_t stream_finish(void)
+{
+    if (s_mode == STREAM_PLAIN)
+        return ESP_OK;
+    if (s_mode == STREAM_DETECT || s_tag.len != ENC_TAG_LEN)
+        return ESP_ERR_INVALID_SIZE;
+
+    uint8_t tag[ENC_TAG_LEN];
+    size_t out_len = 0;
+    if (mbedtls_gcm_finish(&s_gcm, s_plain, DECRYPT_CHUNK, &out_len, tag, sizeof(tag)) != 0)
+        return ESP_FAIL;
+
+    uint8_t diff = 0;
+    for (size_t i = 0; i < ENC_TAG_LEN; i++)
+        diff |= tag[i] ^ s_tag.buf[i];
+    if (diff != 0)
+    {
+        ESP_LOGE(TAG, "Authentication tag mismatch, image rejected.");
+        return ESP_ERR_INVALID_CRC;
+    }
+    return ESP_OK;
+}
+
+/* Completes the image digest. With verification on, first splits the held-back
+ * tail into the last image bytes and the trailer, then checks one signature
+ * over the digest accumulated while streaming. */
+static esp_err_t image_finish(void)
+{
+#if CONFIG_OTA_SIGNATURE_VERIFY
+    const uint8_t *tail = s_sig.buf;
+    size_t n = s_sig.len;
+
+    if (n < SIG_MAGIC_LEN + 2 || memcmp(tail + n - SIG_MAGIC_LEN, SIG_MAGIC, SIG_MAGIC_LEN) != 0)
+    {
+        ESP_LOGE(TAG, "Image is not signed.");
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    size_t sig_len = tail[n - SIG_MAGIC_LEN - 2] | (tail[n - SIG_MAGIC_LEN - 1] << 8);
+    if (sig_len == 0 || sig_len > SIG_MAX_LEN || sig_len + 2 + SIG_MAGIC_LEN > n)
+    {
+        ESP_LOGE(TAG, "Malformed signature trailer.");
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    size_t image_tail = n - sig_len - 2 - SIG_MAGIC_LEN;
+    esp_err_t err = hash_write(tail, image_tail);
+    if (err != ESP_OK)
+        return err;
+#endif
+
+    if (mbedtls_sha256_finish(&s_sha, s_digest) != 0)
+        return ESP_FAIL;
+
+#if CONFIG_OTA_SIGNATURE_VERIFY
+    int64_t t0 = esp_timer_get_time();
+    mbedtls_pk_context pk;
+    mbedtls_pk_init(&pk);
+
+    int ret = mbedtls_pk_parse_public_key(&pk, (const unsigned char *)ota_pubkey_pem_start,
+                                          ota_pubkey_pem_end - ota_pubkey_pem_start);
+    if (ret == 0)
+        ret = mbedtls_pk_verify(&pk, MBEDTLS_MD_SHA256, s_digest, sizeof(s_digest), tail + image_tail, sig_len);
+
+    mbedtls_pk_free(&pk);
+    s_stats.verify_us = esp_timer_get_time() - t0;
+
+    if (ret != 0)
+    {
+        ESP_LOGE(TAG, "Signature check failed: -0x%04x", (unsigned)-ret);
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    s_stats.signed_image = true;
+    // Kept at the start of the buffer, which stream_reset() leaves intact.
+    s_trailer_len = n - image_tail;
+    memmove(s_sig.buf, tail + image_tail, s_trailer_len);
+#endif
+    return ESP_OK;
+}
+
+static void stream_reset(void)
+{
+    if (s_plain)
+    {
+        mbedtls_gcm_free(&s_gcm);
+        heap_caps_free(s_plain);
+        s_plain = NULL;
+    }
+    mbedtls_platform_zeroize(s_key, sizeof(s_key));
+    s_have_key = false;
+    s_mode = STREAM_DETECT;
+    s_header_len = 0;
+    s_tag.len = 0;
+    s_sig.len = 0;
+    mbedtls_sha256_free(&s_sha);
+    mbedtls_sha256_init(&s_sha);
+    mbedtls_sha256_starts(&s_sha, 0);
+}
+
+static int hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/* Per-device key from NVS first, then the fleet key from Kconfig. */
+static void load_key(void)
+{
+    if (storage_get_ota_key(s_key, sizeof(s_key)) == ESP_OK)
+    {
+        s_have_key = true;
+        return;
+    }
+
+    const char *hex = CONFIG_OTA_FLEET_KEY;
+    if (strlen(hex) != ENC_KEY_LEN * 2)
+        return;
+
+    for (size_t i = 0; i < ENC_KEY_LEN; i++)
+    {
+        int hi = hex_nibble(hex[2 * i]);
+        int lo = hex_nibble(hex[2 * i + 1]);
+        if (hi < 0 || lo < 0)
+        {
+            ESP_LOGW(TAG, "CONFIG_OTA_FLEET_KEY is not valid hex, ignored.");
+            mbedtls_platform_zeroize(s_key, sizeof(s_key));
+            return;
+        }
+        s_key[i] = (uint8_t)((hi << 4) | lo);
+    }
+    s_have_key = true;
+}
+
+/* --- SLOTS --- */
+
+static const esp_partition_t *slot_get(size_t i)
+{
+    return esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_MIN + i, NULL);
+}
+
+static bool slot_has_app(const esp_partition_t *part)
+{
+    esp_app_desc_t desc;
+    return part && esp_ota_get_partition_description(part, &desc) == ESP_OK;
+}
+
+static bool health_failed(const esp_partition_t *part);
+
+/* False for images the rollback state machine has given up on. */
+static bool slot_usable(const esp_partition_t *part)
+{
+    esp_ota_img_states_t state;
+    if (!slot_has_app(part) || health_failed(part))
+        return false;
+    if (esp_ota_get_state_partition(part, &state) != ESP_OK)
+        return true; // Not in otadata (e.g. after a fallback to factory erased it)
+    return state != ESP_OTA_IMG_ABORTED && state != ESP_OTA_IMG_INVALID;
+}
+
+/* The slot the main app runs from. Kept in NVS because selecting factory
+ * erases otadata; without a record, the only slot that holds an app. */
+static const esp_partition_t *slot_active(void)
+{
+    char label[sizeof(((esp_partition_t *)0)->label)];
+    if (storage_get_active_slot(label, sizeof(label)) == ESP_OK)
+    {
+        for (size_t i = 0; i < esp_ota_get_app_partition_count(); i++)
+        {
+            const esp_partition_t *part = slot_get(i);
+            if (part && strcmp(part->label, label) == 0)
+                return part;
+        }
+    }
+
+    const esp_partition_t *found = NULL;
+    for (size_t i = 0; i < esp_ota_get_app_partition_count(); i++)
+    {
+        const esp_partition_t *part = slot_get(i);
+        if (!slot_has_app(part))
+            continue;
+        if (found)
+            return NULL; // Ambiguous
+        found = part;
+    }
+    return found;
+}
+
+/* Uploads always go to a slot other than the active one, so the running
+ * main app survives a failed or interrupted update. */
+static const esp_partition_t *slot_target(void)
+{
+    size_t count = esp_ota_get_app_partition_count();
+    if (count <= 1)
+        return slot_get(0);
+
+    const esp_partition_t *active = slot_active();
+    for (size_t i = 0; i < count; i++)
+    {
+        const esp_partition_t *part = slot_get(i);
+        if (part && part != active && (active || !slot_has_app(part)))
+            return part;
+    }
+    return slot_get(0);
+}
+
+static void health_arm(const esp_partition_t *part);
+
+static esp_err_t slot_activate(const esp_partition_t *part)
+{
+    // Selecting factory erases otadata, so the new entry is the only one: if
+    // the image fails its health check the bootloader returns here, where the
+    // failure is recorded and the previous slot restored.
+    const esp_partition_t *factory = esp_partition_find_first(ESP_PARTITION_TYPE_APP,
+                                                              ESP_PARTITION_SUBTYPE_APP_FACTORY, NULL);
+    if (factory && esp_ota_set_boot_partition(factory) != ESP_OK)
+        ESP_LOGW(TAG, "Could not reset otadata");
+
+    esp_err_t err = esp_ota_set_boot_partition(part);
+    if (err != ESP_OK)
+        return err;
+
+    if (storage_set_active_slot(part->label) != ESP_OK)
+        ESP_LOGW(TAG, "Could not record '%s' as the active slot", part->label);
+    health_arm(part);
+    return ESP_OK;
+}
+
+/* --- BOOT HEALTH --- */
+
+// Written when a slot is activated; settled by the next boot of this app.
+typedef struct
+{
+    uint32_t magic;
+    char slot[17];
+    char version[32];
+} health_pending_t;
+
+static void health_arm(const esp_partition_t *part)
+{
+    health_pending_t rec = {.magic = HEALTH_MAGIC};
+    esp_app_desc_t desc;
+    strlcpy(rec.slot, part->label, sizeof(rec.slot));
+    if (esp_ota_get_partition_description(part, &desc) == ESP_OK)
+        strlcpy(rec.version, desc.version, sizeof(rec.version));
+
+    if (storage_set_health_pending(&rec, sizeof(rec)) != ESP_OK)
+        ESP_LOGW(TAG, "Could not arm the health check of '%s'", part->label);
+}
+
+/* True if the image now in part is the one the last report marked as failed. */
+static bool health_failed(const esp_partition_t *part)
+{
+    ota_health_t report;
+    esp_app_desc_t desc;
+    if (storage_get_health_report(&report, sizeof(report)) != ESP_OK || report.result != OTA_HEALTH_FAILED)
+        return false;
+    if (strncmp(report.slot, part->label, sizeof(report.slot)) != 0)
+        return false;
+    return esp_ota_get_partition_description(part, &desc) == ESP_OK &&
+           strncmp(report.version, desc.version, sizeof(report.version)) == 0;
+}
+
+/* Turns the pending record into a report once the image has had its chance.
+ * Returns the slot if it failed, NULL otherwise. */
+static const esp_partition_t *health_settle(void)
+{
+    health_pending_t rec;
+    if (storage_get_health_pending(&rec, sizeof(rec)) != ESP_OK || rec.magic != HEALTH_MAGIC)
+        return NULL;
+    rec.slot[sizeof(rec.slot) - 1] = '\0';
+    rec.version[sizeof(rec.version) - 1] = '\0';
+
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, rec.slot);
+    ota_health_t report = {.result = OTA_HEALTH_FAILED};
+    strlcpy(report.slot, rec.slot, sizeof(report.slot));
+    strlcpy(report.version, rec.version, sizeof(report.version));
+    storage_get_boot_stage(&report.stage);
+
+    esp_ota_img_states_t state;
+    if (part && esp_ota_get_state_partition(part, &state) == ESP_OK)
+    {
+        if (state == ESP_OTA_IMG_NEW || state == ESP_OTA_IMG_PENDING_VERIFY)
+            return NULL; // Recovery entered before the image finished its first boot
+        if (state == ESP_OTA_IMG_ABORTED)
+            report.cause = OTA_HEALTH_CAUSE_CRASHED;
+        else if (state == ESP_OTA_IMG_INVALID)
+            report.cause = OTA_HEALTH_CAUSE_REJECTED;
+        else
+            report.result = OTA_HEALTH_HEALTHY; // VALID, or UNDEFINED without rollback support
+    }
+    else if (report.stage == RECOVERY_STAGE_HEALTHY)
+    {
+        report.result = OTA_HEALTH_HEALTHY; // Confirmed, then otadata was erased
+    }
+    else
+    {
+        report.cause = OTA_HEALTH_CAUSE_FELL_BACK; // E.g. the three-strikes rule
+    }
+
+    if (storage_set_health_report(&report, sizeof(report)) != ESP_OK)
+        ESP_LOGW(TAG, "Could not save the health report");
+    storage_clear_health_pending();
+
+    if (report.result == OTA_HEALTH_HEALTHY)
+    {
+        ESP_LOGI(TAG, "'%s' (%s) confirmed healthy", report.slot, report.version);
+        return NULL;
+    }
+    ESP_LOGE(TAG, "'%s' (%s) failed its health check: %s, last stage 0x%02x", report.slot, report.version,
+             ota_manager_health_cause_name(report.cause), report.stage);
+    return part;
+}
+
+/* --- INSTALLED IMAGE DIGESTS --- */
+
+// Cached in NVS per app partition. app_sha identifies what the partition held
+// when it was scanned, so a stale record is detected by reading the app descriptor only.
+typedef struct
+{
+    uint8_t app_sha[DIGEST_LEN]; // esp_app_desc_t.app_elf_sha256
+    uint32_t image_len;
+    uint8_t digest[DIGEST_LEN]; // SHA-256 of the image bytes, i.e. of the .bin
+    uint8_t health;             // ota_image_health_t
+    uint8_t confidential;       // Arrived AES-GCM encrypted: never served in the clear
+    uint8_t reserved[2];
+} digest_record_t;
+
+static bool slot_fingerprint(const esp_partition_t *part, uint8_t app_sha[DIGEST_LEN])
+{
+    esp_app_desc_t desc;
+    if (esp_ota_get_partition_description(part, &desc) != ESP_OK)
+        return false;
+    memcpy(app_sha, desc.app_elf_sha256, DIGEST_LEN);
+    return true;
+}
+
+/* Returns the cached record only if it still describes the partition contents. */
+static bool digest_lookup(const esp_partition_t *part, digest_record_t *rec)
+{
+    uint8_t app_sha[DIGEST_LEN];
+    if (!slot_fingerprint(part, app_sha))
+        return false;
+    if (storage_get_image_digest(part->label, rec, sizeof(*rec)) != ESP_OK)
+        return false;
+    return memcmp(rec->app_sha, app_sha, DIGEST_LEN) == 0;
+}
+
+static void digest_save(const esp_partition_t *part, const uint8_t digest[DIGEST_LEN], size_t image_len,
+                        ota_image_health_t health, bool confidential)
+{
+    digest_record_t rec = {.image_len = image_len, .health = health, .confidential = confidential};
+    if (!slot_fingerprint(part, rec.app_sha))
+        return;
+    memcpy(rec.digest, digest, DIGEST_LEN);
+    if (storage_set_image_digest(part->label, &rec, sizeof(rec)) != ESP_OK)
+        ESP_LOGW(TAG, "Could not cache digest of '%s'", part->label);
+}
+
+// Signature trailer of an uploaded image, bound to its digest so a record
+// left over from an older image is never handed out.
+typedef struct
+{
+    uint8_t digest[DIGEST_LEN];
+    uint8_t trailer[SIG_TRAILER_MAX]; // Only the first trailer_len bytes are stored
+} signature_record_t;
+
+static void signature_save(const esp_partition_t *part)
+{
+    if (s_trailer_len == 0)
+        return;
+
+    signature_record_t rec;
+    memcpy(rec.digest, s_digest, DIGEST_LEN);
+    memcpy(rec.trailer, s_sig.buf, s_trailer_len);
+    if (storage_set_image_signature(part->label, &rec, DIGEST_LEN + s_trailer_len) != ESP_OK)
+        ESP_LOGW(TAG, "Could not keep the signature of '%s'", part->label);
+}
+
+static bool is_app_image(const esp_partition_t *part)
+{
+    return part->subtype == ESP_PARTITION_SUBTYPE_APP_FACTORY ||
+           (part->subtype >= ESP_PARTITION_SUBTYPE_APP_OTA_MIN && part->subtype < ESP_PARTITION_SUBTYPE_APP_OTA_MAX);
+}
+
+/* --- INTEGRITY SCAN --- */
+
+/* Hashes the image through a flash mapping (the SHA engine reads it straight
+ * from cache) a window at a time, and checks the SHA-256 that the build
+ * appends. Yields between steps and pauses while an upload is running; the
+ * clock boost is held only while hashing, not while paused. */
+static esp_err_t slot_hash(const esp_partition_t *part, uint8_t digest[DIGEST_LEN], size_t *image_len)
+{
+    const esp_partition_pos_t pos = {.offset = part->address, .size = part->size};
+    esp_image_metadata_t meta;
+    if (esp_image_get_metadata(&pos, &meta) != ESP_OK || meta.image_len > part->size)
+        return ESP_ERR_INVALID_VERSION;
+
+    size_t hashed_len = meta.image_len - (meta.image.hash_appended ? DIGEST_LEN : 0);
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+
+    esp_err_t err = ESP_OK;
+    uint8_t computed[DIGEST_LEN], stored[DIGEST_LEN];
+    power_manager_boost();
+    for (size_t base = 0; base < meta.image_len && err == ESP_OK; base += SCAN_MAP_STEP)
+    {
+        if (s_part != NULL)
+        {
+            power_manager_release();
+            while (s_part != NULL)
+                vTaskDelay(pdMS_TO_TICKS(SCAN_PAUSE_MS));
+            power_manager_boost();
+        }
+
+        size_t window = meta.image_len - base;
+        if (window > SCAN_MAP_STEP)
+            window = SCAN_MAP_STEP;
+
+        const uint8_t *map = NULL;
+        esp_partition_mmap_handle_t handle;
+        err = esp_partition_mmap(part, base, window, ESP_PARTITION_MMAP_DATA, (const void **)&map, &handle);
+        for (size_t off = 0; off < window && err == ESP_OK; off += SCAN_HASH_STEP)
+        {
+            size_t n = window - off;
+            if (n > SCAN_HASH_STEP)
+                n = SCAN_HASH_STEP;
+
+            // The appended hash covers everything before it: snapshot the context there.
+            size_t at = base + off;
+            size_t head = (meta.image.hash_appended && at <= hashed_len && hashed_len < at + n) ? hashed_len - at : n;
+            if (mbedtls_sha256_update(&sha, map + off, head) != 0)
+                err = ESP_FAIL;
+            if (err == ESP_OK && head < n)
+            {
+                mbedtls_sha256_context check;
+                mbedtls_sha256_init(&check);
+                mbedtls_sha256_clone(&check, &sha);
+                if (mbedtls_sha256_finish(&check, computed) != 0 ||
+                    mbedtls_sha256_update(&sha, map + off + head, n - head) != 0)
+                    err = ESP_FAIL;
+                mbedtls_sha256_free(&check);
+            }
+            vTaskDelay(1);
+        }
+        if (map)
+            esp_partition_munmap(handle);
+    }
+    if (err == ESP_OK && mbedtls_sha256_finish(&sha, digest) != 0)
+        err = ESP_FAIL;
+    power_manager_release();
+    if (err == ESP_OK && meta.image.hash_appended)
+    {
+        err = esp_partition_read(part, hashed_len, stored, DIGEST_LEN);
+        if (err == ESP_OK && memcmp(computed, stored, DIGEST_LEN) != 0)
+            err = ESP_ERR_INVALID_CRC;
+    }
+
+    mbedtls_sha256_free(&sha);
+    *image_len = meta.image_len;
+    return err;
+}
+
+static void ota_scan_task(void *param)
+{
+    esp_partition_iterator_t it = esp_partition_find(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, NULL);
+    for (; it != NULL; it = esp_partition_next(it))
+    {
+        const esp_partition_t *part = esp_partition_get(it);
+        if (!is_app_image(part))
+            continue;
+
+        digest_record_t rec;
+        if (digest_lookup(part, &rec) && rec.health != OTA_IMAGE_UNCHECKED)
+            continue;
+
+        uint8_t before[DIGEST_LEN], after[DIGEST_LEN];
+        if (!slot_fingerprint(part, before))
+            continue; // Empty or erased slot
+
+        int64_t t0 = esp_timer_get_time();
+        uint8_t digest[DIGEST_LEN] = {0};
+        size_t image_len = 0;
+        esp_err_t err = slot_hash(part, digest, &image_len);
+        if (err != ESP_OK && err != ESP_ERR_INVALID_CRC && err != ESP_ERR_INVALID_VERSION)
+        {
+            ESP_LOGW(TAG, "Could not scan '%s': %s", part->label, esp_err_to_name(err));
+            continue; // Retried on the next boot
+        }
+
+        // An upload may have rewritten the slot while we were reading it.
+        if (s_part == part || !slot_fingerprint(part, after) || memcmp(before, after, DIGEST_LEN) != 0)
+            continue;
+
+        digest_save(part, digest, image_len, err == ESP_OK ? OTA_IMAGE_OK : OTA_IMAGE_CORRUPT, false);
+        if (err == ESP_OK)
+            ESP_LOGI(TAG, "Scanned '%s' (%u bytes) in %lld ms", part->label, (unsigned)image_len,
+                     (esp_timer_get_time() - t0) / 1000);
+        else
+            ESP_LOGE(TAG, "'%s' is corrupt: %s", part->label, esp_err_to_name(err));
+    }
+    esp_partition_iterator_release(it);
+    vTaskDelete(NULL);
+}
+
+/* --- STALL PROBE ---
+ * A periodic esp_timer dispatched on the esp_timer task. Code placement on the
+ * writer side cannot shorten these gaps: during a flash operation the cache
+ * is off on both cores, so only the IRAM paths of Wi-Fi and lwIP keep running. */
+
+#if CONFIG_OTA_STALL_PROBE
+static esp_timer_handle_t s_probe = NULL;
+static int64_t s_probe_last = 0;
+
+static void probe_tick(void *arg)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t late = now - s_probe_last - PROBE_PERIOD_US;
+    s_probe_last = now;
+    if (late < PROBE_SLACK_US)
+        return;
+
+    s_stats.stall_us += late;
+    s_stats.stalls++;
+    if (late > s_stats.stall_max_us)
+        s_stats.stall_max_us = late;
+}
+
+static void probe_start(void)
+{
+    if (!s_probe)
+    {
+        const esp_timer_create_args_t args = {.callback = probe_tick, .name = "ota_probe"};
+        if (esp_timer_create(&args, &s_probe) != ESP_OK)
+            return;
+    }
+    s_probe_last = esp_timer_get_time();
+    esp_timer_start_periodic(s_probe, PROBE_PERIOD_US);
+}
+
+static void probe_stop(void)
+{
+    if (s_probe)
+        esp_timer_stop(s_probe);
+}
+#else
+static void probe_start(void) {}
+static void probe_stop(void) {}
+#endif
+
+/* --- WRITER TASK --- */
+
+static void ota_writer_task(void *param)
+{
+    while (true)
+    {
+        // Clear before peeking so a commit that lands after the peek re-sets the bit.
+        xEventGroupClearBits(s_pipe_events, PIPE_DATA_BIT);
+
+        const void *chunk = NULL;
+        size_t len = 0;
+        ref_slice_t *ref = NULL;
+        if (s_use_refs)
+        {
+            ref = ring_mpsc_peek(&s_refs);
+            if (ref)
+            {
+                chunk = ref->data;
+                len = ref->len;
+            }
+        }
+        else
+        {
+            len = ring_spsc_peek(&s_ring, &chunk);
+        }
+
+        if (len == 0 && ref == NULL)
+        {
+            if (xEventGroupGetBits(s_pipe_events) & PIPE_STOP_BIT)
+                break;
+            xEventGroupWaitBits(s_pipe_events, PIPE_DATA_BIT | PIPE_STOP_BIT,
+                                pdFALSE, pdFALSE, portMAX_DELAY);
+            continue;
+        }
+
+        // After a failure keep draining so the producer never blocks on a full ring.
+        if (s_write_err == ESP_OK && len > 0)
+        {
+            esp_err_t err = stream_feed(chunk, len);
+            if (err != ESP_OK)
+                s_write_err = err;
+        }
+
+        if (ref)
+        {
+            if (ref->release)
+                ref->release(ref->ctx);
+            ring_mpsc_release(&s_refs);
+        }
+        else
+        {
+            ring_spsc_release(&s_ring, len);
+        }
+        xEventGroupSetBits(s_pipe_events, PIPE_SPACE_BIT);
+    }
+
+    xEventGroupSetBits(s_pipe_events, PIPE_DONE_BIT);
+    vTaskDelete(NULL);
+}
+
+/* --- INTERNAL HELPERS --- */
+
+/* Stops the writer after it has drained the ring, then frees the ring. */
+static esp_err_t pipe_create(bool use_refs)
+{
+    s_use_refs = use_refs;
+    if (use_refs)
+        return ring_mpsc_create(&s_refs, sizeof(ref_slice_t), REF_SLOTS, RING_MEM_INTERNAL);
+    return ring_spsc_create(&s_ring, CONFIG_OTA_RING_SIZE, OTA_RING_MEM);
+}
+
+static void pipe_delete(void)
+{
+    if (s_use_refs)
+        ring_mpsc_delete(&s_refs);
+    else
+        ring_spsc_delete(&s_ring);
+}
+
+static esp_err_t pipeline_stop(void)
+{
+    xEventGroupSetBits(s_pipe_events, PIPE_STOP_BIT);
+    EventBits_t bits = xEventGroupWaitBits(s_pipe_events, PIPE_DONE_BIT,
+                                           pdFALSE, pdFALSE, pdMS_TO_TICKS(DRAIN_WAIT_MS));
+    if (!(bits & PIPE_DONE_BIT))
+    {
+        // Writer is stuck inside the flash driver; nothing it uses may be freed under it.
+        ESP_LOGE(TAG, "CRITICAL: Writer did not drain in time.");
+        return ESP_ERR_TIMEOUT;
+    }
+
+    pipe_delete();
+    return s_write_err;
+}
+
+/* The writer missed DRAIN_WAIT_MS and still owns the ring, the stream decoder
+ * and the esp_ota handle. The session stays open (s_part set) so no new one
+ * can start over them; session_stuck() closes it once the writer has exited. */
+static esp_err_t session_hold(void)
+{
+    s_write_err = ESP_ERR_TIMEOUT; // The writer drains the rest without programming it
+    s_stuck = true;
+    s_stats.elapsed_us = esp_timer_get_time() - s_start_us;
+    power_manager_release();
+    publish_ota_event(EVENT_OTA_FAILED, ESP_ERR_TIMEOUT);
+    return ESP_ERR_TIMEOUT;
+}
+
+static bool session_stuck(void)
+{
+    if (!s_stuck)
+        return false;
+    if (!(xEventGroupGetBits(s_pipe_events) & PIPE_DONE_BIT))
+    {
+        ESP_LOGE(TAG, "Writer of the last session still running.");
+        return true;
+    }
+
+    pipe_delete();
+    stream_reset();
+    esp_ota_abort(s_handle);
+    s_stuck = false;
+    s_part = NULL;
+    ESP_LOGW(TAG, "Writer exited, last session closed.");
+    return false;
+}
+
+/* --- PUBLIC API --- */
+
+static esp_err_t session_begin(size_t image_size, bool use_refs)
+{
+    if (session_stuck() || s_part != NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    const esp_partition_t *part = slot_target();
+    if (!part)
+        return ESP_ERR_NOT_FOUND;
+
+    if (part->type != ESP_PARTITION_TYPE_APP)
+    {
+        ESP_LOGE(TAG, "ASSERT FAIL: Target partition is not an APP partition!");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (image_size == 0 || image_size > part->size)
+        return ESP_ERR_INVALID_SIZE;
+
+    if (!s_pipe_events)
+    {
+        s_pipe_events = xEventGroupCreate();
+        if (!s_pipe_events)
+            return ESP_ERR_NO_MEM;
+    }
+    xEventGroupClearBits(s_pipe_events, PIPE_DATA_BIT | PIPE_SPACE_BIT | PIPE_STOP_BIT | PIPE_DONE_BIT);
+
+    esp_err_t err = pipe_create(use_refs);
+    if (err != ESP_OK)
+        return err;
+
+    // Erase nothing up front: esp_ota_write() erases each sector as the writer
+    // reaches it, so the receiver is not held up for the whole image before byte one.
+    err = esp_ota_begin(part, OTA_WITH_SEQUENTIAL_WRITES, &s_handle);
+    if (err != ESP_OK)
+    {
+        pipe_delete();
+        return err;
+    }
+
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_write_err = ESP_OK;
+    s_trailer_len = 0;
+    stream_reset();
+    load_key();
+
+    if (xTaskCreatePinnedToCore(ota_writer_task, "ota_writer", WRITER_STACK_SIZE, NULL,
+                                TASK_PLAN_HTTPD_PRIORITY, NULL, TASK_PLAN_APP_CORE) != pdPASS)
+    {
+        stream_reset();
+        esp_ota_abort(s_handle);
+        pipe_delete();
+        return ESP_ERR_NO_MEM;
+    }
+
+    power_manager_boost(); // Decrypt, hash and signature check all run inside the session
+    probe_start();
+    s_part = part;
+    s_total = image_size;
+    s_start_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "Session opened on '%s' (%u bytes)", part->label, (unsigned)image_size);
+    publish_ota_event(EVENT_OTA_STARTED, ESP_OK);
+    return ESP_OK;
+}
+
+esp_err_t ota_manager_begin(size_t image_size)
+{
+    return session_begin(image_size, false);
+}
+
+esp_err_t ota_manager_begin_refs(size_t image_size)
+{
+    return session_begin(image_size, true);
+}
+
+size_t ota_manager_reserve(void **out_ptr, size_t max_len)
+{
+    if (s_part == NULL || s_use_refs || s_write_err != ESP_OK)
+        return 0;
+
+    while (true)
+    {
+        xEventGroupClearBits(s_pipe_events, PIPE_SPACE_BIT);
+
+        size_t len = ring_spsc_reserve(&s_ring, out_ptr, max_len);
+        if (len > 0)
+            return len;
+
+        EventBits_t bits = xEventGroupWaitBits(s_pipe_events, PIPE_SPACE_BIT,
+                                               pdFALSE, pdFALSE, pdMS_TO_TICKS(SPACE_WAIT_MS));
+        if (!(bits & PIPE_SPACE_BIT))
+        {
+            ESP_LOGE(TAG, "Writer stalled, no ring space.");
+            return 0;
+        }
+        if (s_write_err != ESP_OK)
+            return 0;
+    }
+}
+
+esp_err_t ota_manager_commit(size_t len)
+{
+    if (s_part == NULL || s_use_refs)
+        return ESP_ERR_INVALID_STATE;
+
+    ring_spsc_commit(&s_ring, len);
+    xEventGroupSetBits(s_pipe_events, PIPE_DATA_BIT);
+    return s_write_err;
+}
+
+esp_err_t ota_manager_write(const void *data, size_t len)
+{
+    const uint8_t *src = data;
+    while (len > 0)
+    {
+        void *dst = NULL;
+        size_t n = ota_manager_reserve(&dst, len);
+        if (n == 0)
+            return (s_write_err != ESP_OK) ? s_write_err : ESP_ERR_TIMEOUT;
+
+        memcpy(dst, src, n);
+        esp_err_t err = ota_manager_commit(n);
+        if (err != ESP_OK)
+            return err;
+
+        src += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_manager_write_ref(const void *data, size_t len, ota_release_t release, void *ctx)
+{
+    if (s_part == NULL || !s_use_refs)
+        return ESP_ERR_INVALID_STATE;
+
+    while (true)
+    {
+        if (s_write_err != ESP_OK)
+            return s_write_err;
+
+        xEventGroupClearBits(s_pipe_events, PIPE_SPACE_BIT);
+
+        ref_slice_t *slot = ring_mpsc_reserve(&s_refs);
+        if (slot)
+        {
+            *slot = (ref_slice_t){.data = data, .len = len, .release = release, .ctx = ctx};
+            ring_mpsc_commit(&s_refs, slot);
+            xEventGroupSetBits(s_pipe_events, PIPE_DATA_BIT);
+            return ESP_OK;
+        }
+
+        EventBits_t bits = xEventGroupWaitBits(s_pipe_events, PIPE_SPACE_BIT,
+                                               pdFALSE, pdFALSE, pdMS_TO_TICKS(SPACE_WAIT_MS));
+        if (!(bits & PIPE_SPACE_BIT))
+        {
+            ESP_LOGE(TAG, "Writer stalled, no slice slot.");
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+}
+
+/* Closes the session; with activate == false the image is validated and
+ * cached but the boot partition is left alone. */
+static esp_err_t session_finish(bool activate)
+{
+    if (session_stuck() || s_part == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    const esp_partition_t *part = s_part;
+    esp_err_t err = pipeline_stop();
+    probe_stop();
+    if (err == ESP_ERR_TIMEOUT)
+        return session_hold();
+    if (err == ESP_OK)
+        err = stream_finish();
+    if (err == ESP_OK)
+        err = image_finish();
+    s_stats.elapsed_us = esp_timer_get_time() - s_start_us;
+    s_part = NULL;
+    stream_reset();
+    power_manager_release();
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Image write failed: %s", esp_err_to_name(err));
+        esp_ota_abort(s_handle);
+        publish_ota_event(EVENT_OTA_FAILED, err);
+        return err;
+    }
+
+    err = esp_ota_end(s_handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Image validation failed: %s", esp_err_to_name(err));
+        publish_ota_event(EVENT_OTA_FAILED, err);
+        return err;
+    }
+
+    // esp_ota_end() verified it. The signature is kept for encrypted uploads too, for
+    // ota_manager_activate_installed(); the flag keeps peer_share from serving them.
+    digest_save(part, s_digest, s_stats.bytes_written, OTA_IMAGE_OK, s_stats.encrypted);
+    signature_save(part);
+
+    if (activate)
+    {
+        err = slot_activate(part);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Set boot partition failed: %s", esp_err_to_name(err));
+            publish_ota_event(EVENT_OTA_FAILED, err);
+            return err;
+        }
+    }
+
+    s_last_part = part;
+    publish_ota_event(EVENT_OTA_FINISHED, ESP_OK);
+    return ESP_OK;
+}
+
+esp_err_t ota_manager_finish(void)
+{
+    return session_finish(true);
+}
+
+esp_err_t ota_manager_finish_staged(ota_staged_t *out)
+{
+    if (!out)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t err = session_finish(false);
+    if (err != ESP_OK)
+        return err;
+
+    out->part = s_last_part;
+    out->image_len = s_stats.bytes_written;
+    memcpy(out->sha256, s_digest, sizeof(out->sha256));
+    return ESP_OK;
+}
+
+void ota_manager_abort(void)
+{
+    if (session_stuck() || s_part == NULL)
+        return;
+
+    if (pipeline_stop() == ESP_ERR_TIMEOUT)
+    {
+        probe_stop();
+        session_hold();
+        return;
+    }
+    probe_stop();
+    s_stats.elapsed_us = esp_timer_get_time() - s_start_us;
+    s_part = NULL;
+    stream_reset();
+    power_manager_release();
+    esp_ota_abort(s_handle);
+    ESP_LOGW(TAG, "Session aborted after %u bytes", (unsigned)s_stats.bytes_written);
+    publish_ota_event(EVENT_OTA_FAILED, ESP_FAIL);
+}
+
+void ota_manager_get_stats(ota_stats_t *out)
+{
+    if (!out)
+        return;
+
+    *out = s_stats;
+    if (s_part != NULL && !s_stuck)
+        out->elapsed_us = esp_timer_get_time() - s_start_us;
+}
+
+esp_err_t ota_manager_scan_start(void)
+{
+    if (xTaskCreatePinnedToCore(ota_scan_task, "ota_scan", SCAN_STACK_SIZE, NULL,
+                                TASK_PLAN_BACKGROUND_PRIORITY, NULL, TASK_PLAN_BACKGROUND_CORE) != pdPASS)
+        return ESP_ERR_NO_MEM;
+    return ESP_OK;
+}
+
+esp_err_t ota_manager_activate_installed(const uint8_t sha256[32])
+{
+    if (!sha256)
+        return ESP_ERR_INVALID_ARG;
+    if (s_part != NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    esp_partition_iterator_t it = esp_partition_find(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, NULL);
+    for (; it != NULL; it = esp_partition_next(it))
+    {
+        const esp_partition_t *part = esp_partition_get(it);
+        if (part->subtype < ESP_PARTITION_SUBTYPE_APP_OTA_MIN || part->subtype >= ESP_PARTITION_SUBTYPE_APP_OTA_MAX)
+            continue;
+
+        digest_record_t rec;
+        if (!digest_lookup(part, &rec) || rec.health != OTA_IMAGE_OK || memcmp(rec.digest, sha256, DIGEST_LEN) != 0)
+            continue;
+
+#if CONFIG_OTA_SIGNATURE_VERIFY
+        // The scan records a digest for any valid image, also one written over serial.
+        // Only a slot whose signature was checked on upload may become bootable.
+        uint8_t trailer[SIG_TRAILER_MAX];
+        size_t trailer_len = sizeof(trailer);
+        if (ota_manager_get_signature(part, trailer, &trailer_len) != ESP_OK)
+        {
+            ESP_LOGW(TAG, "'%s' holds the image but has no verified signature", part->label);
+            continue;
+        }
+#endif
+
+        // set_boot_partition re-validates the image, so a damaged slot is still refused.
+        err = slot_activate(part);
+        if (err == ESP_OK)
+            ESP_LOGI(TAG, "Image already installed in '%s', boot partition switched", part->label);
+        break;
+    }
+    esp_partition_iterator_release(it);
+    return err;
+}
+
+esp_err_t ota_manager_get_signature(const esp_partition_t *part, uint8_t *buf, size_t *len)
+{
+    if (!part || !buf || !len)
+        return ESP_ERR_INVALID_ARG;
+
+    digest_record_t rec;
+    if (!digest_lookup(part, &rec) || rec.health != OTA_IMAGE_OK)
+        return ESP_ERR_NOT_FOUND;
+
+#if CONFIG_OTA_SIGNATURE_VERIFY
+    signature_record_t sig;
+    size_t sig_len = sizeof(sig);
+    if (storage_get_image_signature(part->label, &sig, &sig_len) != ESP_OK || sig_len <= DIGEST_LEN ||
+        memcmp(sig.digest, rec.digest, DIGEST_LEN) != 0)
+        return ESP_ERR_NOT_FOUND;
+
+    sig_len -= DIGEST_LEN;
+    if (sig_len > *len)
+        return ESP_ERR_INVALID_SIZE;
+    memcpy(buf, sig.trailer, sig_len);
+    *len = sig_len;
+#else
+    *len = 0;
+#endif
+    return ESP_OK;
+}
+
+const esp_partition_t *ota_manager_active_partition(void)
+{
+    return slot_active();
+}
+
+const esp_partition_t *ota_manager_target_partition(void)
+{
+    return slot_target();
+}
+
+esp_err_t ota_manager_check_rollback(bool *reverted)
+{
+    if (!reverted)
+        return ESP_ERR_INVALID_ARG;
+    *reverted = false;
+
+    const esp_partition_t *failed = health_settle();
+    const esp_partition_t *active = slot_active();
+    if (!active)
+        return ESP_OK;
+    esp_ota_img_states_t state;
+    if (failed != active && !(esp_ota_get_state_partition(active, &state) == ESP_OK &&
+                              (state == ESP_OTA_IMG_ABORTED || state == ESP_OTA_IMG_INVALID)))
+        return ESP_OK;
+
+    for (size_t i = 0; i < esp_ota_get_app_partition_count(); i++)
+    {
+        const esp_partition_t *part = slot_get(i);
+        if (!part || part == active || !slot_usable(part))
+            continue;
+
+        ESP_LOGW(TAG, "'%s' failed its health check, reverting to '%s'", active->label, part->label);
+        esp_err_t err = slot_activate(part);
+        *reverted = (err == ESP_OK);
+        return err;
+    }
+
+    ESP_LOGW(TAG, "'%s' failed its health check and no other slot is usable", active->label);
+    return ESP_OK;
+}
+
+esp_err_t ota_manager_get_image_info(const esp_partition_t *part, ota_image_info_t *out)
+{
+    if (!part || !out)
+        return ESP_ERR_INVALID_ARG;
+
+    memset(out, 0, sizeof(*out));
+    digest_record_t rec;
+    esp_app_desc_t desc;
+    if (esp_ota_get_partition_description(part, &desc) != ESP_OK)
+    {
+        out->health = OTA_IMAGE_EMPTY;
+        return ESP_OK;
+    }
+
+    strlcpy(out->version, desc.version, sizeof(out->version));
+    if (digest_lookup(part, &rec))
+    {
+        out->health = rec.health;
+        out->image_len = rec.image_len;
+        out->confidential = rec.confidential;
+        memcpy(out->sha256, rec.digest, DIGEST_LEN);
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_manager_get_health(ota_health_t *out)
+{
+    if (!out)
+        return ESP_ERR_INVALID_ARG;
+
+    health_pending_t rec;
+    if (storage_get_health_pending(&rec, sizeof(rec)) == ESP_OK && rec.magic == HEALTH_MAGIC)
+    {
+        memset(out, 0, sizeof(*out));
+        out->result = OTA_HEALTH_PENDING;
+        strlcpy(out->slot, rec.slot, sizeof(out->slot));
+        strlcpy(out->version, rec.version, sizeof(out->version));
+        return storage_get_boot_stage(&out->stage);
+    }
+
+    esp_err_t err = storage_get_health_report(out, sizeof(*out));
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+    {
+        memset(out, 0, sizeof(*out));
+        return ESP_OK;
+    }
+    return err;
+}
+
+const char *ota_manager_health_cause_name(uint8_t cause)
+{
+    switch (cause)
+    {
+    case OTA_HEALTH_CAUSE_CRASHED:
+        return "reset before confirming";
+    case OTA_HEALTH_CAUSE_REJECTED:
+        return "marked invalid";
+    case OTA_HEALTH_CAUSE_FELL_BACK:
+        return "switched to factory";
+    default:
+        return "none";
+    }
+}
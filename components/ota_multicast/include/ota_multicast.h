@@ -0,0 +1,83 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+
+/*
+ * Multicast OTA receiver: one transfer updates a whole room.
+ * tools/mcast_send.py splits the image into blocks, groups them by k, and
+ * appends r Cauchy Reed-Solomon repair blocks (GF(2^8)) to each group, so any
+ * k of a group's k + r blocks rebuild it. Blocks are assembled out of order
+ * in PSRAM. At the end of each round every device reports the groups it still
+ * misses, and the sender resends only the union of those. The finished image
+ * then goes through ota_manager like any upload: signature, encryption and A/B
+ * rules apply, so a forged multicast stream is rejected there.
+ *
+ * All fields are little-endian.
+ */
+
+#define OTA_MCAST_MAGIC 0x31434d52        // "RMC1"
+#define OTA_MCAST_REPORT_MAGIC 0x52434d52 // "RMCR"
+#define OTA_MCAST_MIN_BLOCK 256
+#define OTA_MCAST_MAX_BLOCK 1408 // Header + block fit one 1500-byte frame
+#define OTA_MCAST_MAX_K 32
+#define OTA_MCAST_MAX_R 8
+#define OTA_MCAST_MAX_IMAGE (8 * 1024 * 1024)
+#define OTA_MCAST_REPORT_MAX_GROUPS 256
+
+typedef enum
+{
+    OTA_MCAST_PKT_ANNOUNCE = 0, // Payload: SHA-256 of the whole image stream
+    OTA_MCAST_PKT_BLOCK,        // index < k: data block, else repair block index - k
+    OTA_MCAST_PKT_ROUND_END,    // group holds the round number; devices answer with a report
+} ota_mcast_pkt_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t session; // Random per transfer
+    uint32_t image_size;
+    uint16_t block_size; // Every block is sent whole; the last one is zero-padded
+    uint8_t k;           // Data blocks per group (the last group may have fewer)
+    uint8_t r;           // Repair blocks per group
+    uint8_t type;        // ota_mcast_pkt_t
+    uint8_t index;
+    uint16_t len; // Payload bytes after this header
+    uint32_t group;
+} ota_mcast_hdr_t;
+
+typedef enum
+{
+    OTA_MCAST_RECEIVING = 0,
+    OTA_MCAST_COMPLETE,  // All blocks held, installing
+    OTA_MCAST_INSTALLED, // Rebooting into the new image
+    OTA_MCAST_FAILED,    // result says why
+} ota_mcast_state_t;
+
+/* Sent unicast to the sender's address after each round end, and a few
+ * times when the transfer is over. Followed by up to
+ * OTA_MCAST_REPORT_MAX_GROUPS uint32_t ids of incomplete groups, lowest first. */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t session;
+    uint32_t round;
+    uint8_t state; // ota_mcast_state_t
+    uint8_t reserved[3];
+    int32_t result;         // esp_err_t when failed
+    uint32_t missing_count; // All incomplete groups, listed or not
+} ota_mcast_report_t;
+
+_Static_assert(sizeof(ota_mcast_hdr_t) == 24, "Wire format");
+_Static_assert(sizeof(ota_mcast_report_t) == 24, "Wire format");
+
+/**
+ * @brief Joins the group and receives in a background task.
+ * On success the image is installed and the device reboots into it.
+ * @param group              IPv4 or IPv6 group (e.g. "ff02::7701"), NULL for CONFIG_OTA_MCAST_GROUP.
+ * @param port               0 for CONFIG_OTA_MCAST_PORT.
+ * @param idle_timeout_sec   Stop after this long without a packet; 0 listens until reboot.
+ * @return ESP_ERR_INVALID_STATE if a receiver is already running.
+ * @return ESP_ERR_INVALID_ARG if group is not a multicast address.
+ */
+esp_err_t ota_multicast_start(const char *group, uint16_t port, uint32_t idle_timeout_sec);
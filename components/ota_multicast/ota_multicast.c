@@ -0,0 +1,370 @@
+#include "ota_multicast.h"
+#include "mcast_fec.h"
+#include "ota_manager.h"
+#include "power_manager.h"
+#include "event_bus.h"
+#include "task_plan.h"
+#include "esp_wifi.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "mbedtls/sha256.h"
+#include "lwip/sockets.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "OTA_MCAST";
+
+#define RX_STACK_SIZE 8192 // Report buffer (~1 KB) and ota_manager_finish() (signature check), as on httpd
+#define RX_POLL_MS 1000
+#define REPORT_JITTER_MS 300
+#define FINAL_REPORTS 3
+#define FINAL_REPORT_GAP_MS 100
+#define RESTART_DELAY_MS 2000
+
+typedef struct
+{
+    ota_mcast_hdr_t params; // session, image_size, block_size, k, r of the transfer
+    mcast_fec_t fec;        // fec.image is NULL when no session is open
+    uint8_t sha256[32];
+    bool announced;
+    uint32_t reported_round;
+    struct sockaddr_storage sender;
+    int64_t last_rx_us;
+    wifi_ps_type_t saved_ps;
+} session_t;
+
+_Static_assert(OTA_MCAST_MAX_K <= MCAST_FEC_MAX_K && OTA_MCAST_MAX_R <= MCAST_FEC_MAX_R, "Code limits");
+
+static struct
+{
+    int family; // AF_INET or AF_INET6, from the group address
+    struct in_addr group;
+    struct in6_addr group6;
+    uint16_t port;
+    uint32_t idle_timeout_sec;
+} s_cfg;
+
+static volatile bool s_running = false;
+static session_t s_rx;
+static uint32_t s_failed_session = 0; // Not restarted when its packets keep coming
+
+/* --- SESSION --- */
+
+static void session_close(session_t *s)
+{
+    if (!s->fec.image)
+        return;
+
+    mcast_fec_close(&s->fec);
+    esp_wifi_set_ps(s->saved_ps);
+    power_manager_release();
+    memset(s, 0, sizeof(*s));
+}
+
+static esp_err_t session_open(session_t *s, const ota_mcast_hdr_t *h)
+{
+    if (h->block_size < OTA_MCAST_MIN_BLOCK || h->block_size > OTA_MCAST_MAX_BLOCK ||
+        h->k == 0 || h->k > OTA_MCAST_MAX_K || h->r > OTA_MCAST_MAX_R ||
+        h->image_size == 0 || h->image_size > OTA_MCAST_MAX_IMAGE)
+        return ESP_ERR_INVALID_ARG;
+
+    // Any host on the segment can open a session: hold no more PSRAM than the slot could take.
+    const esp_partition_t *target = ota_manager_target_partition();
+    if (!target)
+        return ESP_ERR_NOT_FOUND;
+    if (h->image_size > target->size)
+        return ESP_ERR_INVALID_SIZE;
+
+    memset(s, 0, sizeof(*s));
+    esp_err_t err = mcast_fec_open(&s->fec, h->image_size, h->block_size, h->k, h->r);
+    if (err != ESP_OK)
+        return err;
+    s->params = *h;
+
+    // Modem sleep would only deliver multicast at DTIM intervals.
+    esp_wifi_get_ps(&s->saved_ps);
+    esp_wifi_set_ps(WIFI_PS_NONE);
+    power_manager_boost();
+
+    ESP_LOGI(TAG, "Session %08lx: %lu bytes, %lu groups of %u+%u x %u bytes", (unsigned long)h->session,
+             (unsigned long)h->image_size, (unsigned long)s->fec.n_groups, h->k, h->r, h->block_size);
+    return ESP_OK;
+}
+
+static void send_report(int sock, const session_t *s, uint32_t round, ota_mcast_state_t state, esp_err_t result)
+{
+    uint8_t buf[sizeof(ota_mcast_report_t) + OTA_MCAST_REPORT_MAX_GROUPS * sizeof(uint32_t)];
+    ota_mcast_report_t *rep = (ota_mcast_report_t *)buf;
+    memset(rep, 0, sizeof(*rep));
+    rep->magic = OTA_MCAST_REPORT_MAGIC;
+    rep->session = s->params.session;
+    rep->round = round;
+    rep->state = state;
+    rep->result = result;
+    rep->missing_count = s->fec.groups_left;
+
+    size_t n = 0;
+    uint32_t *ids = (uint32_t *)(buf + sizeof(*rep));
+    for (uint32_t g = 0; g < s->fec.n_groups && n < OTA_MCAST_REPORT_MAX_GROUPS; g++)
+    {
+        if (!mcast_fec_group_done(&s->fec, g))
+            ids[n++] = g;
+    }
+
+    sendto(sock, buf, sizeof(*rep) + n * sizeof(uint32_t), 0, (const struct sockaddr *)&s->sender,
+           s->sender.ss_family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+}
+
+/* Checks the assembled stream against the announced digest, then feeds it
+ * through the normal OTA path. */
+static esp_err_t session_install(session_t *s)
+{
+    uint8_t digest[32];
+    if (mbedtls_sha256(s->fec.image, s->params.image_size, digest, 0) != 0)
+        return ESP_FAIL;
+    if (memcmp(digest, s->sha256, sizeof(digest)) != 0)
+        return ESP_ERR_INVALID_CRC;
+
+    esp_err_t err = ota_manager_begin(s->params.image_size);
+    if (err != ESP_OK)
+        return err;
+
+    err = ota_manager_write(s->fec.image, s->params.image_size);
+    if (err != ESP_OK)
+    {
+        ota_manager_abort();
+        return err;
+    }
+    return ota_manager_finish();
+}
+
+/* --- RECEIVER TASK --- */
+
+/* Binds the port and joins the group, on every interface. */
+static int join_group(int sock)
+{
+    if (s_cfg.family == AF_INET6)
+    {
+        struct sockaddr_in6 addr = {
+            .sin6_family = AF_INET6,
+            .sin6_port = htons(s_cfg.port),
+            .sin6_addr = in6addr_any,
+        };
+        struct ipv6_mreq mreq = {
+            .ipv6mr_multiaddr = s_cfg.group6,
+            .ipv6mr_interface = 0,
+        };
+        if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+            return -1;
+        return setsockopt(sock, IPPROTO_IPV6, IPV6_JOIN_GROUP, &mreq, sizeof(mreq));
+    }
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(s_cfg.port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    struct ip_mreq mreq = {
+        .imr_multiaddr = s_cfg.group,
+        .imr_interface.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        return -1;
+    return setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+}
+
+static int rx_socket(void)
+{
+    int sock = socket(s_cfg.family, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0)
+        return -1;
+
+    int one = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct timeval tv = {.tv_sec = RX_POLL_MS / 1000, .tv_usec = (RX_POLL_MS % 1000) * 1000};
+
+    if (join_group(sock) != 0 ||
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) != 0)
+    {
+        ESP_LOGE(TAG, "Socket setup failed: errno %d", errno);
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+/* Returns true once the transfer is over (installed or failed). */
+static bool on_packet(int sock, session_t *s, const uint8_t *pkt, int len, const struct sockaddr_storage *from)
+{
+    ota_mcast_hdr_t h;
+    if (len < (int)sizeof(h))
+        return false;
+    memcpy(&h, pkt, sizeof(h));
+    const uint8_t *payload = pkt + sizeof(h);
+    if (h.magic != OTA_MCAST_MAGIC || h.len != (size_t)len - sizeof(h))
+        return false;
+
+    if (!s->fec.image)
+    {
+        if (h.type == OTA_MCAST_PKT_ROUND_END || h.session == s_failed_session)
+            return false;
+        esp_err_t err = session_open(s, &h);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Cannot receive session %08lx: %s", (unsigned long)h.session, esp_err_to_name(err));
+            s_failed_session = h.session;
+            return false;
+        }
+    }
+    else if (h.session != s->params.session)
+    {
+        return false;
+    }
+
+    s->sender = *from;
+    s->last_rx_us = esp_timer_get_time();
+
+    switch (h.type)
+    {
+    case OTA_MCAST_PKT_ANNOUNCE:
+        if (h.len == sizeof(s->sha256))
+        {
+            memcpy(s->sha256, payload, sizeof(s->sha256));
+            s->announced = true;
+        }
+        break;
+    case OTA_MCAST_PKT_BLOCK:
+        if (h.len == s->params.block_size)
+            mcast_fec_add(&s->fec, h.group, h.index, payload);
+        break;
+    case OTA_MCAST_PKT_ROUND_END:
+        if (h.group != s->reported_round)
+        {
+            // Spread the replies of a full room over a few hundred ms.
+            vTaskDelay(pdMS_TO_TICKS(esp_random() % REPORT_JITTER_MS));
+            send_report(sock, s, h.group, OTA_MCAST_RECEIVING, ESP_OK);
+            s->reported_round = h.group;
+            ESP_LOGI(TAG, "Round %lu: %lu of %lu groups missing", (unsigned long)h.group,
+                     (unsigned long)s->fec.groups_left, (unsigned long)s->fec.n_groups);
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (s->fec.groups_left > 0 || !s->announced)
+        return false;
+
+    ESP_LOGI(TAG, "All blocks received, installing.");
+    send_report(sock, s, s->reported_round, OTA_MCAST_COMPLETE, ESP_OK);
+    esp_err_t err = session_install(s);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Install failed: %s", esp_err_to_name(err));
+        s_failed_session = s->params.session;
+    }
+
+    for (int i = 0; i < FINAL_REPORTS; i++)
+    {
+        send_report(sock, s, s->reported_round, err == ESP_OK ? OTA_MCAST_INSTALLED : OTA_MCAST_FAILED, err);
+        vTaskDelay(pdMS_TO_TICKS(FINAL_REPORT_GAP_MS));
+    }
+    session_close(s);
+
+    if (err == ESP_OK)
+    {
+        event_bus_publish_simple(EVENT_RESTART_PENDING);
+        vTaskDelay(pdMS_TO_TICKS(RESTART_DELAY_MS));
+        esp_restart();
+    }
+    return true;
+}
+
+static void ota_mcast_task(void *param)
+{
+    uint8_t *pkt = malloc(sizeof(ota_mcast_hdr_t) + OTA_MCAST_MAX_BLOCK);
+    int sock = pkt ? rx_socket() : -1;
+    if (sock >= 0)
+    {
+        char group[INET6_ADDRSTRLEN];
+        inet_ntop(s_cfg.family, s_cfg.family == AF_INET6 ? (const void *)&s_cfg.group6 : (const void *)&s_cfg.group,
+                  group, sizeof(group));
+        ESP_LOGI(TAG, "Listening on %s port %u", group, s_cfg.port);
+    }
+
+    const int64_t idle_us = (int64_t)s_cfg.idle_timeout_sec * 1000000;
+    int64_t last_us = esp_timer_get_time();
+
+    while (sock >= 0)
+    {
+        struct sockaddr_storage from;
+        socklen_t from_len = sizeof(from);
+        int len = recvfrom(sock, pkt, sizeof(ota_mcast_hdr_t) + OTA_MCAST_MAX_BLOCK, 0,
+                           (struct sockaddr *)&from, &from_len);
+        int64_t now = esp_timer_get_time();
+
+        if (len > 0)
+        {
+            if (on_packet(sock, &s_rx, pkt, len, &from) && idle_us > 0)
+                break; // Armed for one transfer
+            if (s_rx.fec.image)
+                last_us = now;
+            continue;
+        }
+
+        if (s_rx.fec.image && now - s_rx.last_rx_us > (int64_t)CONFIG_OTA_MCAST_IDLE_TIMEOUT_SEC * 1000000)
+        {
+            ESP_LOGW(TAG, "Session %08lx stalled with %lu groups missing, dropped.",
+                     (unsigned long)s_rx.params.session, (unsigned long)s_rx.fec.groups_left);
+            session_close(&s_rx);
+        }
+        if (!s_rx.fec.image && idle_us > 0 && now - last_us > idle_us)
+        {
+            ESP_LOGI(TAG, "No transfer, receiver stopped.");
+            break;
+        }
+    }
+
+    session_close(&s_rx);
+    if (sock >= 0)
+        close(sock);
+    free(pkt);
+    s_running = false;
+    vTaskDelete(NULL);
+}
+
+/* --- PUBLIC API --- */
+
+esp_err_t ota_multicast_start(const char *group, uint16_t port, uint32_t idle_timeout_sec)
+{
+    if (s_running)
+        return ESP_ERR_INVALID_STATE;
+
+    if (!group)
+        group = CONFIG_OTA_MCAST_GROUP;
+    if (inet_pton(AF_INET, group, &s_cfg.group) == 1 && IN_MULTICAST(ntohl(s_cfg.group.s_addr)))
+        s_cfg.family = AF_INET;
+    else if (inet_pton(AF_INET6, group, &s_cfg.group6) == 1 && s_cfg.group6.s6_addr[0] == 0xff)
+        s_cfg.family = AF_INET6;
+    else
+        return ESP_ERR_INVALID_ARG;
+
+    s_cfg.port = port ? port : CONFIG_OTA_MCAST_PORT;
+    s_cfg.idle_timeout_sec = idle_timeout_sec;
+
+    s_running = true;
+    if (xTaskCreatePinnedToCore(ota_mcast_task, "ota_mcast", RX_STACK_SIZE, NULL,
+                                TASK_PLAN_HTTPD_PRIORITY, NULL, TASK_PLAN_APP_CORE) != pdPASS)
+    {
+        s_running = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "ota_manager.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Device-to-device image sharing.
+ * A device whose active slot holds a verified image advertises it over mDNS
+ * as _recovery._tcp (TXT: ver, sha256, size, path) and serves it on
+ * GET /image. A recovering device browses for those adverts and pulls
+ * through ota_fetch, so the image passes the same checks as an upload.
+ * Where only one unit is reachable from the operator, the update spreads
+ * device to device.
+ */
+
+#define PEER_SHARE_SERVICE "_recovery"
+#define PEER_SHARE_PROTO "_tcp"
+#define PEER_SHARE_PATH "/image"
+#define PEER_SHARE_MAX_PEERS 8
+
+typedef struct
+{
+    char host[48]; // IPv4 address, or IPv6 in brackets, as it goes in a URL
+    uint16_t port;
+    char version[32];
+    uint8_t sha256[32]; // Of the plain .bin, as in POST /ota/digest
+    uint32_t size;      // Bytes served, signature trailer included
+} peer_image_t;
+
+/**
+ * @brief Starts the mDNS responder and advertises this unit as _recovery._tcp.
+ * With CONFIG_PEER_SHARE_SERVE the servable image (if any) is added to the TXT
+ * records. Call after the web server is up.
+ */
+esp_err_t peer_share_start(void);
+
+/**
+ * @brief Finds the image this device can serve: the active slot, if the
+ * integrity scan or its upload verified it and its signature trailer is kept.
+ * An image that was uploaded encrypted is never served.
+ * @param[out]   info         Image details (length and digest of the plain .bin).
+ * @param[out]   trailer      At least OTA_SIG_TRAILER_MAX bytes.
+ * @param[inout] trailer_len  In: size of trailer. Out: bytes to send after the image.
+ * @return ESP_ERR_NOT_FOUND if there is nothing to serve.
+ */
+esp_err_t peer_share_servable(const esp_partition_t **part, ota_image_info_t *info,
+                              uint8_t *trailer, size_t *trailer_len);
+
+/**
+ * @brief Lists peers advertising an image (this device excluded).
+ * Blocks for CONFIG_PEER_SHARE_BROWSE_MS.
+ */
+esp_err_t peer_share_find(peer_image_t *out, size_t max, size_t *count);
+
+/**
+ * @brief Installs an image from a peer and makes it the boot partition.
+ * Peers are tried in discovery order; if a slot already holds the image,
+ * only the boot partition is switched.
+ * @param[in] sha256  Only accept this image; NULL for any.
+ * @return ESP_ERR_NOT_FOUND if no (matching) peer answered.
+ */
+esp_err_t peer_share_pull(const uint8_t sha256[32]);
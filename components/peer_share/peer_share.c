@@ -0,0 +1,196 @@
+#include "peer_share.h"
+#include "ota_fetch.h"
+#include "mdns.h"
+#include "esp_mac.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "PEER_SHARE";
+
+#define HTTP_PORT 80
+
+static char s_hostname[20];
+
+static bool hex_decode(const char *in, uint8_t *out, size_t len)
+{
+    if (!in || strlen(in) != 2 * len)
+        return false;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (sscanf(in + 2 * i, "%2hhx", &out[i]) != 1)
+            return false;
+    }
+    return true;
+}
+
+static const char *txt_get(const mdns_result_t *r, const char *key)
+{
+    for (size_t i = 0; i < r->txt_count; i++)
+    {
+        if (strcmp(r->txt[i].key, key) == 0)
+            return r->txt[i].value;
+    }
+    return NULL;
+}
+
+static bool parse_peer(const mdns_result_t *r, peer_image_t *out)
+{
+    if (r->hostname && strcmp(r->hostname, s_hostname) == 0)
+        return false; // Our own advert
+
+    // IPv4 first, else a routable IPv6 address: a URL cannot carry the zone of a link-local one
+    const mdns_ip_addr_t *v4 = NULL;
+    const mdns_ip_addr_t *v6 = NULL;
+    for (const mdns_ip_addr_t *a = r->addr; a; a = a->next)
+    {
+        if (a->addr.type == ESP_IPADDR_TYPE_V4 && !v4)
+            v4 = a;
+        else if (a->addr.type == ESP_IPADDR_TYPE_V6 && !v6 &&
+                 esp_netif_ip6_get_addr_type((esp_ip6_addr_t *)&a->addr.u_addr.ip6) != ESP_IP6_ADDR_IS_LINK_LOCAL)
+            v6 = a;
+    }
+    if (!v4 && !v6)
+        return false;
+
+    const char *ver = txt_get(r, "ver");
+    const char *size = txt_get(r, "size");
+    const char *path = txt_get(r, "path");
+    if (!size || !path || strcmp(path, PEER_SHARE_PATH) != 0 || !hex_decode(txt_get(r, "sha256"), out->sha256, 32))
+        return false;
+
+    if (v4)
+        snprintf(out->host, sizeof(out->host), IPSTR, IP2STR(&v4->addr.u_addr.ip4));
+    else
+        snprintf(out->host, sizeof(out->host), "[" IPV6STR "]", IPV62STR(v6->addr.u_addr.ip6));
+    out->port = r->port;
+    strlcpy(out->version, ver ? ver : "", sizeof(out->version));
+    out->size = strtoul(size, NULL, 10);
+    return true;
+}
+
+/* --- PUBLIC API --- */
+
+esp_err_t peer_share_servable(const esp_partition_t **part, ota_image_info_t *info,
+                              uint8_t *trailer, size_t *trailer_len)
+{
+    if (!part || !info || !trailer || !trailer_len)
+        return ESP_ERR_INVALID_ARG;
+
+    const esp_partition_t *active = ota_manager_active_partition();
+    if (!active || ota_manager_get_image_info(active, info) != ESP_OK || info->health != OTA_IMAGE_OK)
+        return ESP_ERR_NOT_FOUND;
+    if (info->confidential)
+        return ESP_ERR_NOT_FOUND; // GET /image would hand out the decrypted image
+
+    // Only images that arrived through ota_manager: the trailer is what lets a peer verify them.
+    esp_err_t err = ota_manager_get_signature(active, trailer, trailer_len);
+    if (err != ESP_OK)
+        return err;
+
+    *part = active;
+    return ESP_OK;
+}
+
+esp_err_t peer_share_start(void)
+{
+    esp_err_t err = mdns_init();
+    if (err != ESP_OK)
+        return err;
+
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(s_hostname, sizeof(s_hostname), "recovery-%02x%02x%02x", mac[3], mac[4], mac[5]);
+    mdns_hostname_set(s_hostname);
+    mdns_instance_name_set("ESP Recovery");
+
+    // Every unit is listed, so host tools (tools/fleet.py) can find it;
+    // the image records are only added when there is an image to share.
+    mdns_txt_item_t txt[4] = {{"ver", ""}};
+    size_t txt_count = 1;
+
+#if CONFIG_PEER_SHARE_SERVE
+    const esp_partition_t *part;
+    ota_image_info_t info;
+    uint8_t trailer[OTA_SIG_TRAILER_MAX];
+    size_t trailer_len = sizeof(trailer);
+    char sha[65];
+    char size[12];
+    if (peer_share_servable(&part, &info, trailer, &trailer_len) == ESP_OK)
+    {
+        for (int b = 0; b < 32; b++)
+            sprintf(sha + 2 * b, "%02x", info.sha256[b]);
+        snprintf(size, sizeof(size), "%lu", (unsigned long)(info.image_len + trailer_len));
+
+        txt[0].value = info.version;
+        txt[txt_count++] = (mdns_txt_item_t){"sha256", sha};
+        txt[txt_count++] = (mdns_txt_item_t){"size", size};
+        txt[txt_count++] = (mdns_txt_item_t){"path", PEER_SHARE_PATH};
+        ESP_LOGI(TAG, "%s.local: sharing '%s' from %s", s_hostname, info.version, part->label);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "%s.local: no verified image to share", s_hostname);
+    }
+#endif
+
+    return mdns_service_add(NULL, PEER_SHARE_SERVICE, PEER_SHARE_PROTO, HTTP_PORT, txt, txt_count);
+}
+
+esp_err_t peer_share_find(peer_image_t *out, size_t max, size_t *count)
+{
+    if (!out || !count)
+        return ESP_ERR_INVALID_ARG;
+    *count = 0;
+
+    mdns_result_t *results = NULL;
+    esp_err_t err = mdns_query_ptr(PEER_SHARE_SERVICE, PEER_SHARE_PROTO, CONFIG_PEER_SHARE_BROWSE_MS,
+                                   PEER_SHARE_MAX_PEERS + 1, &results);
+    if (err != ESP_OK)
+        return err;
+
+    for (const mdns_result_t *r = results; r && *count < max; r = r->next)
+    {
+        if (parse_peer(r, &out[*count]))
+            (*count)++;
+    }
+    mdns_query_results_free(results);
+
+    ESP_LOGI(TAG, "%u peer(s) sharing an image", (unsigned)*count);
+    return ESP_OK;
+}
+
+esp_err_t peer_share_pull(const uint8_t sha256[32])
+{
+    peer_image_t peers[PEER_SHARE_MAX_PEERS];
+    size_t count = 0;
+    esp_err_t err = peer_share_find(peers, PEER_SHARE_MAX_PEERS, &count);
+    if (err != ESP_OK)
+        return err;
+
+    err = ESP_ERR_NOT_FOUND;
+    for (size_t i = 0; i < count; i++)
+    {
+        const peer_image_t *p = &peers[i];
+        if (sha256 && memcmp(sha256, p->sha256, 32) != 0)
+            continue;
+
+        // Same image already in a slot: nothing to copy.
+        if (ota_manager_activate_installed(p->sha256) == ESP_OK)
+        {
+            ESP_LOGI(TAG, "'%s' is already installed", p->version);
+            return ESP_OK;
+        }
+
+        char url[80];
+        snprintf(url, sizeof(url), "http://%s:%u%s", p->host, p->port, PEER_SHARE_PATH);
+        ESP_LOGI(TAG, "Pulling '%s' (%lu bytes) from %s", p->version, (unsigned long)p->size, url);
+
+        err = ota_fetch_url(url);
+        if (err == ESP_OK)
+            return ESP_OK;
+        ESP_LOGW(TAG, "Pull from %s failed: %s", p->host, esp_err_to_name(err));
+    }
+    return err;
+}
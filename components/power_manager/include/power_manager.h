@@ -0,0 +1,46 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+
+/*
+ * Dynamic frequency scaling (CONFIG_PM_ENABLE).
+ * The CPU idles at CONFIG_POWER_MANAGER_MIN_FREQ_MHZ and runs at
+ * CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ while any caller holds a boost: OTA
+ * sessions, TLS downloads, self-update copies and the integrity scan.
+ * Without CONFIG_PM_ENABLE the clock stays fixed and boosts are only counted.
+ */
+
+typedef struct
+{
+    uint32_t cpu_mhz;     // Current CPU clock
+    uint32_t min_mhz;     // Idle clock (equals max_mhz without PM)
+    uint32_t max_mhz;     // Boost clock
+    uint32_t holders;     // Boosts held right now
+    uint32_t boost_count; // Times the clock was raised from idle since boot
+    int64_t boost_us;     // Total time spent boosted since boot
+    int64_t uptime_us;
+} power_stats_t;
+
+/**
+ * @brief Configures DFS and creates the boost lock.
+ * Call first in setup, before anything takes a boost. Light sleep stays off:
+ * it would add wake-up latency to every HTTP request.
+ */
+esp_err_t power_manager_init(void);
+
+/**
+ * @brief Holds the maximum CPU clock until the matching power_manager_release().
+ * Calls nest and may come from any task.
+ */
+void power_manager_boost(void);
+
+/**
+ * @brief Drops one boost; the clock falls back to idle when none are left.
+ */
+void power_manager_release(void);
+
+/**
+ * @brief Snapshot of the clock settings and boost counters.
+ */
+void power_manager_get_stats(power_stats_t *out);
@@ -0,0 +1,112 @@
+#include "power_manager.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "soc/rtc.h"
+#include "freertos/FreeRTOS.h"
+#include <stdbool.h>
+#include <string.h>
+
+static const char *TAG = "POWER_MANAGER";
+
+#if CONFIG_PM_ENABLE
+#define IDLE_FREQ_MHZ CONFIG_POWER_MANAGER_MIN_FREQ_MHZ
+#else
+#define IDLE_FREQ_MHZ CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+#endif
+
+static esp_pm_lock_handle_t s_boost_lock = NULL;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_holders = 0;
+static uint32_t s_boost_count = 0;
+static int64_t s_boost_us = 0;
+static int64_t s_boost_since = 0;
+
+/* --- PUBLIC API --- */
+
+esp_err_t power_manager_init(void)
+{
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = IDLE_FREQ_MHZ,
+        .light_sleep_enable = false,
+    };
+    esp_err_t err = esp_pm_configure(&config);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "DFS %d-%d MHz rejected: %s", IDLE_FREQ_MHZ, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+                 esp_err_to_name(err));
+        return err;
+    }
+
+    err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "boost", &s_boost_lock);
+    if (err != ESP_OK)
+        return err;
+
+    ESP_LOGI(TAG, "DFS enabled: %d MHz idle, %d MHz for transfers", IDLE_FREQ_MHZ, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+#else
+    ESP_LOGI(TAG, "PM disabled, CPU fixed at %d MHz", CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+#endif
+    return ESP_OK;
+}
+
+void power_manager_boost(void)
+{
+    // Raise the clock before the caller starts working.
+    if (s_boost_lock)
+        esp_pm_lock_acquire(s_boost_lock);
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    if (s_holders++ == 0)
+    {
+        s_boost_since = now;
+        s_boost_count++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void power_manager_release(void)
+{
+    int64_t now = esp_timer_get_time();
+    bool held = false;
+    portENTER_CRITICAL(&s_lock);
+    if (s_holders > 0)
+    {
+        held = true;
+        if (--s_holders == 0)
+            s_boost_us += now - s_boost_since;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (!held)
+    {
+        ESP_LOGW(TAG, "Release without a boost.");
+        return;
+    }
+    if (s_boost_lock)
+        esp_pm_lock_release(s_boost_lock);
+}
+
+void power_manager_get_stats(power_stats_t *out)
+{
+    if (!out)
+        return;
+
+    rtc_cpu_freq_config_t freq;
+    rtc_clk_cpu_freq_get_config(&freq);
+
+    int64_t now = esp_timer_get_time();
+    memset(out, 0, sizeof(*out));
+    out->cpu_mhz = freq.freq_mhz;
+    out->min_mhz = IDLE_FREQ_MHZ;
+    out->max_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    out->uptime_us = now;
+
+    portENTER_CRITICAL(&s_lock);
+    out->holders = s_holders;
+    out->boost_count = s_boost_count;
+    out->boost_us = s_boost_us + (s_holders > 0 ? now - s_boost_since : 0);
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "esp_err.h"
+#include "cJSON.h"
+#include <stddef.h>
+
+/*
+ * Recovery operations behind both front ends: the HTTP handlers
+ * (server_manager) and the serial console (recovery_console).
+ * Transport specifics (auth, status codes, where the bytes come from)
+ * stay with the caller; validation, OTA sessions and the JSON documents
+ * live here so the two cannot drift apart.
+ */
+
+/**
+ * @brief Validates and stores STA credentials (SSID 1..32, password up to 64 chars).
+ * They are used from the next boot on.
+ * @return ESP_ERR_INVALID_ARG if a length is out of range.
+ */
+esp_err_t recovery_api_set_wifi(const char *ssid, const char *pass);
+
+/**
+ * @brief Stores the task placement plan ("split", "shared", "floating") used
+ * from the next boot (see task_plan.h).
+ * @return ESP_ERR_INVALID_ARG for an unknown plan.
+ */
+esp_err_t recovery_api_select_plan(const char *name);
+
+/**
+ * @brief Image source for recovery_api_receive().
+ * @return Bytes read (at most len), 0 on a read timeout, < 0 if the transport failed.
+ */
+typedef int (*recovery_read_t)(void *ctx, void *buf, size_t len);
+
+/**
+ * @brief Opens an OTA session and streams exactly size bytes from read into it.
+ * The session is left open on success (ota_manager_finish() or
+ * self_update_stage() next) and aborted on failure.
+ * @return ESP_ERR_NOT_FOUND / ESP_ERR_INVALID_SIZE from ota_manager_begin().
+ * @return ESP_ERR_TIMEOUT if read timed out too many times in a row.
+ * @return ESP_FAIL if read failed.
+ * @return ESP_ERR_INVALID_STATE if the image could not be written.
+ */
+esp_err_t recovery_api_receive(size_t size, recovery_read_t read, void *ctx);
+
+/**
+ * @brief Logs the throughput of the last OTA session (see task_plan.h).
+ */
+void recovery_api_log_ota_stats(void);
+
+/**
+ * @brief Reboots in 2 s, leaving time for the answer to go out.
+ */
+void recovery_api_restart(void);
+
+/* JSON documents, also the GET bodies. NULL when out of memory; free with cJSON_Delete(). */
+
+/** @brief GET /ota/health: outcome of the last install. */
+cJSON *recovery_api_health_json(void);
+
+/** @brief GET /status/partitions: scan result of each app partition. */
+cJSON *recovery_api_partitions_json(void);
+
+/** @brief GET /heap, without the connection counters of the web server. */
+cJSON *recovery_api_heap_json(void);
+
+/** @brief GET /power: clock and boost counters. */
+cJSON *recovery_api_power_json(void);
+
+/** @brief GET /task_plan: plan in effect, its cores and priorities. */
+cJSON *recovery_api_task_plan_json(void);
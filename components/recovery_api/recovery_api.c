@@ -0,0 +1,299 @@
+#include "recovery_api.h"
+#include "storage_manager.h"
+#include "ota_manager.h"
+#include "heap_monitor.h"
+#include "power_manager.h"
+#include "event_bus.h"
+#include "task_plan.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_READ_TIMEOUT_RETRIES 5
+static const char *TAG = "RECOVERY_API";
+
+/* --- SETTINGS --- */
+
+esp_err_t recovery_api_set_wifi(const char *ssid, const char *pass)
+{
+    if (!ssid || !pass)
+        return ESP_ERR_INVALID_ARG;
+
+    // Validate WiFi Constraints (SSID <= 32, Pass <= 64)
+    size_t s_len = strlen(ssid);
+    size_t p_len = strlen(pass);
+    if (s_len == 0 || s_len > 32 || p_len > 64)
+    {
+        ESP_LOGE(TAG, "Invalid SSID/Pass length");
+        return ESP_ERR_INVALID_ARG;
+    }
+    return storage_set_wifi_creds(ssid, pass);
+}
+
+esp_err_t recovery_api_select_plan(const char *name)
+{
+    task_plan_mode_t mode = task_plan_from_name(name);
+    if (mode == TASK_PLAN_MODE_MAX)
+    {
+        ESP_LOGE(TAG, "Unknown task plan");
+        return ESP_ERR_INVALID_ARG;
+    }
+    return task_plan_select(mode);
+}
+
+/* --- OTA --- */
+
+esp_err_t recovery_api_receive(size_t size, recovery_read_t read, void *ctx)
+{
+    int timeout_retries = 0; // Guard for infinite timeout loop
+
+    esp_err_t err = ota_manager_begin(size);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "OTA Begin Failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    size_t remaining = size;
+    while (remaining > 0)
+    {
+        // Receive straight into the writer's ring; no intermediate buffer.
+        void *chunk = NULL;
+        size_t space = ota_manager_reserve(&chunk, remaining);
+        if (space == 0)
+        {
+            ESP_LOGE(TAG, "Flash Write Failed");
+            ota_manager_abort();
+            return ESP_ERR_INVALID_STATE;
+        }
+
+        int received = read(ctx, chunk, space);
+        if (received == 0)
+        {
+            timeout_retries++;
+            if (timeout_retries >= MAX_READ_TIMEOUT_RETRIES)
+            {
+                ESP_LOGE(TAG, "OTA Read Timeout limit reached. Aborting.");
+                ota_manager_abort();
+                return ESP_ERR_TIMEOUT;
+            }
+
+            ESP_LOGW(TAG, "Read Timeout, retrying... (%d/%d)", timeout_retries, MAX_READ_TIMEOUT_RETRIES);
+            continue;
+        }
+        if (received < 0)
+        {
+            // Other transport errors are fatal
+            ota_manager_abort();
+            return ESP_FAIL;
+        }
+
+        timeout_retries = 0;
+        if ((size_t)received > space)
+        {
+            ESP_LOGE(TAG, "CRITICAL: OTA Buffer Overflow Logic Error");
+            ota_manager_abort();
+            return ESP_ERR_INVALID_STATE;
+        }
+
+        if (ota_manager_commit(received) != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Flash Write Failed");
+            ota_manager_abort();
+            return ESP_ERR_INVALID_STATE;
+        }
+        remaining -= received;
+    }
+    return ESP_OK;
+}
+
+void recovery_api_log_ota_stats(void)
+{
+    ota_stats_t stats;
+    ota_manager_get_stats(&stats);
+    power_stats_t power;
+    power_manager_get_stats(&power);
+    ESP_LOGI(TAG, "OTA: %u bytes in %lld ms (%lld KB/s at %u MHz), flash writes %lld ms (worst stall %lld us)",
+             (unsigned)stats.bytes_written, stats.elapsed_us / 1000,
+             stats.elapsed_us > 0 ? ((int64_t)stats.bytes_written * 1000000 / stats.elapsed_us) / 1024 : 0,
+             (unsigned)power.max_mhz, stats.flash_us / 1000, stats.flash_max_us);
+    if (stats.encrypted)
+        ESP_LOGI(TAG, "OTA: AES-256-GCM image, decrypt %lld ms", stats.decrypt_us / 1000);
+    if (stats.signed_image)
+        ESP_LOGI(TAG, "OTA: signature verified in %lld ms", stats.verify_us / 1000);
+#if CONFIG_OTA_STALL_PROBE
+    ESP_LOGI(TAG, "OTA: core 0 stalled %lld ms in %u gaps (worst %lld us)",
+             stats.stall_us / 1000, (unsigned)stats.stalls, stats.stall_max_us);
+#endif
+}
+
+/* --- RESTART --- */
+
+static void restart_task(void *param)
+{
+    vTaskDelay(pdMS_TO_TICKS(2000));
+    esp_restart();
+}
+
+void recovery_api_restart(void)
+{
+    event_bus_publish_simple(EVENT_RESTART_PENDING);
+    xTaskCreatePinnedToCore(restart_task, "restart_task", 2048, NULL,
+                            TASK_PLAN_BACKGROUND_PRIORITY, NULL, TASK_PLAN_BACKGROUND_CORE);
+}
+
+/* --- STATUS DOCUMENTS --- */
+
+cJSON *recovery_api_health_json(void)
+{
+    static const char *const results[] = {"none", "pending", "healthy", "failed"};
+    ota_health_t health;
+    if (ota_manager_get_health(&health) != ESP_OK || health.result >= sizeof(results) / sizeof(results[0]))
+    {
+        ESP_LOGE(TAG, "Health record unreadable");
+        return NULL;
+    }
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+        return NULL;
+
+    cJSON_AddStringToObject(root, "result", results[health.result]);
+    if (health.result != OTA_HEALTH_NONE)
+    {
+        cJSON_AddStringToObject(root, "slot", health.slot);
+        cJSON_AddStringToObject(root, "version", health.version);
+        cJSON_AddNumberToObject(root, "stage", health.stage);
+    }
+    if (health.result == OTA_HEALTH_FAILED)
+        cJSON_AddStringToObject(root, "cause", ota_manager_health_cause_name(health.cause));
+    return root;
+}
+
+cJSON *recovery_api_partitions_json(void)
+{
+    static const char *const health_names[] = {"unchecked", "ok", "corrupt", "empty"};
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+        return NULL;
+
+    const esp_partition_t *active = ota_manager_active_partition();
+    bool factory_ok = true, main_app_ok = false;
+    cJSON *list = cJSON_AddArrayToObject(root, "partitions");
+
+    esp_partition_iterator_t it = esp_partition_find(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, NULL);
+    for (; it != NULL; it = esp_partition_next(it))
+    {
+        const esp_partition_t *part = esp_partition_get(it);
+        bool factory = (part->subtype == ESP_PARTITION_SUBTYPE_APP_FACTORY);
+        ota_image_info_t info;
+        if (ota_manager_get_image_info(part, &info) != ESP_OK || info.health >= sizeof(health_names) / sizeof(health_names[0]))
+            continue;
+
+        if (factory)
+            factory_ok = (info.health != OTA_IMAGE_CORRUPT);
+        else if (info.health == OTA_IMAGE_OK)
+            main_app_ok = true;
+
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "label", part->label);
+        cJSON_AddStringToObject(item, "type", factory ? "factory" : "ota");
+        cJSON_AddNumberToObject(item, "size", part->size);
+        cJSON_AddStringToObject(item, "health", health_names[info.health]);
+        cJSON_AddBoolToObject(item, "active", factory ? false : part == active);
+        if (info.health != OTA_IMAGE_EMPTY)
+            cJSON_AddStringToObject(item, "version", info.version);
+        if (info.health == OTA_IMAGE_OK)
+        {
+            char sha_hex[65];
+            for (int b = 0; b < 32; b++)
+                sprintf(sha_hex + 2 * b, "%02x", info.sha256[b]);
+            cJSON_AddNumberToObject(item, "image_size", info.image_len);
+            cJSON_AddStringToObject(item, "sha256", sha_hex);
+        }
+        cJSON_AddItemToArray(list, item);
+    }
+    esp_partition_iterator_release(it);
+
+    // One-request answer for tooling: serial reflash, OTA, or nothing.
+    cJSON_AddBoolToObject(root, "needs_reflash", !factory_ok);
+    cJSON_AddBoolToObject(root, "needs_update", !main_app_ok);
+    return root;
+}
+
+cJSON *recovery_api_heap_json(void)
+{
+    heap_monitor_stats_t stats;
+    heap_monitor_get_stats(&stats);
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+        return NULL;
+
+    cJSON *tags = cJSON_AddObjectToObject(root, "components");
+    for (int i = 0; i < HEAP_TAG_MAX; i++)
+    {
+        cJSON *t = cJSON_AddObjectToObject(tags, heap_monitor_tag_name(i));
+        cJSON_AddNumberToObject(t, "live_bytes", stats.tags[i].live_bytes);
+        cJSON_AddNumberToObject(t, "peak_bytes", stats.tags[i].peak_bytes);
+        cJSON_AddNumberToObject(t, "live_count", stats.tags[i].live_count);
+        cJSON_AddNumberToObject(t, "total_count", stats.tags[i].total_count);
+    }
+    cJSON_AddNumberToObject(root, "untracked_count", stats.untracked_count);
+
+    const struct
+    {
+        const char *name;
+        const heap_region_stats_t *region;
+    } regions[] = {{"internal", &stats.internal}, {"psram", &stats.psram}};
+
+    for (int i = 0; i < 2; i++)
+    {
+        cJSON *r = cJSON_AddObjectToObject(root, regions[i].name);
+        cJSON_AddNumberToObject(r, "free_bytes", regions[i].region->free_bytes);
+        cJSON_AddNumberToObject(r, "largest_free_block", regions[i].region->largest_free_block);
+        cJSON_AddNumberToObject(r, "min_free_bytes", regions[i].region->min_free_bytes);
+        cJSON_AddNumberToObject(r, "fragmentation_pct", regions[i].region->fragmentation_pct);
+    }
+    return root;
+}
+
+cJSON *recovery_api_power_json(void)
+{
+    power_stats_t stats;
+    power_manager_get_stats(&stats);
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+        return NULL;
+
+    cJSON_AddNumberToObject(root, "cpu_mhz", stats.cpu_mhz);
+    cJSON_AddNumberToObject(root, "min_mhz", stats.min_mhz);
+    cJSON_AddNumberToObject(root, "max_mhz", stats.max_mhz);
+    cJSON_AddNumberToObject(root, "boost_holders", stats.holders);
+    cJSON_AddNumberToObject(root, "boost_count", stats.boost_count);
+    cJSON_AddNumberToObject(root, "boost_ms", (double)(stats.boost_us / 1000));
+    cJSON_AddNumberToObject(root, "uptime_ms", (double)(stats.uptime_us / 1000));
+    cJSON_AddNumberToObject(root, "boost_pct",
+                            stats.uptime_us > 0 ? (double)(stats.boost_us * 100 / stats.uptime_us) : 0);
+    return root;
+}
+
+cJSON *recovery_api_task_plan_json(void)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+        return NULL;
+
+    cJSON_AddStringToObject(root, "plan", task_plan_name(task_plan_mode()));
+    cJSON_AddNumberToObject(root, "net_core", TASK_PLAN_NET_CORE);
+    cJSON_AddNumberToObject(root, "app_core", TASK_PLAN_APP_CORE); // tskNO_AFFINITY when floating
+    cJSON_AddNumberToObject(root, "background_core", TASK_PLAN_BACKGROUND_CORE);
+    cJSON_AddNumberToObject(root, "httpd_priority", TASK_PLAN_HTTPD_PRIORITY);
+    cJSON_AddNumberToObject(root, "background_priority", TASK_PLAN_BACKGROUND_PRIORITY);
+    return root;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "esp_err.h"
+
+/*
+ * Serial console: the recovery operations over the console UART, for a
+ * technician on site with a cable when Wi-Fi is not usable. Commands
+ * (`help` lists them) call the same recovery_api functions as the HTTP
+ * handlers and print the same JSON documents. There is no login: whoever
+ * holds the cable can also reflash over the ROM bootloader.
+ *
+ * `recv <size>` takes a raw image the way POST /ota does: the device
+ * answers "READY", the host sends exactly size bytes, then reads
+ * "OK" (the device reboots into the image) or "ERR <esp_err name>".
+ * See tools/console_send.py.
+ */
+
+/**
+ * @brief Registers the commands and starts the REPL task on the console UART.
+ */
+esp_err_t recovery_console_start(void);
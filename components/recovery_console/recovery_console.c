@@ -0,0 +1,298 @@
+#include "recovery_console.h"
+#include "recovery_api.h"
+#include "storage_manager.h"
+#include "ota_manager.h"
+#include "task_plan.h"
+#include "esp_console.h"
+#include "esp_app_desc.h"
+#include "esp_log.h"
+#include "driver/uart.h"
+#include "cJSON.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "RECOVERY_CONSOLE";
+
+#define CONSOLE_STACK_SIZE 8192 // recv runs ota_manager_finish() (signature check) on it, as on httpd
+#define READ_TIMEOUT_MS 2000    // recovery_api_receive() gives up after 5 in a row
+#define METRICS_PERIOD_MS 1000
+
+/* --- HELPER: Output --- */
+
+/* Prints a recovery_api document and frees it. Commands return 0 or 1, like a shell. */
+static int print_json(cJSON *root)
+{
+    if (!root)
+    {
+        printf("ERR status unavailable\n");
+        return 1;
+    }
+
+    char *json = cJSON_Print(root);
+    cJSON_Delete(root);
+    if (!json)
+    {
+        printf("ERR out of memory\n");
+        return 1;
+    }
+    printf("%s\n", json);
+    cJSON_free(json);
+    return 0;
+}
+
+static int print_result(esp_err_t err)
+{
+    if (err == ESP_OK)
+        printf("OK\n");
+    else
+        printf("ERR %s\n", esp_err_to_name(err));
+    return err == ESP_OK ? 0 : 1;
+}
+
+/* --- COMMANDS --- */
+
+static int cmd_status(int argc, char **argv)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+        return print_json(NULL);
+
+    cJSON_AddStringToObject(root, "version", esp_app_get_description()->version);
+
+    char ssid[33] = "", pass[65];
+    if (storage_get_wifi_creds(ssid, sizeof(ssid), pass, sizeof(pass)) != ESP_OK)
+        ssid[0] = '\0';
+    memset(pass, 0, sizeof(pass));
+    cJSON_AddStringToObject(root, "ssid", ssid);
+
+    cJSON *health = recovery_api_health_json();
+    if (health)
+        cJSON_AddItemToObject(root, "health", health);
+
+    // Only the verdict here; `partitions` has the details
+    cJSON *parts = recovery_api_partitions_json();
+    if (parts)
+    {
+        cJSON_AddItemToObject(root, "needs_reflash", cJSON_DetachItemFromObject(parts, "needs_reflash"));
+        cJSON_AddItemToObject(root, "needs_update", cJSON_DetachItemFromObject(parts, "needs_update"));
+        cJSON_Delete(parts);
+    }
+    return print_json(root);
+}
+
+static int cmd_wifi(int argc, char **argv)
+{
+    if (argc < 2 || argc > 3)
+    {
+        printf("usage: wifi <ssid> [password]\n");
+        return 1;
+    }
+
+    esp_err_t err = recovery_api_set_wifi(argv[1], argc == 3 ? argv[2] : "");
+    if (err != ESP_OK)
+        return print_result(err);
+
+    printf("Settings Saved. Rebooting...\n");
+    recovery_api_restart();
+    return 0;
+}
+
+static int cmd_partitions(int argc, char **argv)
+{
+    return print_json(recovery_api_partitions_json());
+}
+
+/* sha256sum format, from the integrity scan (the digest POST /ota/digest compares). */
+static int cmd_hash(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        printf("usage: hash <label>\n");
+        return 1;
+    }
+
+    cJSON *root = recovery_api_partitions_json();
+    if (!root)
+        return print_json(NULL);
+
+    int rc = 1;
+    bool found = false;
+    const cJSON *item;
+    cJSON_ArrayForEach(item, cJSON_GetObjectItem(root, "partitions"))
+    {
+        if (strcmp(cJSON_GetStringValue(cJSON_GetObjectItem(item, "label")), argv[1]) != 0)
+            continue;
+
+        found = true;
+        const char *sha = cJSON_GetStringValue(cJSON_GetObjectItem(item, "sha256"));
+        if (sha)
+        {
+            printf("%s  %s\n", sha, argv[1]);
+            rc = 0;
+        }
+        else
+        {
+            printf("ERR image %s\n", cJSON_GetStringValue(cJSON_GetObjectItem(item, "health")));
+        }
+    }
+    if (!found)
+        printf("ERR no app partition '%s'\n", argv[1]);
+
+    cJSON_Delete(root);
+    return rc;
+}
+
+static int uart_read(void *ctx, void *buf, size_t len)
+{
+    return uart_read_bytes(CONFIG_ESP_CONSOLE_UART_NUM, buf, len, pdMS_TO_TICKS(READ_TIMEOUT_MS));
+}
+
+/* Raw image bytes straight from the UART driver: the console's stdin
+ * would translate line endings. The host waits for READY before sending. */
+static int cmd_recv(int argc, char **argv)
+{
+    char *end = NULL;
+    long size = (argc == 2) ? strtol(argv[1], &end, 10) : 0;
+    if (argc != 2 || *end != '\0' || size <= 0)
+    {
+        printf("usage: recv <size>\n");
+        return 1;
+    }
+
+    printf("READY\n");
+    fflush(stdout);
+
+    esp_err_t err = recovery_api_receive(size, uart_read, NULL);
+    if (err == ESP_OK)
+        err = ota_manager_finish();
+    if (err != ESP_OK)
+    {
+        uart_flush_input(CONFIG_ESP_CONSOLE_UART_NUM); // Whatever the host still sends is not a command
+        return print_result(err);
+    }
+
+    recovery_api_log_ota_stats();
+    printf("OK\nUpdate Success. Rebooting...\n");
+    recovery_api_restart();
+    return 0;
+}
+
+static int cmd_reboot(int argc, char **argv)
+{
+    printf("Rebooting...\n");
+    recovery_api_restart();
+    return 0;
+}
+
+static int cmd_plan(int argc, char **argv)
+{
+    if (argc == 1)
+        return print_json(recovery_api_task_plan_json());
+    if (argc != 2)
+    {
+        printf("usage: plan [split|shared|floating]\n");
+        return 1;
+    }
+
+    esp_err_t err = recovery_api_select_plan(argv[1]);
+    if (err != ESP_OK)
+        return print_result(err);
+
+    printf("Plan Saved. Rebooting...\n");
+    recovery_api_restart();
+    return 0;
+}
+
+/* One line per second: heap, clock and the current (or last) OTA session. */
+static int cmd_metrics(int argc, char **argv)
+{
+    int seconds = (argc == 2) ? atoi(argv[1]) : 1;
+    if (argc > 2 || seconds <= 0)
+    {
+        printf("usage: metrics [seconds]\n");
+        return 1;
+    }
+
+    for (int i = 0; i < seconds; i++)
+    {
+        if (i > 0)
+            vTaskDelay(pdMS_TO_TICKS(METRICS_PERIOD_MS));
+
+        cJSON *root = cJSON_CreateObject();
+        if (!root)
+            return print_json(NULL);
+
+        ota_stats_t stats;
+        ota_manager_get_stats(&stats);
+        cJSON *ota = cJSON_AddObjectToObject(root, "ota");
+        cJSON_AddNumberToObject(ota, "bytes_written", stats.bytes_written);
+        cJSON_AddNumberToObject(ota, "elapsed_ms", (double)(stats.elapsed_us / 1000));
+        cJSON_AddNumberToObject(ota, "flash_ms", (double)(stats.flash_us / 1000));
+
+        cJSON *heap = recovery_api_heap_json();
+        if (heap)
+            cJSON_AddItemToObject(root, "heap", heap);
+        cJSON *power = recovery_api_power_json();
+        if (power)
+            cJSON_AddItemToObject(root, "power", power);
+
+        char *json = cJSON_PrintUnformatted(root);
+        cJSON_Delete(root);
+        if (!json)
+            return print_json(NULL);
+        printf("%s\n", json);
+        cJSON_free(json);
+    }
+    return 0;
+}
+
+/* --- PUBLIC API --- */
+
+esp_err_t recovery_console_start(void)
+{
+    const esp_console_cmd_t cmds[] = {
+        {.command = "status", .help = "Version, saved SSID, last install health", .func = cmd_status},
+        {.command = "wifi", .help = "Save STA credentials and reboot", .hint = "<ssid> [password]", .func = cmd_wifi},
+        {.command = "partitions", .help = "Integrity scan of the app partitions", .func = cmd_partitions},
+        {.command = "hash", .help = "SHA-256 of the image in an app partition", .hint = "<label>", .func = cmd_hash},
+        {.command = "recv", .help = "Receive a raw image of <size> bytes after READY, install it and reboot",
+         .hint = "<size>", .func = cmd_recv},
+        {.command = "reboot", .help = "Restart the device", .func = cmd_reboot},
+        {.command = "plan", .help = "Show the task placement plan, or select one and reboot",
+         .hint = "[split|shared|floating]", .func = cmd_plan},
+        {.command = "metrics", .help = "Heap, clock and OTA counters, once a second", .hint = "[seconds]",
+         .func = cmd_metrics},
+    };
+
+    esp_err_t err = esp_console_register_help_command();
+    for (size_t i = 0; i < sizeof(cmds) / sizeof(cmds[0]) && err == ESP_OK; i++)
+        err = esp_console_cmd_register(&cmds[i]);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Command registration failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt = "recovery>";
+    repl_config.task_stack_size = CONSOLE_STACK_SIZE;
+    repl_config.task_priority = TASK_PLAN_BACKGROUND_PRIORITY;
+    repl_config.task_core_id = TASK_PLAN_BACKGROUND_CORE;
+
+    esp_console_dev_uart_config_t uart_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    esp_console_repl_t *repl = NULL;
+    err = esp_console_new_repl_uart(&uart_config, &repl_config, &repl);
+    if (err == ESP_OK)
+        err = esp_console_start_repl(repl);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Console not started: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Serial console on UART%d, type 'help'", CONFIG_ESP_CONSOLE_UART_NUM);
+    return ESP_OK;
+}
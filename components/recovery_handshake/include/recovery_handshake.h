@@ -0,0 +1,129 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_ota_ops.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Boot health handshake, main app side (header only).
+ *
+ * After an install the recovery app boots the new image in the bootloader's
+ * pending-verify state. The image reports how far it got and must confirm
+ * itself within a window; otherwise it is marked invalid and the bootloader
+ * returns to factory, where the recovery app records the failure and reverts.
+ *
+ *   void app_main(void) {
+ *     recovery_handshake_begin(60000);
+ *     nvs_flash_init(); recovery_handshake_stage(RECOVERY_STAGE_STORAGE);
+ *     ...
+ *     recovery_handshake_confirm();
+ *   }
+ *
+ * Use from one source file: the timer handle is per translation unit.
+ * Stages are only written while a handshake is open, so normal boots do not
+ * touch NVS.
+ */
+
+#define RECOVERY_HS_NAMESPACE "app_settings"
+#define RECOVERY_HS_KEY_STAGE "hs_stage"
+
+// Values in between are free for app-specific steps; only the order matters.
+#define RECOVERY_STAGE_NONE 0x00
+#define RECOVERY_STAGE_BOOTED 0x01   // app_main entered
+#define RECOVERY_STAGE_STORAGE 0x20  // NVS / filesystems mounted
+#define RECOVERY_STAGE_NETWORK 0x40  // Connected
+#define RECOVERY_STAGE_SERVICES 0x80 // Application services running
+#define RECOVERY_STAGE_HEALTHY 0xFF  // Confirmed
+
+// Function-local so that including the header for the constants alone stays warning-free.
+static inline esp_timer_handle_t *recovery_handshake_timer(void)
+{
+    static esp_timer_handle_t timer = NULL;
+    return &timer;
+}
+
+static inline void recovery_handshake_expired(void *arg)
+{
+    (void)arg;
+    // Does not return: the bootloader skips this image from now on
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+}
+
+static inline void recovery_handshake_write(uint8_t stage)
+{
+    nvs_handle_t h;
+    if (nvs_open(RECOVERY_HS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK)
+        return; // NVS not initialized yet: the stage is simply not recorded
+    if (nvs_set_u8(h, RECOVERY_HS_KEY_STAGE, stage) == ESP_OK)
+        nvs_commit(h);
+    nvs_close(h);
+}
+
+/**
+ * @brief true if the running image still has to confirm itself.
+ */
+static inline bool recovery_handshake_pending(void)
+{
+    esp_ota_img_states_t state;
+    return esp_ota_get_state_partition(esp_ota_get_running_partition(), &state) == ESP_OK &&
+           state == ESP_OTA_IMG_PENDING_VERIFY;
+}
+
+/**
+ * @brief Opens the handshake if this is the first boot of a new image. Call first thing in app_main().
+ * @param[in] window_ms  Time allowed until recovery_handshake_confirm().
+ */
+static inline esp_err_t recovery_handshake_begin(uint32_t window_ms)
+{
+    esp_timer_handle_t *timer = recovery_handshake_timer();
+    if (*timer || !recovery_handshake_pending())
+        return ESP_OK;
+
+    const esp_timer_create_args_t args = {
+        .callback = recovery_handshake_expired,
+        .name = "recovery_hs",
+    };
+    esp_err_t err = esp_timer_create(&args, timer);
+    if (err == ESP_OK)
+        err = esp_timer_start_once(*timer, (uint64_t)window_ms * 1000);
+
+    recovery_handshake_write(RECOVERY_STAGE_BOOTED);
+    return err;
+}
+
+/**
+ * @brief Reports progress; the last stage reached is shown by the recovery app if the image fails.
+ * No-op unless a handshake is open.
+ */
+static inline void recovery_handshake_stage(uint8_t stage)
+{
+    if (*recovery_handshake_timer())
+        recovery_handshake_write(stage);
+}
+
+/**
+ * @brief Declares the image healthy and cancels the rollback.
+ */
+static inline esp_err_t recovery_handshake_confirm(void)
+{
+    esp_timer_handle_t *timer = recovery_handshake_timer();
+    if (*timer)
+    {
+        esp_timer_stop(*timer);
+        esp_timer_delete(*timer);
+        *timer = NULL;
+        recovery_handshake_write(RECOVERY_STAGE_HEALTHY);
+    }
+    return esp_ota_mark_app_valid_cancel_rollback();
+}
+
+/**
+ * @brief Gives up early (e.g. a failed self-test) instead of waiting for the window.
+ */
+static inline void recovery_handshake_fail(void)
+{
+    recovery_handshake_expired(NULL);
+}
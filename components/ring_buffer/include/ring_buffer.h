@@ -0,0 +1,141 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Lock-free ring buffers for handing data between tasks.
+ *
+ * - ring_spsc: byte stream, one producer and one consumer. Zero-copy:
+ *   the producer writes straight into ring memory (reserve/commit) and
+ *   the consumer reads straight out of it (peek/release).
+ * - ring_mpsc: fixed-size records, any number of producers, one consumer.
+ *   reserve() never blocks; it returns NULL when the ring is full.
+ *
+ * Neither buffer blocks or signals; pair them with a semaphore, event
+ * group or task notification to wake the other side.
+ */
+
+// PSRAM cache line on ESP32. Producer and consumer indices live on separate
+// lines so the two cores never write the same line.
+#define RING_CACHE_LINE 32
+
+typedef enum
+{
+    RING_MEM_INTERNAL = 0,
+    RING_MEM_PSRAM,
+} ring_mem_t;
+
+typedef struct
+{
+    _Alignas(RING_CACHE_LINE) atomic_uint head; // Written by producer only
+    _Alignas(RING_CACHE_LINE) atomic_uint tail; // Written by consumer only
+    _Alignas(RING_CACHE_LINE) uint8_t *buf;
+    uint32_t size; // Power of two
+    bool owns_buf;
+} ring_spsc_t;
+
+typedef struct
+{
+    _Alignas(RING_CACHE_LINE) atomic_uint head; // Shared by producers (CAS)
+    _Alignas(RING_CACHE_LINE) uint32_t tail;    // Consumer only
+    _Alignas(RING_CACHE_LINE) uint8_t *records;
+    atomic_uint *seq; // Per-slot sequence; must be internal RAM (S32C1I)
+    uint32_t record_size;
+    uint32_t count; // Power of two
+    bool owns_mem;
+} ring_mpsc_t;
+
+/* --- SPSC byte ring --- */
+
+/**
+ * @brief Initializes a ring over caller-provided storage (no allocation).
+ * @param[in] size  Storage size in bytes; must be a power of two.
+ * @return ESP_ERR_INVALID_ARG if size is not a power of two.
+ */
+esp_err_t ring_spsc_init(ring_spsc_t *rb, void *storage, size_t size);
+
+/**
+ * @brief Allocates a ring in internal RAM or PSRAM.
+ * @param[in] size  Capacity in bytes; rounded up to a power of two.
+ * @return ESP_ERR_NO_MEM if the allocation fails.
+ */
+esp_err_t ring_spsc_create(ring_spsc_t *rb, size_t size, ring_mem_t mem);
+
+/**
+ * @brief Frees storage allocated by ring_spsc_create().
+ */
+void ring_spsc_delete(ring_spsc_t *rb);
+
+/**
+ * @brief Producer: returns a contiguous writable span of up to max_len bytes.
+ * The span may be shorter than requested (wrap point or little free space).
+ * @return Span length; 0 if the ring is full.
+ */
+size_t ring_spsc_reserve(ring_spsc_t *rb, void **out_ptr, size_t max_len);
+
+/**
+ * @brief Producer: publishes len bytes of the last reserved span.
+ */
+void ring_spsc_commit(ring_spsc_t *rb, size_t len);
+
+/**
+ * @brief Consumer: returns the contiguous readable span at the tail.
+ * @return Span length; 0 if the ring is empty.
+ */
+size_t ring_spsc_peek(ring_spsc_t *rb, const void **out_ptr);
+
+/**
+ * @brief Consumer: frees len bytes from the tail.
+ */
+void ring_spsc_release(ring_spsc_t *rb, size_t len);
+
+/**
+ * @brief Bytes committed but not yet released.
+ */
+size_t ring_spsc_used(ring_spsc_t *rb);
+
+/* --- MPSC record ring --- */
+
+/**
+ * @brief Initializes a ring over caller-provided storage (no allocation).
+ * @param[in] records  count * record_size bytes, any RAM.
+ * @param[in] seq      count sequence words, internal RAM.
+ * @param[in] count    Number of records; must be a power of two.
+ */
+esp_err_t ring_mpsc_init(ring_mpsc_t *rb, void *records, atomic_uint *seq,
+                         size_t record_size, size_t count);
+
+/**
+ * @brief Allocates a ring; records go to mem, sequence words always internal.
+ */
+esp_err_t ring_mpsc_create(ring_mpsc_t *rb, size_t record_size, size_t count, ring_mem_t mem);
+
+/**
+ * @brief Frees storage allocated by ring_mpsc_create().
+ */
+void ring_mpsc_delete(ring_mpsc_t *rb);
+
+/**
+ * @brief Producer: claims a record slot. Never blocks.
+ * @return Pointer to record_size bytes, or NULL if the ring is full.
+ */
+void *ring_mpsc_reserve(ring_mpsc_t *rb);
+
+/**
+ * @brief Producer: publishes a slot returned by ring_mpsc_reserve().
+ */
+void ring_mpsc_commit(ring_mpsc_t *rb, void *record);
+
+/**
+ * @brief Consumer: returns the oldest published record, or NULL.
+ */
+void *ring_mpsc_peek(ring_mpsc_t *rb);
+
+/**
+ * @brief Consumer: frees the record returned by ring_mpsc_peek().
+ */
+void ring_mpsc_release(ring_mpsc_t *rb);
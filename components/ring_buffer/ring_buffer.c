@@ -0,0 +1,214 @@
+#include "ring_buffer.h"
+#include "esp_heap_caps.h"
+#include <string.h>
+
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+
+/* --- INTERNAL HELPERS --- */
+
+static bool is_pow2(size_t v)
+{
+    return v != 0 && (v & (v - 1)) == 0;
+}
+
+static size_t round_pow2(size_t v)
+{
+    size_t p = 1;
+    while (p < v)
+        p <<= 1;
+    return p;
+}
+
+static uint32_t mem_caps(ring_mem_t mem)
+{
+    return (mem == RING_MEM_PSRAM) ? (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+                                   : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+}
+
+/* --- SPSC BYTE RING --- */
+
+esp_err_t ring_spsc_init(ring_spsc_t *rb, void *storage, size_t size)
+{
+    if (!rb || !storage || !is_pow2(size))
+        return ESP_ERR_INVALID_ARG;
+
+    atomic_init(&rb->head, 0);
+    atomic_init(&rb->tail, 0);
+    rb->buf = storage;
+    rb->size = size;
+    rb->owns_buf = false;
+    return ESP_OK;
+}
+
+esp_err_t ring_spsc_create(ring_spsc_t *rb, size_t size, ring_mem_t mem)
+{
+    if (!rb || size == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    size = round_pow2(size);
+    void *storage = heap_caps_malloc(size, mem_caps(mem));
+    if (!storage)
+        return ESP_ERR_NO_MEM;
+
+    ring_spsc_init(rb, storage, size);
+    rb->owns_buf = true;
+    return ESP_OK;
+}
+
+void ring_spsc_delete(ring_spsc_t *rb)
+{
+    if (rb && rb->owns_buf)
+        heap_caps_free(rb->buf);
+    if (rb)
+        memset(rb, 0, sizeof(*rb));
+}
+
+size_t ring_spsc_reserve(ring_spsc_t *rb, void **out_ptr, size_t max_len)
+{
+    uint32_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+    uint32_t idx = head & (rb->size - 1);
+
+    size_t free_bytes = rb->size - (head - tail);
+    size_t n = MIN(MIN(max_len, free_bytes), rb->size - idx);
+
+    *out_ptr = rb->buf + idx;
+    return n;
+}
+
+void ring_spsc_commit(ring_spsc_t *rb, size_t len)
+{
+    uint32_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    atomic_store_explicit(&rb->head, head + len, memory_order_release);
+}
+
+size_t ring_spsc_peek(ring_spsc_t *rb, const void **out_ptr)
+{
+    uint32_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    uint32_t idx = tail & (rb->size - 1);
+
+    size_t n = MIN((size_t)(head - tail), rb->size - idx);
+
+    *out_ptr = rb->buf + idx;
+    return n;
+}
+
+void ring_spsc_release(ring_spsc_t *rb, size_t len)
+{
+    uint32_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    atomic_store_explicit(&rb->tail, tail + len, memory_order_release);
+}
+
+size_t ring_spsc_used(ring_spsc_t *rb)
+{
+    uint32_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+    return head - tail;
+}
+
+/* --- MPSC RECORD RING --- */
+// Bounded queue with a sequence word per slot (Vyukov). A slot is free for
+// position p when seq == p, and holds a published record when seq == p + 1.
+
+esp_err_t ring_mpsc_init(ring_mpsc_t *rb, void *records, atomic_uint *seq,
+                         size_t record_size, size_t count)
+{
+    if (!rb || !records || !seq || record_size == 0 || !is_pow2(count))
+        return ESP_ERR_INVALID_ARG;
+
+    atomic_init(&rb->head, 0);
+    rb->tail = 0;
+    rb->records = records;
+    rb->seq = seq;
+    rb->record_size = record_size;
+    rb->count = count;
+    rb->owns_mem = false;
+
+    for (uint32_t i = 0; i < count; i++)
+        atomic_init(&seq[i], i);
+
+    return ESP_OK;
+}
+
+esp_err_t ring_mpsc_create(ring_mpsc_t *rb, size_t record_size, size_t count, ring_mem_t mem)
+{
+    if (!rb || record_size == 0 || count == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    count = round_pow2(count);
+    void *records = heap_caps_malloc(record_size * count, mem_caps(mem));
+    // Compare-and-swap (S32C1I) only works on internal RAM on ESP32.
+    atomic_uint *seq = heap_caps_malloc(sizeof(atomic_uint) * count, MALLOC_CAP_INTERNAL | MALLOC_CAP_32BIT);
+    if (!records || !seq)
+    {
+        heap_caps_free(records);
+        heap_caps_free(seq);
+        return ESP_ERR_NO_MEM;
+    }
+
+    ring_mpsc_init(rb, records, seq, record_size, count);
+    rb->owns_mem = true;
+    return ESP_OK;
+}
+
+void ring_mpsc_delete(ring_mpsc_t *rb)
+{
+    if (rb && rb->owns_mem)
+    {
+        heap_caps_free(rb->records);
+        heap_caps_free(rb->seq);
+    }
+    if (rb)
+        memset(rb, 0, sizeof(*rb));
+}
+
+void *ring_mpsc_reserve(ring_mpsc_t *rb)
+{
+    uint32_t pos = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    while (true)
+    {
+        uint32_t slot = pos & (rb->count - 1);
+        uint32_t seq = atomic_load_explicit(&rb->seq[slot], memory_order_acquire);
+        int32_t dif = (int32_t)(seq - pos);
+
+        if (dif == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&rb->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                return rb->records + (size_t)slot * rb->record_size;
+            // CAS failure reloaded pos; retry.
+        }
+        else if (dif < 0)
+        {
+            return NULL; // Full
+        }
+        else
+        {
+            pos = atomic_load_explicit(&rb->head, memory_order_relaxed);
+        }
+    }
+}
+
+void ring_mpsc_commit(ring_mpsc_t *rb, void *record)
+{
+    uint32_t slot = ((uint8_t *)record - rb->records) / rb->record_size;
+    uint32_t seq = atomic_load_explicit(&rb->seq[slot], memory_order_relaxed);
+    atomic_store_explicit(&rb->seq[slot], seq + 1, memory_order_release);
+}
+
+void *ring_mpsc_peek(ring_mpsc_t *rb)
+{
+    uint32_t slot = rb->tail & (rb->count - 1);
+    uint32_t seq = atomic_load_explicit(&rb->seq[slot], memory_order_acquire);
+    if (seq != rb->tail + 1)
+        return NULL;
+    return rb->records + (size_t)slot * rb->record_size;
+}
+
+void ring_mpsc_release(ring_mpsc_t *rb)
+{
+    uint32_t slot = rb->tail & (rb->count - 1);
+    atomic_store_explicit(&rb->seq[slot], rb->tail + rb->count, memory_order_release);
+    rb->tail++;
+}
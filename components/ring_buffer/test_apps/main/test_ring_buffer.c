@@ -0,0 +1,364 @@
+#include "ring_buffer.h"
+#include "unity.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Runs on the linux target: producers and consumers are real pthreads, so the
+ * rings see genuine concurrency (the FreeRTOS POSIX port runs one task at a time).
+ */
+
+#define SPSC_SIZE 4096
+#define SPSC_STRESS_BYTES (16u * 1024 * 1024)
+#define SPSC_BENCH_BYTES (256u * 1024 * 1024)
+#define SPSC_BENCH_CHUNK 1436 // One TCP segment, as the OTA writer sees it
+
+#define MPSC_COUNT 64
+#define MPSC_PRODUCERS 4
+#define MPSC_STRESS_RECORDS 1000000u // Per producer
+#define MPSC_BENCH_RECORDS 4000000u  // Per producer
+
+#define STALL_TIMEOUT_S 5.0 // Consumer sees nothing new for this long: the ring lost data
+
+typedef struct
+{
+    uint32_t producer;
+    uint32_t seq;
+} record_t;
+
+static atomic_bool s_stop; // Set when the consumer gives up; frees producers waiting on a full ring
+
+/* --- HELPERS --- */
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Byte n of the test stream. 251 is prime, so it never lines up with the ring size.
+static uint8_t stream_byte(uint32_t n)
+{
+    return (uint8_t)(n % 251);
+}
+
+// xorshift32: each thread keeps its own state
+static uint32_t next_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+/* --- SPSC --- */
+
+typedef struct
+{
+    ring_spsc_t *rb;
+    uint32_t total;
+    size_t chunk; // 0: random lengths
+    bool fill;    // Write the test stream (off for the benchmark)
+} spsc_job_t;
+
+static void *spsc_producer(void *arg)
+{
+    spsc_job_t *job = arg;
+    uint32_t rnd = 0x12345678, sent = 0;
+    while (sent < job->total)
+    {
+        size_t want = job->chunk ? job->chunk : 1 + next_rand(&rnd) % 1500;
+        if (want > job->total - sent)
+            want = job->total - sent;
+
+        void *span;
+        size_t n = ring_spsc_reserve(job->rb, &span, want);
+        if (n == 0)
+        {
+            if (atomic_load(&s_stop))
+                return NULL;
+            sched_yield();
+            continue;
+        }
+        if (job->fill)
+        {
+            for (size_t i = 0; i < n; i++)
+                ((uint8_t *)span)[i] = stream_byte(sent + i);
+        }
+        ring_spsc_commit(job->rb, n);
+        sent += n;
+    }
+    return NULL;
+}
+
+// Consumes job->total bytes; returns the offset of the first wrong or missing byte, or total.
+static uint32_t spsc_consume(spsc_job_t *job)
+{
+    uint32_t rnd = 0x9abcdef0, received = 0;
+    double deadline = now_s() + STALL_TIMEOUT_S;
+    while (received < job->total)
+    {
+        const void *span;
+        size_t n = ring_spsc_peek(job->rb, &span);
+        if (n == 0)
+        {
+            if (now_s() > deadline)
+                return received;
+            sched_yield();
+            continue;
+        }
+        deadline = now_s() + STALL_TIMEOUT_S;
+        if (!job->chunk) // Release less than is there, to exercise partial spans
+            n = 1 + next_rand(&rnd) % n;
+        if (job->fill)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                if (((const uint8_t *)span)[i] != stream_byte(received + i))
+                    return received + i;
+            }
+        }
+        ring_spsc_release(job->rb, n);
+        received += n;
+    }
+    return received;
+}
+
+static void test_spsc_rejects_bad_size(void)
+{
+    static uint8_t storage[SPSC_SIZE];
+    ring_spsc_t rb;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, ring_spsc_init(&rb, storage, 3000));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, ring_spsc_init(&rb, storage, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, ring_spsc_init(&rb, storage, sizeof(storage)));
+
+    TEST_ASSERT_EQUAL(ESP_OK, ring_spsc_create(&rb, 3000, RING_MEM_INTERNAL));
+    TEST_ASSERT_EQUAL(4096, rb.size);
+    ring_spsc_delete(&rb);
+}
+
+static void test_spsc_wrap(void)
+{
+    ring_spsc_t rb;
+    TEST_ASSERT_EQUAL(ESP_OK, ring_spsc_create(&rb, 16, RING_MEM_INTERNAL));
+
+    void *w;
+    const void *r;
+    TEST_ASSERT_EQUAL(16, ring_spsc_reserve(&rb, &w, 100));
+    ring_spsc_commit(&rb, 12);
+    TEST_ASSERT_EQUAL(4, ring_spsc_reserve(&rb, &w, 100)); // Only 4 free
+    TEST_ASSERT_EQUAL(12, ring_spsc_peek(&rb, &r));
+    ring_spsc_release(&rb, 10);
+
+    // 14 free, but only 4 before the wrap point
+    TEST_ASSERT_EQUAL(4, ring_spsc_reserve(&rb, &w, 100));
+    TEST_ASSERT_EQUAL_PTR(rb.buf + 12, w);
+    ring_spsc_commit(&rb, 4);
+    TEST_ASSERT_EQUAL(10, ring_spsc_reserve(&rb, &w, 100));
+    TEST_ASSERT_EQUAL_PTR(rb.buf, w);
+    ring_spsc_commit(&rb, 10);
+    TEST_ASSERT_EQUAL(16, ring_spsc_used(&rb));
+    TEST_ASSERT_EQUAL(0, ring_spsc_reserve(&rb, &w, 100)); // Full
+
+    TEST_ASSERT_EQUAL(6, ring_spsc_peek(&rb, &r)); // Up to the wrap point
+    ring_spsc_release(&rb, 6);
+    TEST_ASSERT_EQUAL(10, ring_spsc_peek(&rb, &r));
+    TEST_ASSERT_EQUAL_PTR(rb.buf, r);
+    ring_spsc_release(&rb, 10);
+    TEST_ASSERT_EQUAL(0, ring_spsc_peek(&rb, &r));
+
+    ring_spsc_delete(&rb);
+}
+
+static void test_spsc_stress(void)
+{
+    ring_spsc_t rb;
+    TEST_ASSERT_EQUAL(ESP_OK, ring_spsc_create(&rb, SPSC_SIZE, RING_MEM_INTERNAL));
+    spsc_job_t job = {.rb = &rb, .total = SPSC_STRESS_BYTES, .chunk = 0, .fill = true};
+
+    pthread_t producer;
+    atomic_store(&s_stop, false);
+    TEST_ASSERT_EQUAL(0, pthread_create(&producer, NULL, spsc_producer, &job));
+    uint32_t good = spsc_consume(&job);
+    atomic_store(&s_stop, good != SPSC_STRESS_BYTES);
+    pthread_join(producer, NULL);
+
+    TEST_ASSERT_EQUAL_UINT32(SPSC_STRESS_BYTES, good);
+    TEST_ASSERT_EQUAL(0, ring_spsc_used(&rb));
+    ring_spsc_delete(&rb);
+}
+
+static void test_spsc_throughput(void)
+{
+    ring_spsc_t rb;
+    TEST_ASSERT_EQUAL(ESP_OK, ring_spsc_create(&rb, SPSC_SIZE * 4, RING_MEM_INTERNAL));
+    spsc_job_t job = {.rb = &rb, .total = SPSC_BENCH_BYTES, .chunk = SPSC_BENCH_CHUNK, .fill = false};
+
+    pthread_t producer;
+    atomic_store(&s_stop, false);
+    double t0 = now_s();
+    TEST_ASSERT_EQUAL(0, pthread_create(&producer, NULL, spsc_producer, &job));
+    uint32_t done = spsc_consume(&job);
+    pthread_join(producer, NULL);
+    double elapsed = now_s() - t0;
+
+    TEST_ASSERT_EQUAL_UINT32(SPSC_BENCH_BYTES, done);
+    printf("SPSC: %u MB in %.3f s, %.0f MB/s (%u byte spans)\n", SPSC_BENCH_BYTES >> 20, elapsed,
+           (SPSC_BENCH_BYTES >> 20) / elapsed, SPSC_BENCH_CHUNK);
+    ring_spsc_delete(&rb);
+}
+
+/* --- MPSC --- */
+
+typedef struct
+{
+    ring_mpsc_t *rb;
+    uint32_t id;
+    uint32_t records;
+} mpsc_job_t;
+
+static void *mpsc_producer(void *arg)
+{
+    mpsc_job_t *job = arg;
+    for (uint32_t seq = 0; seq < job->records; seq++)
+    {
+        record_t *rec;
+        while ((rec = ring_mpsc_reserve(job->rb)) == NULL)
+        {
+            if (atomic_load(&s_stop))
+                return NULL;
+            sched_yield();
+        }
+        rec->producer = job->id;
+        rec->seq = seq;
+        ring_mpsc_commit(job->rb, rec);
+    }
+    return NULL;
+}
+
+// Runs MPSC_PRODUCERS producers against one consumer. Each producer's records
+// must arrive complete and in order; returns false on the first that does not.
+static bool mpsc_run(ring_mpsc_t *rb, uint32_t per_producer)
+{
+    pthread_t threads[MPSC_PRODUCERS];
+    mpsc_job_t jobs[MPSC_PRODUCERS];
+    uint32_t expected[MPSC_PRODUCERS] = {0};
+
+    atomic_store(&s_stop, false);
+    for (uint32_t i = 0; i < MPSC_PRODUCERS; i++)
+    {
+        jobs[i] = (mpsc_job_t){.rb = rb, .id = i, .records = per_producer};
+        TEST_ASSERT_EQUAL(0, pthread_create(&threads[i], NULL, mpsc_producer, &jobs[i]));
+    }
+
+    bool ok = true;
+    double deadline = now_s() + STALL_TIMEOUT_S;
+    for (uint32_t left = per_producer * MPSC_PRODUCERS; left > 0;)
+    {
+        const record_t *rec = ring_mpsc_peek(rb);
+        if (!rec)
+        {
+            if (now_s() > deadline)
+            {
+                printf("MPSC: %u records never arrived\n", (unsigned)left);
+                ok = false;
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+        deadline = now_s() + STALL_TIMEOUT_S;
+        if (rec->producer >= MPSC_PRODUCERS || rec->seq != expected[rec->producer])
+        {
+            printf("MPSC: producer %u sent %u, expected %u\n", (unsigned)rec->producer, (unsigned)rec->seq,
+                   rec->producer < MPSC_PRODUCERS ? (unsigned)expected[rec->producer] : 0u);
+            ok = false;
+            break;
+        }
+        expected[rec->producer]++;
+        ring_mpsc_release(rb);
+        left--;
+    }
+
+    atomic_store(&s_stop, !ok);
+    for (uint32_t i = 0; i < MPSC_PRODUCERS; i++)
+        pthread_join(threads[i], NULL);
+    return ok && ring_mpsc_peek(rb) == NULL;
+}
+
+static void test_mpsc_full_and_empty(void)
+{
+    ring_mpsc_t rb;
+    TEST_ASSERT_EQUAL(ESP_OK, ring_mpsc_create(&rb, sizeof(record_t), 3, RING_MEM_INTERNAL));
+    TEST_ASSERT_EQUAL(4, rb.count);
+    TEST_ASSERT_NULL(ring_mpsc_peek(&rb));
+
+    record_t *recs[4];
+    for (int i = 0; i < 4; i++)
+    {
+        recs[i] = ring_mpsc_reserve(&rb);
+        TEST_ASSERT_NOT_NULL(recs[i]);
+        recs[i]->seq = i;
+    }
+    TEST_ASSERT_NULL(ring_mpsc_reserve(&rb));
+
+    // Committed out of order: the consumer still waits for the oldest
+    ring_mpsc_commit(&rb, recs[1]);
+    TEST_ASSERT_NULL(ring_mpsc_peek(&rb));
+    ring_mpsc_commit(&rb, recs[0]);
+    ring_mpsc_commit(&rb, recs[2]);
+    ring_mpsc_commit(&rb, recs[3]);
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        record_t *rec = ring_mpsc_peek(&rb);
+        TEST_ASSERT_NOT_NULL(rec);
+        TEST_ASSERT_EQUAL_UINT32(i, rec->seq);
+        ring_mpsc_release(&rb);
+        TEST_ASSERT_NOT_NULL(ring_mpsc_reserve(&rb)); // The freed slot is usable again
+    }
+    ring_mpsc_delete(&rb);
+}
+
+static void test_mpsc_stress(void)
+{
+    ring_mpsc_t rb;
+    TEST_ASSERT_EQUAL(ESP_OK, ring_mpsc_create(&rb, sizeof(record_t), MPSC_COUNT, RING_MEM_INTERNAL));
+    TEST_ASSERT_TRUE(mpsc_run(&rb, MPSC_STRESS_RECORDS));
+    ring_mpsc_delete(&rb);
+}
+
+static void test_mpsc_throughput(void)
+{
+    ring_mpsc_t rb;
+    TEST_ASSERT_EQUAL(ESP_OK, ring_mpsc_create(&rb, sizeof(record_t), MPSC_COUNT, RING_MEM_INTERNAL));
+
+    double t0 = now_s();
+    TEST_ASSERT_TRUE(mpsc_run(&rb, MPSC_BENCH_RECORDS));
+    double elapsed = now_s() - t0;
+
+    double total = (double)MPSC_BENCH_RECORDS * MPSC_PRODUCERS;
+    printf("MPSC: %.0f records from %d producers in %.3f s, %.1f M records/s\n", total, MPSC_PRODUCERS,
+           elapsed, total / elapsed / 1e6);
+    ring_mpsc_delete(&rb);
+}
+
+void app_main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_spsc_rejects_bad_size);
+    RUN_TEST(test_spsc_wrap);
+    RUN_TEST(test_spsc_stress);
+    RUN_TEST(test_spsc_throughput);
+    RUN_TEST(test_mpsc_full_and_empty);
+    RUN_TEST(test_mpsc_stress);
+    RUN_TEST(test_mpsc_throughput);
+    exit(UNITY_END());
+}
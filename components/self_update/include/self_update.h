@@ -0,0 +1,33 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+
+/*
+ * Field update of the recovery app itself (the factory partition).
+ *
+ *   1. The new recovery image is uploaded like a main app, but only staged
+ *      in the OTA target slot (signature, structure and digest verified).
+ *   2. The device boots the staged copy. The running factory app is never
+ *      overwritten in place.
+ *   3. The staged copy programs factory block by block, journaling its
+ *      progress in NVS, verifies the read-back SHA-256 and boots factory.
+ *
+ * A power loss at any point resumes from the journal; until factory is
+ * verified, either the old factory or the staged copy remains bootable.
+ */
+
+/**
+ * @brief Completes an upload opened with ota_manager_begin() as a recovery update.
+ * Checks that the image is a build of this project, journals it and selects
+ * the staged slot for the next boot. The caller reboots.
+ * @return ESP_ERR_INVALID_VERSION if the image is not a recovery app.
+ * @return ESP_ERR_INVALID_SIZE if it does not fit the factory partition.
+ */
+esp_err_t self_update_stage(void);
+
+/**
+ * @brief Continues a journaled update. Call right after storage_init().
+ * @param[out] reboot  true if the caller must restart now.
+ */
+esp_err_t self_update_resume(bool *reboot);
@@ -0,0 +1,268 @@
+#include "self_update.h"
+#include "ota_manager.h"
+#include "storage_manager.h"
+#include "power_manager.h"
+#include "esp_ota_ops.h"
+#include "esp_app_desc.h"
+#include "esp_partition.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "mbedtls/sha256.h"
+#include <string.h>
+
+static const char *TAG = "SELF_UPDATE";
+
+#define JOURNAL_MAGIC 0x31555352 // "RSU1"
+#define COPY_BLOCK (64 * 1024)   // Erase + program unit between journal writes
+#define COPY_CHUNK 4096
+
+typedef enum
+{
+    JOURNAL_STAGED = 1, // Image verified in the slot, not booted yet
+    JOURNAL_COPYING,    // Staged copy is running and programming factory
+    JOURNAL_DONE,       // Factory verified, switching back to it
+} journal_state_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint8_t state; // journal_state_t
+    char slot[17]; // Label of the staging slot
+    uint32_t image_len;
+    uint32_t copied; // Bytes of factory known to be programmed
+    uint8_t sha256[32];
+} journal_t;
+
+/* --- INTERNAL HELPERS --- */
+
+static const esp_partition_t *factory_partition(void)
+{
+    return esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_FACTORY, NULL);
+}
+
+static bool is_recovery_image(const esp_partition_t *part)
+{
+    esp_app_desc_t desc;
+    if (esp_ota_get_partition_description(part, &desc) != ESP_OK)
+        return false;
+    return strncmp(desc.project_name, esp_app_get_description()->project_name, sizeof(desc.project_name)) == 0;
+}
+
+static esp_err_t journal_save(const journal_t *j)
+{
+    return storage_set_selfupdate_journal(j, sizeof(*j));
+}
+
+static esp_err_t partition_sha256(const esp_partition_t *part, size_t len, uint8_t out[32])
+{
+    uint8_t *buf = heap_caps_malloc(COPY_CHUNK, MALLOC_CAP_DEFAULT);
+    if (!buf)
+        return ESP_ERR_NO_MEM;
+
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+
+    esp_err_t err = ESP_OK;
+    for (size_t off = 0; off < len && err == ESP_OK; off += COPY_CHUNK)
+    {
+        size_t n = (len - off < COPY_CHUNK) ? len - off : COPY_CHUNK;
+        err = esp_partition_read(part, off, buf, n);
+        if (err == ESP_OK && mbedtls_sha256_update(&sha, buf, n) != 0)
+            err = ESP_FAIL;
+    }
+    if (err == ESP_OK && mbedtls_sha256_finish(&sha, out) != 0)
+        err = ESP_FAIL;
+
+    mbedtls_sha256_free(&sha);
+    heap_caps_free(buf);
+    return err;
+}
+
+/* Programs factory from j->copied onwards. Each block is erased and
+ * rewritten whole, so resuming never trusts a half-programmed block. */
+static esp_err_t copy_to_factory(journal_t *j, const esp_partition_t *src, const esp_partition_t *factory)
+{
+    uint8_t *buf = heap_caps_malloc(COPY_CHUNK, MALLOC_CAP_DEFAULT);
+    if (!buf)
+        return ESP_ERR_NO_MEM;
+
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = ESP_OK;
+    size_t off = j->copied - (j->copied % COPY_BLOCK);
+
+    while (off < j->image_len && err == ESP_OK)
+    {
+        size_t block = j->image_len - off;
+        if (block > COPY_BLOCK)
+            block = COPY_BLOCK;
+
+        size_t erase_len = (block + factory->erase_size - 1) & ~(factory->erase_size - 1);
+        err = esp_partition_erase_range(factory, off, erase_len);
+
+        for (size_t pos = 0; pos < block && err == ESP_OK; pos += COPY_CHUNK)
+        {
+            size_t n = (block - pos < COPY_CHUNK) ? block - pos : COPY_CHUNK;
+            err = esp_partition_read(src, off + pos, buf, n);
+            if (err == ESP_OK)
+                err = esp_partition_write(factory, off + pos, buf, n);
+        }
+
+        if (err == ESP_OK)
+        {
+            off += block;
+            j->copied = off;
+            err = journal_save(j);
+        }
+    }
+
+    heap_caps_free(buf);
+    if (err == ESP_OK)
+        ESP_LOGI(TAG, "Factory programmed (%u bytes) in %lld ms", (unsigned)j->image_len,
+                 (esp_timer_get_time() - t0) / 1000);
+    return err;
+}
+
+/* --- PUBLIC API --- */
+
+esp_err_t self_update_stage(void)
+{
+    ota_staged_t staged;
+    esp_err_t err = ota_manager_finish_staged(&staged);
+    if (err != ESP_OK)
+        return err;
+
+    const esp_partition_t *factory = factory_partition();
+    if (!factory)
+        return ESP_ERR_NOT_FOUND;
+    if (!is_recovery_image(staged.part))
+    {
+        ESP_LOGE(TAG, "Staged image is not a build of this recovery app.");
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (staged.image_len > factory->size)
+    {
+        ESP_LOGE(TAG, "Image is %u bytes, factory holds %u.", (unsigned)staged.image_len, (unsigned)factory->size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    journal_t j = {
+        .magic = JOURNAL_MAGIC,
+        .state = JOURNAL_STAGED,
+        .image_len = staged.image_len,
+    };
+    strlcpy(j.slot, staged.part->label, sizeof(j.slot));
+    memcpy(j.sha256, staged.sha256, sizeof(j.sha256));
+
+    err = journal_save(&j);
+    if (err != ESP_OK)
+        return err;
+
+    // Booted in pending-verify state: if the new build cannot come up, the
+    // bootloader rolls back to the untouched factory app.
+    err = esp_ota_set_boot_partition(staged.part);
+    if (err != ESP_OK)
+    {
+        storage_clear_selfupdate_journal();
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Recovery update staged in '%s' (%u bytes)", staged.part->label, (unsigned)staged.image_len);
+    return ESP_OK;
+}
+
+esp_err_t self_update_resume(bool *reboot)
+{
+    if (!reboot)
+        return ESP_ERR_INVALID_ARG;
+    *reboot = false;
+
+    journal_t j;
+    if (storage_get_selfupdate_journal(&j, sizeof(j)) != ESP_OK || j.magic != JOURNAL_MAGIC)
+        return ESP_OK;
+
+    j.slot[sizeof(j.slot) - 1] = '\0';
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    const esp_partition_t *factory = factory_partition();
+    const esp_partition_t *staged = esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, j.slot);
+
+    if (!factory || !staged)
+    {
+        ESP_LOGE(TAG, "Journal refers to missing partitions, discarded.");
+        return storage_clear_selfupdate_journal();
+    }
+
+    if (j.state == JOURNAL_DONE)
+    {
+        if (running != factory)
+        {
+            *reboot = true; // Power lost before the switch back
+            return esp_ota_set_boot_partition(factory);
+        }
+
+        // The staging slot holds a recovery build, not a main app; clear it
+        // so nothing mistakes it for one.
+        if (is_recovery_image(staged))
+            esp_partition_erase_range(staged, 0, staged->erase_size);
+        ESP_LOGI(TAG, "Recovery update complete: %s", esp_app_get_description()->version);
+        return storage_clear_selfupdate_journal();
+    }
+
+    if (running == factory)
+    {
+        // The staged build never took over: either power was lost before the
+        // reboot, or it failed and the bootloader rolled back.
+        esp_ota_img_states_t state;
+        if (j.state == JOURNAL_STAGED && j.copied == 0 &&
+            !(esp_ota_get_state_partition(staged, &state) == ESP_OK &&
+              (state == ESP_OTA_IMG_ABORTED || state == ESP_OTA_IMG_INVALID)))
+        {
+            *reboot = true;
+            return esp_ota_set_boot_partition(staged);
+        }
+
+        ESP_LOGE(TAG, "New recovery build failed to start; update abandoned.");
+        return storage_clear_selfupdate_journal();
+    }
+
+    if (running != staged)
+    {
+        ESP_LOGE(TAG, "Running from '%s', journal expects '%s'; discarded.", running->label, j.slot);
+        return storage_clear_selfupdate_journal();
+    }
+
+    // We are the new build and came up: keep the bootloader from rolling
+    // back to a factory partition that is about to be rewritten.
+    esp_ota_mark_app_valid_cancel_rollback();
+
+    ESP_LOGW(TAG, "Installing recovery update into factory (from %u of %u bytes)",
+             (unsigned)j.copied, (unsigned)j.image_len);
+    j.state = JOURNAL_COPYING;
+    power_manager_boost();
+    esp_err_t err = copy_to_factory(&j, staged, factory);
+    uint8_t sha[32];
+    esp_err_t verify = (err == ESP_OK) ? partition_sha256(factory, j.image_len, sha) : err;
+    power_manager_release();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Copy failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    if (verify != ESP_OK || memcmp(sha, j.sha256, sizeof(sha)) != 0)
+    {
+        ESP_LOGE(TAG, "Read-back mismatch, recopying on next boot.");
+        j.copied = 0;
+        journal_save(&j);
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    j.state = JOURNAL_DONE;
+    err = journal_save(&j);
+    if (err == ESP_OK)
+        err = esp_ota_set_boot_partition(factory);
+    if (err == ESP_OK)
+        *reboot = true;
+    return err;
+}
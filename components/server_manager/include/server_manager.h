@@ -7,6 +7,7 @@
  * Registers handlers for:
  * - POST /ota      (Firmware upload)
  * - POST /settings (WiFi Credentials update)
+ * - GET  /heap     (Per-component heap accounting and fragmentation)
  * * @return ESP_OK on success.
  */
 esp_err_t server_start(void);
\ No newline at end of file
@@ -1,16 +1,26 @@
 #include "server_manager.h"
-#include "storage_manager.h"
 #include "auth_manager.h"
+#include "power_manager.h"
 #include "esp_http_server.h"
-#include "esp_ota_ops.h"
+#include "ota_manager.h"
 #include "esp_partition.h"
+#include "golden_library.h"
+#include "self_update.h"
+#include "ota_multicast.h"
+#include "ota_bulk.h"
+#include "peer_share.h"
+#include "recovery_api.h"
 #include "esp_log.h"
-#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "lwip/sockets.h"
 #include "cJSON.h"
+#include "task_plan.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include <stdio.h>
+#include <string.h>
 
-#define MAX_OTA_TIMEOUT_RETRIES 5
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 static const char *TAG = "SERVER_MANAGER";
 
@@ -19,19 +29,167 @@ static const char *TAG = "SERVER_MANAGER";
     do                            \
     {                             \
         ESP_LOGE(TAG, "%s", msg); \
-        httpd_resp_send_500(req); \
-        return ESP_FAIL;          \
+        return send_500(req);     \
     } while (0)
 
-/* --- HELPER: Restart --- */
-static void restart_task(void *param)
+/* --- HELPER: Keep-alive --- */
+
+/* Handler result after answering before the body was read (see HTTP_DRAIN_MAX).
+ * ESP_OK keeps the connection: httpd discards the rest of a small body so the
+ * next request parses. A large upload is dropped with the socket instead. */
+static esp_err_t answered_early(httpd_req_t *req)
+{
+    return req->content_len > HTTP_DRAIN_MAX ? ESP_FAIL : ESP_OK;
+}
+
+static esp_err_t send_500(httpd_req_t *req)
+{
+    if (req->content_len > HTTP_DRAIN_MAX)
+        httpd_resp_set_hdr(req, "Connection", "close");
+    httpd_resp_send_500(req);
+    return answered_early(req);
+}
+
+/* --- HELPER: Sessions ---
+ * open_fn / close_fn bookkeeping (both run on the httpd task, no lock needed).
+ * Admission is refused with a minimal raw response: the client gets a status
+ * instead of a silent reset. Peers are keyed by IPv6 address, IPv4 mapped. */
+typedef struct
+{
+    int fd; // -1 if free
+    uint8_t peer[16];
+} session_slot_t;
+
+#define SESSION_SLOTS (CONFIG_SERVER_MAX_OPEN_SOCKETS + 1)
+
+static session_slot_t s_sessions[SESSION_SLOTS];
+static uint32_t s_shed_low_heap;
+static uint32_t s_shed_per_ip;
+static bool s_low_heap;
+
+static bool peer_key(int sockfd, uint8_t out[16])
+{
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (getpeername(sockfd, (struct sockaddr *)&addr, &len) != 0)
+        return false;
+
+    if (addr.ss_family == AF_INET6)
+    {
+        memcpy(out, &((struct sockaddr_in6 *)&addr)->sin6_addr, 16);
+        return true;
+    }
+    if (addr.ss_family == AF_INET)
+    {
+        static const uint8_t v4_mapped[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+        memcpy(out, v4_mapped, sizeof(v4_mapped));
+        memcpy(out + 12, &((struct sockaddr_in *)&addr)->sin_addr, 4);
+        return true;
+    }
+    return false;
+}
+
+static void shed(int sockfd, const char *status)
 {
-    vTaskDelay(pdMS_TO_TICKS(2000));
-    esp_restart();
+    char msg[128];
+    int len = snprintf(msg, sizeof(msg),
+                       "HTTP/1.1 %s\r\nRetry-After: 5\r\nConnection: close\r\nContent-Length: 0\r\n\r\n", status);
+    send(sockfd, msg, len, 0);
 }
-static void trigger_restart(void)
+
+static esp_err_t session_open(httpd_handle_t hd, int sockfd)
 {
-    xTaskCreate(restart_task, "restart_task", 2048, NULL, 5, NULL);
+    // Memory pressure: keep serving open connections, admit no new ones.
+    size_t free_heap = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    bool low = free_heap < CONFIG_SERVER_MIN_FREE_HEAP_KB * 1024;
+    if (low != s_low_heap)
+    {
+        s_low_heap = low;
+        if (low)
+            ESP_LOGW(TAG, "Low memory (%u bytes free): refusing new connections", (unsigned)free_heap);
+        else
+            ESP_LOGI(TAG, "Memory recovered (%u bytes free): accepting connections", (unsigned)free_heap);
+    }
+    if (low)
+    {
+        s_shed_low_heap++;
+        shed(sockfd, "503 Service Unavailable");
+        return ESP_FAIL;
+    }
+
+    uint8_t peer[16];
+    if (!peer_key(sockfd, peer))
+        return ESP_FAIL;
+
+    int free_slot = -1;
+    int same_peer = 0;
+    for (int i = 0; i < SESSION_SLOTS; i++)
+    {
+        if (s_sessions[i].fd < 0)
+            free_slot = (free_slot < 0) ? i : free_slot;
+        else if (memcmp(s_sessions[i].peer, peer, sizeof(peer)) == 0)
+            same_peer++;
+    }
+
+    if (same_peer >= CONFIG_SERVER_MAX_CONN_PER_IP)
+    {
+        if (s_shed_per_ip++ % 100 == 0) // A flood would otherwise flood the console too
+            ESP_LOGW(TAG, "Connection limit per address reached (%u refused so far)", (unsigned)s_shed_per_ip);
+        shed(sockfd, "429 Too Many Requests");
+        return ESP_FAIL;
+    }
+    if (free_slot < 0)
+        return ESP_FAIL; // Cannot happen: httpd admits at most max_open_sockets
+
+    s_sessions[free_slot].fd = sockfd;
+    memcpy(s_sessions[free_slot].peer, peer, sizeof(peer));
+    return ESP_OK;
+}
+
+static void session_close(httpd_handle_t hd, int sockfd)
+{
+    for (int i = 0; i < SESSION_SLOTS; i++)
+    {
+        if (s_sessions[i].fd == sockfd)
+            s_sessions[i].fd = -1;
+    }
+    close(sockfd); // Owned by close_fn once it is set
+}
+
+static int sessions_open(void)
+{
+    int n = 0;
+    for (int i = 0; i < SESSION_SLOTS; i++)
+        n += (s_sessions[i].fd >= 0);
+    return n;
+}
+
+/* --- HELPER: Responses --- */
+
+/* Last answer before the reboot: the client must not reuse the connection. */
+static esp_err_t send_and_restart(httpd_req_t *req, const char *msg)
+{
+    httpd_resp_set_hdr(req, "Connection", "close");
+    esp_err_t err = httpd_resp_sendstr(req, msg);
+    recovery_api_restart();
+    return err;
+}
+
+/* Sends a recovery_api document and frees it; NULL means it could not be built. */
+static esp_err_t send_json(httpd_req_t *req, cJSON *root)
+{
+    if (!root)
+        FAIL_HTTP(req, "Status unavailable");
+
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (!json)
+        FAIL_HTTP(req, "Out of memory");
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, json);
+    cJSON_free(json);
+    return ESP_OK;
 }
 
 /* --- HANDLERS --- */
@@ -39,7 +197,7 @@ static void trigger_restart(void)
 static esp_err_t settings_post_handler(httpd_req_t *req)
 {
     if (auth_guard(req) != ESP_OK)
-        return ESP_OK;
+        return answered_early(req);
 
     if (req == NULL || req->aux == NULL)
         return ESP_FAIL;
@@ -64,115 +222,548 @@ static esp_err_t settings_post_handler(httpd_req_t *req)
     esp_err_t err = ESP_FAIL;
 
     if (cJSON_IsString(ssid_json) && cJSON_IsString(pass_json))
-    {
-        const char *s_str = ssid_json->valuestring;
-        const char *p_str = pass_json->valuestring;
-        size_t s_len = strlen(s_str);
-        size_t p_len = strlen(p_str);
-
-        // Validate WiFi Constraints (SSID <= 32, Pass <= 64)
-        if (s_len > 0 && s_len <= 32 && p_len <= 64)
-        {
-            err = storage_set_wifi_creds(s_str, p_str);
-        }
-        else
-        {
-            ESP_LOGE(TAG, "Invalid SSID/Pass length");
-        }
-    }
+        err = recovery_api_set_wifi(ssid_json->valuestring, pass_json->valuestring);
 
     cJSON_Delete(root);
 
     if (err == ESP_OK)
     {
-        if (httpd_resp_sendstr(req, "Settings Saved. Rebooting...") != ESP_OK)
+        if (send_and_restart(req, "Settings Saved. Rebooting...") != ESP_OK)
         {
             ESP_LOGE(TAG, "Failed to send response");
         }
-        trigger_restart();
         return ESP_OK;
     }
 
     FAIL_HTTP(req, "Failed to write Settings");
 }
 
+// Unlike FAIL_HTTP, always ESP_FAIL: the caller must not go on to ota_manager_finish().
+#define FAIL_OTA(req, msg)        \
+    do                            \
+    {                             \
+        ESP_LOGE(TAG, "%s", msg); \
+        send_500(req);            \
+        return ESP_FAIL;          \
+    } while (0)
+
+static int http_read(void *ctx, void *buf, size_t len)
+{
+    int received = httpd_req_recv(ctx, buf, len);
+    if (received == HTTPD_SOCK_ERR_TIMEOUT)
+        return 0;
+    return received > 0 ? received : -1; // 0 is a closed socket
+}
+
+/* Opens an OTA session and streams the request body into it.
+ * On failure the session is aborted and the error response already sent. */
+static esp_err_t ota_receive(httpd_req_t *req)
+{
+    esp_err_t err = recovery_api_receive(req->content_len, http_read, req);
+    if (err == ESP_ERR_NOT_FOUND)
+        FAIL_OTA(req, "No OTA Partition found");
+    if (err == ESP_ERR_INVALID_SIZE)
+        FAIL_OTA(req, "Image does not fit the OTA Partition");
+    if (err == ESP_ERR_TIMEOUT || err == ESP_FAIL)
+        return ESP_FAIL; // The socket is gone, nobody to answer
+    if (err != ESP_OK)
+        FAIL_OTA(req, "OTA Receive Failed");
+    return ESP_OK;
+}
+
 static esp_err_t ota_post_handler(httpd_req_t *req)
 {
     if (auth_guard(req) != ESP_OK)
+        return answered_early(req);
+
+    if (ota_receive(req) != ESP_OK)
+        return ESP_FAIL;
+
+    if (ota_manager_finish() != ESP_OK)
+        FAIL_HTTP(req, "OTA Validation Failed");
+
+    recovery_api_log_ota_stats();
+    send_and_restart(req, "Update Success. Rebooting...");
+    return ESP_OK;
+}
+
+/* Field update of this recovery app; see self_update.h for the sequence. */
+static esp_err_t recovery_post_handler(httpd_req_t *req)
+{
+    if (auth_guard(req) != ESP_OK)
+        return answered_early(req);
+
+    if (ota_receive(req) != ESP_OK)
+        return ESP_FAIL;
+
+    if (self_update_stage() != ESP_OK)
+        FAIL_HTTP(req, "Recovery Image Rejected");
+
+    recovery_api_log_ota_stats();
+    send_and_restart(req, "Recovery update staged. Rebooting to install...");
+    return ESP_OK;
+}
+
+/* Lets a client skip the upload when the unit already has the image:
+ * body {"sha256": "<64 hex chars of the plain .bin>"}. */
+static esp_err_t ota_digest_post_handler(httpd_req_t *req)
+{
+    if (auth_guard(req) != ESP_OK)
+        return answered_early(req);
+
+    if (req->content_len <= 0 || req->content_len > 128)
+        FAIL_HTTP(req, "Invalid Content Length");
+
+    char buf[129];
+    int ret = httpd_req_recv(req, buf, MIN(req->content_len, sizeof(buf) - 1));
+    if (ret <= 0)
+        return ESP_FAIL;
+    buf[ret] = '\0';
+
+    cJSON *root = cJSON_Parse(buf);
+    if (!root)
+        FAIL_HTTP(req, "JSON Parse Error");
+
+    uint8_t sha[32];
+    bool valid = false;
+    cJSON *sha_json = cJSON_GetObjectItem(root, "sha256");
+    if (cJSON_IsString(sha_json) && strlen(sha_json->valuestring) == 2 * sizeof(sha))
+    {
+        valid = true;
+        for (size_t i = 0; i < sizeof(sha) && valid; i++)
+            valid = sscanf(sha_json->valuestring + 2 * i, "%2hhx", &sha[i]) == 1;
+    }
+    cJSON_Delete(root);
+
+    if (!valid)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Expected {\"sha256\": \"<hex>\"}");
         return ESP_OK;
+    }
 
-    char buf[1024];
-    esp_ota_handle_t handle = 0;
-    int timeout_retries = 0; // Guard for infinite timeout loop
+    esp_err_t err = ota_manager_activate_installed(sha);
+    httpd_resp_set_type(req, "application/json");
+    if (err == ESP_OK)
+    {
+        send_and_restart(req, "{\"installed\":true}");
+        return ESP_OK;
+    }
+    if (err == ESP_ERR_NOT_FOUND)
+    {
+        httpd_resp_sendstr(req, "{\"installed\":false}");
+        return ESP_OK;
+    }
 
-    const esp_partition_t *part = esp_ota_get_next_update_partition(NULL);
-    if (!part)
-        FAIL_HTTP(req, "No OTA Partition found");
+    FAIL_HTTP(req, "Digest check failed");
+}
 
-    if (part->type != ESP_PARTITION_TYPE_APP)
+static esp_err_t ota_health_get_handler(httpd_req_t *req)
+{
+    if (auth_guard(req) != ESP_OK)
+        return answered_early(req);
+
+    return send_json(req, recovery_api_health_json());
+}
+
+static esp_err_t partitions_get_handler(httpd_req_t *req)
+{
+    if (auth_guard(req) != ESP_OK)
+        return answered_early(req);
+
+    return send_json(req, recovery_api_partitions_json());
+}
+
+static esp_err_t ota_multicast_post_handler(httpd_req_t *req)
+{
+    if (auth_guard(req) != ESP_OK)
+        return answered_early(req);
+
+    char group[INET6_ADDRSTRLEN] = "";
+    int port = 0;
+    int timeout = CONFIG_OTA_MCAST_IDLE_TIMEOUT_SEC;
+    if (req->content_len > 0)
     {
-        FAIL_HTTP(req, "ASSERT FAIL: Target partition is not an APP partition!");
+        char buf[129];
+        if (req->content_len >= sizeof(buf))
+            FAIL_HTTP(req, "Invalid Content Length");
+
+        int ret = httpd_req_recv(req, buf, req->content_len);
+        if (ret <= 0)
+            return ESP_FAIL;
+        buf[ret] = '\0';
+
+        cJSON *root = cJSON_Parse(buf);
+        if (!root)
+            FAIL_HTTP(req, "JSON Parse Error");
+        cJSON *item = cJSON_GetObjectItem(root, "group");
+        if (cJSON_IsString(item))
+            strlcpy(group, item->valuestring, sizeof(group));
+        item = cJSON_GetObjectItem(root, "port");
+        if (cJSON_IsNumber(item))
+            port = item->valueint;
+        item = cJSON_GetObjectItem(root, "timeout");
+        if (cJSON_IsNumber(item))
+            timeout = item->valueint;
+        cJSON_Delete(root);
     }
 
-    if (esp_ota_begin(part, OTA_SIZE_UNKNOWN, &handle) != ESP_OK)
-        FAIL_HTTP(req, "OTA Begin Failed");
+    if (port < 0 || port > 65535 || timeout <= 0)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid port or timeout");
+        return ESP_OK;
+    }
 
-    int remaining = req->content_len;
-    while (remaining > 0)
+    esp_err_t err = ota_multicast_start(group[0] ? group : NULL, port, timeout);
+    if (err == ESP_ERR_INVALID_ARG)
     {
-        int received = httpd_req_recv(req, buf, MIN(remaining, sizeof(buf)));
-        if (received < 0)
-        {
-            if (received == HTTPD_SOCK_ERR_TIMEOUT)
-            {
-                timeout_retries++;
-                if (timeout_retries >= MAX_OTA_TIMEOUT_RETRIES)
-                {
-                    ESP_LOGE(TAG, "OTA Socket Timeout limit reached. Aborting.");
-                    esp_ota_end(handle);
-                    return ESP_FAIL;
-                }
-
-                ESP_LOGW(TAG, "Socket Timeout, retrying... (%d/%d)", timeout_retries, MAX_OTA_TIMEOUT_RETRIES);
-                continue;
-            }
-
-            // Other socket errors are fatal
-            esp_ota_end(handle);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Not a multicast group");
+        return ESP_OK;
+    }
+    if (err == ESP_ERR_INVALID_STATE)
+    {
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "Already listening");
+        return ESP_OK;
+    }
+    if (err != ESP_OK)
+        FAIL_HTTP(req, "Multicast Receiver Start Failed");
+
+    httpd_resp_set_status(req, "202 Accepted");
+    httpd_resp_sendstr(req, "Listening");
+    return ESP_OK;
+}
+
+static esp_err_t ota_bulk_post_handler(httpd_req_t *req)
+{
+    if (auth_guard(req) != ESP_OK)
+        return answered_early(req);
+
+    char buf[65];
+    if (req->content_len == 0 || req->content_len >= sizeof(buf))
+        FAIL_HTTP(req, "Invalid Content Length");
+
+    int ret = httpd_req_recv(req, buf, req->content_len);
+    if (ret <= 0)
+        return ESP_FAIL;
+    buf[ret] = '\0';
+
+    cJSON *root = cJSON_Parse(buf);
+    if (!root)
+        FAIL_HTTP(req, "JSON Parse Error");
+    cJSON *item = cJSON_GetObjectItem(root, "size");
+    double size = cJSON_IsNumber(item) ? item->valuedouble : 0;
+    cJSON_Delete(root);
+
+    if (size < 1 || size > (double)SIZE_MAX)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid size");
+        return ESP_OK;
+    }
+
+    uint16_t port = 0;
+    uint8_t ticket[OTA_BULK_TICKET_LEN];
+    esp_err_t err = ota_bulk_arm((size_t)size, &port, ticket);
+    if (err == ESP_ERR_INVALID_STATE)
+    {
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "Transfer already armed");
+        return ESP_OK;
+    }
+    if (err != ESP_OK)
+        FAIL_HTTP(req, "Bulk Port Open Failed");
+
+    char ticket_hex[2 * OTA_BULK_TICKET_LEN + 1];
+    for (int b = 0; b < OTA_BULK_TICKET_LEN; b++)
+        sprintf(ticket_hex + 2 * b, "%02x", ticket[b]);
+
+    char json[96];
+    snprintf(json, sizeof(json), "{\"port\":%u,\"ticket\":\"%s\"}", port, ticket_hex);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, json);
+    return ESP_OK;
+}
+
+#if CONFIG_PEER_SHARE_SERVE
+#define IMAGE_WINDOW (64 * 1024) // MMU page: app partitions are aligned to it
+
+static esp_err_t send_all(httpd_req_t *req, const void *buf, size_t len)
+{
+    const char *p = buf;
+    while (len > 0)
+    {
+        int sent = httpd_send(req, p, len);
+        if (sent < 0)
+            return ESP_FAIL;
+        p += sent;
+        len -= sent;
+    }
+    return ESP_OK;
+}
+
+/* Peer download, no login: the verified main app exactly as it was uploaded.
+ * Sent straight from the flash cache, one mapped window at a time, so no
+ * RAM copy of the image is needed. Content-Length is exact (ota_fetch needs it). */
+static esp_err_t image_get_handler(httpd_req_t *req)
+{
+    const esp_partition_t *part;
+    ota_image_info_t info;
+    static uint8_t trailer[OTA_SIG_TRAILER_MAX]; // One httpd task: no need for the stack
+    size_t trailer_len = sizeof(trailer);
+    if (peer_share_servable(&part, &info, trailer, &trailer_len) != ESP_OK)
+    {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No verified image to share");
+        return ESP_OK;
+    }
+
+    char head[192];
+    int head_len = snprintf(head, sizeof(head),
+                            "HTTP/1.1 200 OK\r\n"
+                            "Content-Type: application/octet-stream\r\n"
+                            "Content-Length: %lu\r\n"
+                            "X-Image-Version: %s\r\n\r\n",
+                            (unsigned long)(info.image_len + trailer_len), info.version);
+    if (head_len <= 0 || head_len >= (int)sizeof(head))
+        FAIL_HTTP(req, "Header too long");
+
+    power_manager_boost();
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = send_all(req, head, head_len);
+
+    for (size_t ofs = 0; err == ESP_OK && ofs < info.image_len; ofs += IMAGE_WINDOW)
+    {
+        size_t n = MIN(IMAGE_WINDOW, info.image_len - ofs);
+        const void *ptr;
+        esp_partition_mmap_handle_t handle;
+        err = esp_partition_mmap(part, ofs, n, ESP_PARTITION_MMAP_DATA, &ptr, &handle);
+        if (err != ESP_OK)
+            break;
+        err = send_all(req, ptr, n);
+        esp_partition_munmap(handle);
+    }
+    if (err == ESP_OK)
+        err = send_all(req, trailer, trailer_len);
+    power_manager_release();
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Image download to a peer aborted");
+        return ESP_FAIL; // Headers are out: the only signal left is closing the socket
+    }
+
+    int64_t us = esp_timer_get_time() - t0;
+    ESP_LOGI(TAG, "Served '%s' (%lu bytes) in %lld ms", info.version,
+             (unsigned long)(info.image_len + trailer_len), us / 1000);
+    return ESP_OK;
+}
+#endif
+
+/* Installs the image a neighbouring device advertises; body {"sha256": "<hex>"}
+ * picks one, otherwise the first peer found is used. */
+static esp_err_t ota_peer_post_handler(httpd_req_t *req)
+{
+    if (auth_guard(req) != ESP_OK)
+        return answered_early(req);
+
+    uint8_t sha[32];
+    bool want = false;
+    if (req->content_len > 0)
+    {
+        char buf[129];
+        if (req->content_len >= sizeof(buf))
+            FAIL_HTTP(req, "Invalid Content Length");
+
+        int ret = httpd_req_recv(req, buf, req->content_len);
+        if (ret <= 0)
             return ESP_FAIL;
+        buf[ret] = '\0';
+
+        cJSON *root = cJSON_Parse(buf);
+        if (!root)
+            FAIL_HTTP(req, "JSON Parse Error");
+        bool valid = true;
+        cJSON *sha_json = cJSON_GetObjectItem(root, "sha256");
+        if (sha_json)
+        {
+            valid = cJSON_IsString(sha_json) && strlen(sha_json->valuestring) == 2 * sizeof(sha);
+            for (size_t i = 0; i < sizeof(sha) && valid; i++)
+                valid = sscanf(sha_json->valuestring + 2 * i, "%2hhx", &sha[i]) == 1;
+            want = valid;
         }
-        if (received > 0)
+        cJSON_Delete(root);
+
+        if (!valid)
         {
-            timeout_retries = 0;
-            if (received > remaining)
-            {
-                esp_ota_end(handle);
-                FAIL_HTTP(req, "CRITICAL: OTA Buffer Overflow Logic Error");
-            }
-
-            if (esp_ota_write(handle, buf, received) != ESP_OK)
-            {
-                esp_ota_end(handle);
-                FAIL_HTTP(req, "Flash Write Failed");
-            }
-            remaining -= received;
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Expected {\"sha256\": \"<hex>\"}");
+            return ESP_OK;
         }
     }
 
-    if (remaining != 0)
+    esp_err_t err = peer_share_pull(want ? sha : NULL);
+    if (err == ESP_ERR_NOT_FOUND)
     {
-        // This implies we exited the loop but didn't finish
-        esp_ota_end(handle);
-        FAIL_HTTP(req, "OTA Stream Mismatch");
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No peer shares that image");
+        return ESP_OK;
     }
+    if (err != ESP_OK)
+        FAIL_HTTP(req, "Peer Download Failed");
 
-    if (esp_ota_end(handle) != ESP_OK)
-        FAIL_HTTP(req, "OTA Validation Failed");
-    if (esp_ota_set_boot_partition(part) != ESP_OK)
-        FAIL_HTTP(req, "Set Boot Partition Failed");
+    recovery_api_log_ota_stats();
+    send_and_restart(req, "Peer image installed. Rebooting...");
+    return ESP_OK;
+}
+
+static esp_err_t golden_get_handler(httpd_req_t *req)
+{
+    if (auth_guard(req) != ESP_OK)
+        return answered_early(req);
+
+    static golden_index_t index;
+    esp_err_t err = golden_library_get_index(&index);
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+        FAIL_HTTP(req, "Out of memory");
+
+    cJSON_AddBoolToObject(root, "available", err == ESP_OK);
+    cJSON *entries = cJSON_AddArrayToObject(root, "images");
+    for (int i = 0; err == ESP_OK && i < index.count; i++)
+    {
+        const golden_entry_t *e = &index.entries[i];
+        char sha_hex[65];
+        for (int b = 0; b < 32; b++)
+            sprintf(sha_hex + 2 * b, "%02x", e->sha256[b]);
+
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "index", i);
+        cJSON_AddStringToObject(item, "version", e->version);
+        cJSON_AddStringToObject(item, "sha256", sha_hex);
+        cJSON_AddNumberToObject(item, "size", e->image_size);
+        cJSON_AddNumberToObject(item, "compressed_size", e->comp_size);
+        cJSON_AddItemToArray(entries, item);
+    }
+
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (!json)
+        FAIL_HTTP(req, "Out of memory");
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, json);
+    cJSON_free(json);
+    return ESP_OK;
+}
+
+/* Body {"index": n}; defaults to entry 0, the preferred image. */
+static esp_err_t golden_restore_post_handler(httpd_req_t *req)
+{
+    if (auth_guard(req) != ESP_OK)
+        return answered_early(req);
+
+    int idx = 0;
+    if (req->content_len > 0)
+    {
+        char buf[65];
+        if (req->content_len >= sizeof(buf))
+            FAIL_HTTP(req, "Invalid Content Length");
+
+        int ret = httpd_req_recv(req, buf, req->content_len);
+        if (ret <= 0)
+            return ESP_FAIL;
+        buf[ret] = '\0';
+
+        cJSON *root = cJSON_Parse(buf);
+        if (!root)
+            FAIL_HTTP(req, "JSON Parse Error");
+        cJSON *idx_json = cJSON_GetObjectItem(root, "index");
+        if (cJSON_IsNumber(idx_json))
+            idx = idx_json->valueint;
+        cJSON_Delete(root);
+    }
+
+    if (idx < 0)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid index");
+        return ESP_OK;
+    }
+
+    esp_err_t err = golden_library_restore(idx);
+    if (err == ESP_ERR_INVALID_ARG || err == ESP_ERR_NOT_FOUND)
+    {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No such golden image");
+        return ESP_OK;
+    }
+    if (err != ESP_OK)
+        FAIL_HTTP(req, "Golden Restore Failed");
+
+    send_and_restart(req, "Restore Success. Rebooting...");
+    return ESP_OK;
+}
+
+static esp_err_t heap_get_handler(httpd_req_t *req)
+{
+    if (auth_guard(req) != ESP_OK)
+        return answered_early(req);
+
+    cJSON *root = recovery_api_heap_json();
+    if (root)
+    {
+        cJSON *conns = cJSON_AddObjectToObject(root, "connections");
+        cJSON_AddNumberToObject(conns, "open", sessions_open());
+        cJSON_AddNumberToObject(conns, "max", CONFIG_SERVER_MAX_OPEN_SOCKETS);
+        cJSON_AddBoolToObject(conns, "low_memory", s_low_heap);
+        cJSON_AddNumberToObject(conns, "refused_low_memory", s_shed_low_heap);
+        cJSON_AddNumberToObject(conns, "refused_per_address", s_shed_per_ip);
+    }
+    return send_json(req, root);
+}
+
+static esp_err_t power_get_handler(httpd_req_t *req)
+{
+    if (auth_guard(req) != ESP_OK)
+        return answered_early(req);
+
+    return send_json(req, recovery_api_power_json());
+}
+
+static esp_err_t task_plan_get_handler(httpd_req_t *req)
+{
+    if (auth_guard(req) != ESP_OK)
+        return answered_early(req);
+
+    return send_json(req, recovery_api_task_plan_json());
+}
+
+/* Body {"plan": "split" | "shared" | "floating"}; applied after the reboot. */
+static esp_err_t task_plan_post_handler(httpd_req_t *req)
+{
+    if (auth_guard(req) != ESP_OK)
+        return answered_early(req);
+
+    if (req->content_len <= 0 || req->content_len > 64)
+        FAIL_HTTP(req, "Invalid Content Length");
+
+    char buf[65];
+    int ret = httpd_req_recv(req, buf, MIN(req->content_len, sizeof(buf) - 1));
+    if (ret <= 0)
+        return ESP_FAIL;
+    buf[ret] = '\0';
+
+    cJSON *root = cJSON_Parse(buf);
+    if (!root)
+        FAIL_HTTP(req, "JSON Parse Error");
+
+    esp_err_t err = recovery_api_select_plan(cJSON_GetStringValue(cJSON_GetObjectItem(root, "plan")));
+    cJSON_Delete(root);
 
-    httpd_resp_sendstr(req, "Update Success. Rebooting...");
-    trigger_restart();
+    if (err == ESP_ERR_INVALID_ARG)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Expected {\"plan\": \"split|shared|floating\"}");
+        return ESP_OK;
+    }
+    if (err != ESP_OK)
+        FAIL_HTTP(req, "Failed to write Settings");
+
+    send_and_restart(req, "Plan Saved. Rebooting...");
     return ESP_OK;
 }
 
@@ -182,6 +773,21 @@ esp_err_t server_start(void)
     httpd_handle_t server = NULL;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.stack_size = 8192;
+    config.max_uri_handlers = 20;
+    config.max_open_sockets = CONFIG_SERVER_MAX_OPEN_SOCKETS;
+    config.lru_purge_enable = true; // A new client displaces the idlest one instead of waiting
+    config.open_fn = session_open;
+    config.close_fn = session_close;
+    // Drop peers that vanished without a FIN (walked out of AP range) within ~30 s
+    config.keep_alive_enable = true;
+    config.keep_alive_idle = 15;
+    config.keep_alive_interval = 5;
+    config.keep_alive_count = 3;
+    config.core_id = TASK_PLAN_APP_CORE;
+    config.task_priority = TASK_PLAN_HTTPD_PRIORITY;
+
+    for (int i = 0; i < SESSION_SLOTS; i++)
+        s_sessions[i].fd = -1;
 
     if (httpd_start(&server, &config) != ESP_OK)
         return ESP_FAIL;
@@ -191,9 +797,53 @@ esp_err_t server_start(void)
     httpd_uri_t ota_uri = {.uri = "/ota", .method = HTTP_POST, .handler = ota_post_handler};
     httpd_register_uri_handler(server, &ota_uri);
 
+    httpd_uri_t recovery_uri = {.uri = "/ota/recovery", .method = HTTP_POST, .handler = recovery_post_handler};
+    httpd_register_uri_handler(server, &recovery_uri);
+
+    httpd_uri_t digest_uri = {.uri = "/ota/digest", .method = HTTP_POST, .handler = ota_digest_post_handler};
+    httpd_register_uri_handler(server, &digest_uri);
+
+    httpd_uri_t multicast_uri = {.uri = "/ota/multicast", .method = HTTP_POST, .handler = ota_multicast_post_handler};
+    httpd_register_uri_handler(server, &multicast_uri);
+
+    httpd_uri_t bulk_uri = {.uri = "/ota/bulk", .method = HTTP_POST, .handler = ota_bulk_post_handler};
+    httpd_register_uri_handler(server, &bulk_uri);
+
+    httpd_uri_t peer_uri = {.uri = "/ota/peer", .method = HTTP_POST, .handler = ota_peer_post_handler};
+    httpd_register_uri_handler(server, &peer_uri);
+
+    httpd_uri_t health_uri = {.uri = "/ota/health", .method = HTTP_GET, .handler = ota_health_get_handler};
+    httpd_register_uri_handler(server, &health_uri);
+
+    httpd_uri_t partitions_uri = {.uri = "/status/partitions", .method = HTTP_GET, .handler = partitions_get_handler};
+    httpd_register_uri_handler(server, &partitions_uri);
+
+    httpd_uri_t golden_uri = {.uri = "/golden", .method = HTTP_GET, .handler = golden_get_handler};
+    httpd_register_uri_handler(server, &golden_uri);
+
+    httpd_uri_t golden_restore_uri = {.uri = "/golden/restore", .method = HTTP_POST, .handler = golden_restore_post_handler};
+    httpd_register_uri_handler(server, &golden_restore_uri);
+
     httpd_uri_t settings_uri = {.uri = "/settings", .method = HTTP_POST, .handler = settings_post_handler};
     httpd_register_uri_handler(server, &settings_uri);
 
+    httpd_uri_t heap_uri = {.uri = "/heap", .method = HTTP_GET, .handler = heap_get_handler};
+    httpd_register_uri_handler(server, &heap_uri);
+
+    httpd_uri_t power_uri = {.uri = "/power", .method = HTTP_GET, .handler = power_get_handler};
+    httpd_register_uri_handler(server, &power_uri);
+
+    httpd_uri_t plan_uri = {.uri = "/task_plan", .method = HTTP_GET, .handler = task_plan_get_handler};
+    httpd_register_uri_handler(server, &plan_uri);
+
+    httpd_uri_t plan_post_uri = {.uri = "/task_plan", .method = HTTP_POST, .handler = task_plan_post_handler};
+    httpd_register_uri_handler(server, &plan_post_uri);
+
+#if CONFIG_PEER_SHARE_SERVE
+    httpd_uri_t image_uri = {.uri = "/image", .method = HTTP_GET, .handler = image_get_handler};
+    httpd_register_uri_handler(server, &image_uri);
+#endif
+
     ESP_LOGI(TAG, "Server Started.");
     return ESP_OK;
 }
\ No newline at end of file
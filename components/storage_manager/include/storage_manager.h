@@ -2,6 +2,8 @@
 
 #include "esp_err.h"
 #include <stddef.h> // For size_t
+#include <stdbool.h>
+#include <stdint.h>
 
 /**
  * @brief Initializes NVS flash.
@@ -48,4 +50,128 @@ esp_err_t storage_get_session_token(char *buf, size_t max_len);
  * @brief Saves the session token to NVS.
  * Call this only when a NEW login occurs.
  */
-esp_err_t storage_set_session_token(const char *token);
\ No newline at end of file
+esp_err_t storage_set_session_token(const char *token);
+
+/**
+ * @brief Reads the OTA image decryption key (a raw NVS blob).
+ * Provision it per device at manufacturing, e.g. with nvs_partition_gen.
+ * @param[out] key  Buffer of exactly key_len bytes.
+ * @return ESP_OK if a key of key_len bytes was found.
+ * @return ESP_ERR_NVS_NOT_FOUND if no key is provisioned.
+ * @return ESP_ERR_NVS_INVALID_LENGTH if the stored key has a different size.
+ */
+esp_err_t storage_get_ota_key(uint8_t *key, size_t key_len);
+
+/**
+ * @brief Reads the cached digest record of an app slot.
+ * @param[in]  slot  Partition label.
+ * @param[out] rec   Buffer of exactly len bytes.
+ * @return ESP_OK if a record of len bytes was found.
+ */
+esp_err_t storage_get_image_digest(const char *slot, void *rec, size_t len);
+
+/**
+ * @brief Caches the digest record of an app slot.
+ */
+esp_err_t storage_set_image_digest(const char *slot, const void *rec, size_t len);
+
+/**
+ * @brief Reads the signature record kept for an app slot (variable length).
+ * @param[in]    slot  Partition label.
+ * @param[inout] len   In: buffer size. Out: bytes read.
+ */
+esp_err_t storage_get_image_signature(const char *slot, void *buf, size_t *len);
+
+/**
+ * @brief Stores the signature record of an app slot.
+ */
+esp_err_t storage_set_image_signature(const char *slot, const void *buf, size_t len);
+
+/**
+ * @brief Reads and clears the boot-loop flag (app_settings/boot_loop, u8).
+ * The main app sets it before falling back to recovery after repeated crashes.
+ * @param[out] flagged  true if the flag was set.
+ */
+esp_err_t storage_take_boot_loop_flag(bool *flagged);
+
+/**
+ * @brief Number of golden images tried since the last healthy boot.
+ * Reads 0 if never written.
+ */
+esp_err_t storage_get_golden_attempt(uint8_t *attempt);
+
+/**
+ * @brief Saves the number of golden images tried.
+ */
+esp_err_t storage_set_golden_attempt(uint8_t attempt);
+
+/**
+ * @brief Reads the label of the OTA slot the main app was last installed to.
+ * @return ESP_ERR_NVS_NOT_FOUND if nothing was installed through the recovery app yet.
+ */
+esp_err_t storage_get_active_slot(char *buf, size_t max_len);
+
+/**
+ * @brief Records the label of the OTA slot the main app was installed to.
+ */
+esp_err_t storage_set_active_slot(const char *label);
+
+/**
+ * @brief Reads the recovery self-update journal (an opaque blob of exactly len bytes).
+ * @return ESP_ERR_NVS_NOT_FOUND if no update is in progress.
+ */
+esp_err_t storage_get_selfupdate_journal(void *journal, size_t len);
+
+/**
+ * @brief Writes the recovery self-update journal. Committed before returning.
+ */
+esp_err_t storage_set_selfupdate_journal(const void *journal, size_t len);
+
+/**
+ * @brief Removes the recovery self-update journal.
+ */
+esp_err_t storage_clear_selfupdate_journal(void);
+
+/**
+ * @brief Reads the record of the install awaiting its first healthy boot (opaque blob).
+ * @return ESP_ERR_NVS_NOT_FOUND if no install is pending.
+ */
+esp_err_t storage_get_health_pending(void *rec, size_t len);
+
+/**
+ * @brief Records a new pending install and clears the boot stage left by the previous image.
+ */
+esp_err_t storage_set_health_pending(const void *rec, size_t len);
+
+/**
+ * @brief Removes the pending install record.
+ */
+esp_err_t storage_clear_health_pending(void);
+
+/**
+ * @brief Last boot stage reported by the main app (app_settings/hs_stage, u8).
+ * 0 if the main app reported nothing since the install.
+ */
+esp_err_t storage_get_boot_stage(uint8_t *stage);
+
+/**
+ * @brief Reads the outcome of the last install (opaque blob of exactly len bytes).
+ * @return ESP_ERR_NVS_NOT_FOUND if none was recorded.
+ */
+esp_err_t storage_get_health_report(void *report, size_t len);
+
+/**
+ * @brief Saves the outcome of the last install.
+ */
+esp_err_t storage_set_health_report(const void *report, size_t len);
+
+/**
+ * @brief Reads the task placement plan selected at runtime (task_plan_mode_t).
+ * @return ESP_ERR_NVS_NOT_FOUND if none was selected; the Kconfig plan applies.
+ */
+esp_err_t storage_get_task_plan(uint8_t *plan);
+
+/**
+ * @brief Saves the task placement plan used from the next boot.
+ */
+esp_err_t storage_set_task_plan(uint8_t plan);
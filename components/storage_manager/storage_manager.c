@@ -3,6 +3,7 @@
 #include "nvs.h"
 #include "esp_log.h"
 #include <string.h>
+#include <stdio.h>
 
 static const char* TAG = "STORAGE_MANAGER";
 
@@ -12,6 +13,17 @@ static const char* TAG = "STORAGE_MANAGER";
 #define KEY_MASTER_PASS "master_pass"
 #define DEFAULT_MASTER_PASS CONFIG_APP_MASTER_PASSWORD
 #define KEY_SESSION_TOKEN "auth_token"
+#define KEY_OTA_KEY "ota_key"
+#define KEY_BOOT_LOOP "boot_loop"
+#define KEY_GOLDEN_ATTEMPT "golden_try"
+#define KEY_ACTIVE_SLOT "active_slot"
+#define KEY_SELFUPDATE_JOURNAL "rec_journal"
+#define KEY_HEALTH_PENDING "hs_pending"
+#define KEY_HEALTH_REPORT "hs_report"
+#define KEY_TASK_PLAN "task_plan"
+#define KEY_BOOT_STAGE "hs_stage" // Written by the main app, see recovery_handshake.h
+#define KEY_DIGEST_FMT "dg_%.12s" // NVS keys are limited to 15 chars
+#define KEY_SIGNATURE_FMT "sg_%.12s"
 
 // Helper to check error and break the do-while loop
 #define CHECK_BREAK(x)         \
@@ -207,4 +219,420 @@ esp_err_t storage_set_session_token(const char* token)
 
     nvs_close(handle);
     return err;
-}
\ No newline at end of file
+}
+
+esp_err_t storage_get_ota_key(uint8_t* key, size_t key_len)
+{
+    if (!key || key_len == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK)
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    size_t actual_len = 0;
+    err = nvs_get_blob(handle, KEY_OTA_KEY, NULL, &actual_len);
+    if (err == ESP_OK && actual_len != key_len)
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    if (err == ESP_OK)
+        err = nvs_get_blob(handle, KEY_OTA_KEY, key, &actual_len);
+
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_get_image_digest(const char* slot, void* rec, size_t len)
+{
+    if (!slot || !rec || len == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    snprintf(key, sizeof(key), KEY_DIGEST_FMT, slot);
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK)
+        return err;
+
+    size_t actual_len = len;
+    err = nvs_get_blob(handle, key, rec, &actual_len);
+    if (err == ESP_OK && actual_len != len)
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_set_image_digest(const char* slot, const void* rec, size_t len)
+{
+    if (!slot || !rec || len == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    snprintf(key, sizeof(key), KEY_DIGEST_FMT, slot);
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+        return err;
+
+    do
+    {
+        CHECK_BREAK(nvs_set_blob(handle, key, rec, len));
+        CHECK_BREAK(nvs_commit(handle));
+    } while (0);
+
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_get_image_signature(const char* slot, void* buf, size_t* len)
+{
+    if (!slot || !buf || !len)
+        return ESP_ERR_INVALID_ARG;
+
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    snprintf(key, sizeof(key), KEY_SIGNATURE_FMT, slot);
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK)
+        return err;
+
+    err = nvs_get_blob(handle, key, buf, len);
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_set_image_signature(const char* slot, const void* buf, size_t len)
+{
+    if (!slot || !buf || len == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    snprintf(key, sizeof(key), KEY_SIGNATURE_FMT, slot);
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+        return err;
+
+    do
+    {
+        CHECK_BREAK(nvs_set_blob(handle, key, buf, len));
+        CHECK_BREAK(nvs_commit(handle));
+    } while (0);
+
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_take_boot_loop_flag(bool* flagged)
+{
+    if (!flagged)
+        return ESP_ERR_INVALID_ARG;
+    *flagged = false;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+        return err;
+
+    uint8_t value = 0;
+    err = nvs_get_u8(handle, KEY_BOOT_LOOP, &value);
+    if (err == ESP_OK)
+    {
+        *flagged = (value != 0);
+        do
+        {
+            CHECK_BREAK(nvs_erase_key(handle, KEY_BOOT_LOOP));
+            CHECK_BREAK(nvs_commit(handle));
+        } while (0);
+    }
+    else if (err == ESP_ERR_NVS_NOT_FOUND)
+    {
+        err = ESP_OK;
+    }
+
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_get_golden_attempt(uint8_t* attempt)
+{
+    if (!attempt)
+        return ESP_ERR_INVALID_ARG;
+    *attempt = 0;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK)
+        return ESP_OK; // Nothing stored yet
+
+    err = nvs_get_u8(handle, KEY_GOLDEN_ATTEMPT, attempt);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+        err = ESP_OK;
+
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_set_golden_attempt(uint8_t attempt)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+        return err;
+
+    do
+    {
+        CHECK_BREAK(nvs_set_u8(handle, KEY_GOLDEN_ATTEMPT, attempt));
+        CHECK_BREAK(nvs_commit(handle));
+    } while (0);
+
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_get_active_slot(char* buf, size_t max_len)
+{
+    if (!buf || max_len == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK)
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    err = nvs_read_str_helper(handle, KEY_ACTIVE_SLOT, buf, max_len);
+
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_set_active_slot(const char* label)
+{
+    if (!label)
+        return ESP_ERR_INVALID_ARG;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+        return err;
+
+    do
+    {
+        CHECK_BREAK(nvs_set_str(handle, KEY_ACTIVE_SLOT, label));
+        CHECK_BREAK(nvs_commit(handle));
+    } while (0);
+
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_get_selfupdate_journal(void* journal, size_t len)
+{
+    if (!journal || len == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK)
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    size_t actual_len = len;
+    err = nvs_get_blob(handle, KEY_SELFUPDATE_JOURNAL, journal, &actual_len);
+    if (err == ESP_OK && actual_len != len)
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_set_selfupdate_journal(const void* journal, size_t len)
+{
+    if (!journal || len == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+        return err;
+
+    do
+    {
+        CHECK_BREAK(nvs_set_blob(handle, KEY_SELFUPDATE_JOURNAL, journal, len));
+        CHECK_BREAK(nvs_commit(handle));
+    } while (0);
+
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_clear_selfupdate_journal(void)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+        return err;
+
+    err = nvs_erase_key(handle, KEY_SELFUPDATE_JOURNAL);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+        err = ESP_OK;
+    if (err == ESP_OK)
+        err = nvs_commit(handle);
+
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_get_health_pending(void* rec, size_t len)
+{
+    if (!rec || len == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK)
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    size_t actual_len = len;
+    err = nvs_get_blob(handle, KEY_HEALTH_PENDING, rec, &actual_len);
+    if (err == ESP_OK && actual_len != len)
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_set_health_pending(const void* rec, size_t len)
+{
+    if (!rec || len == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+        return err;
+
+    do
+    {
+        CHECK_BREAK(nvs_set_blob(handle, KEY_HEALTH_PENDING, rec, len));
+        // Whatever the previous image reported does not describe this one
+        err = nvs_erase_key(handle, KEY_BOOT_STAGE);
+        if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND)
+            break;
+        CHECK_BREAK(nvs_commit(handle));
+    } while (0);
+
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_clear_health_pending(void)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+        return err;
+
+    err = nvs_erase_key(handle, KEY_HEALTH_PENDING);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+        err = ESP_OK;
+    if (err == ESP_OK)
+        err = nvs_commit(handle);
+
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_get_boot_stage(uint8_t* stage)
+{
+    if (!stage)
+        return ESP_ERR_INVALID_ARG;
+    *stage = 0;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK)
+        return ESP_OK; // Nothing reported yet
+
+    err = nvs_get_u8(handle, KEY_BOOT_STAGE, stage);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+        err = ESP_OK;
+
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_get_health_report(void* report, size_t len)
+{
+    if (!report || len == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK)
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    size_t actual_len = len;
+    err = nvs_get_blob(handle, KEY_HEALTH_REPORT, report, &actual_len);
+    if (err == ESP_OK && actual_len != len)
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_set_health_report(const void* report, size_t len)
+{
+    if (!report || len == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+        return err;
+
+    do
+    {
+        CHECK_BREAK(nvs_set_blob(handle, KEY_HEALTH_REPORT, report, len));
+        CHECK_BREAK(nvs_commit(handle));
+    } while (0);
+
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_get_task_plan(uint8_t* plan)
+{
+    if (!plan)
+        return ESP_ERR_INVALID_ARG;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK)
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    err = nvs_get_u8(handle, KEY_TASK_PLAN, plan);
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t storage_set_task_plan(uint8_t plan)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+        return err;
+
+    do
+    {
+        CHECK_BREAK(nvs_set_u8(handle, KEY_TASK_PLAN, plan));
+        CHECK_BREAK(nvs_commit(handle));
+    } while (0);
+
+    nvs_close(handle);
+    return err;
+}
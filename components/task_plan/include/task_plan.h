@@ -0,0 +1,68 @@
+#pragma once
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+/*
+ * Core/priority plan shared by every task the firmware creates.
+ * Wi-Fi and lwIP live on TASK_PLAN_NET_CORE (pinned via sdkconfig);
+ * the HTTP server and the OTA flash writer go to TASK_PLAN_APP_CORE.
+ * The Kconfig choice is the default; task_plan_select() (POST /task_plan)
+ * stores another plan in NVS, used from the next boot, so plans can be
+ * compared without rebuilding (tools/plan_bench.py).
+ */
+
+typedef enum
+{
+    TASK_PLAN_MODE_SPLIT = 0, // Network on one core, HTTP/OTA on the other
+    TASK_PLAN_MODE_SHARED,    // Network and HTTP/OTA on the same core
+    TASK_PLAN_MODE_FLOATING,  // No affinity (scheduler decides)
+    TASK_PLAN_MODE_MAX,
+} task_plan_mode_t;
+
+#define TASK_PLAN_NET_CORE CONFIG_TASK_PLAN_NET_CORE
+#define TASK_PLAN_APP_CORE task_plan_app_core()
+#define TASK_PLAN_BACKGROUND_CORE task_plan_background_core()
+
+#define TASK_PLAN_HTTPD_PRIORITY CONFIG_TASK_PLAN_HTTPD_PRIORITY
+#define TASK_PLAN_BACKGROUND_PRIORITY CONFIG_TASK_PLAN_BACKGROUND_PRIORITY
+
+/**
+ * @brief Loads the plan selected at runtime and logs the active plan.
+ * Call once at boot, after storage_init() and before any planned task is
+ * created, so throughput logs can be matched to the plan that produced them.
+ */
+void task_plan_init(void);
+
+/**
+ * @brief Plan in effect since boot.
+ */
+task_plan_mode_t task_plan_mode(void);
+
+/**
+ * @brief Stores the plan used from the next boot.
+ * @return ESP_ERR_INVALID_ARG for an unknown plan.
+ */
+esp_err_t task_plan_select(task_plan_mode_t mode);
+
+/**
+ * @brief "split", "shared", "floating"; NULL for an unknown plan.
+ */
+const char *task_plan_name(task_plan_mode_t mode);
+
+/**
+ * @brief Plan for a name from task_plan_name(); TASK_PLAN_MODE_MAX if unknown.
+ */
+task_plan_mode_t task_plan_from_name(const char *name);
+
+/**
+ * @brief Core for the HTTP server, the OTA writer and other transfer tasks.
+ */
+BaseType_t task_plan_app_core(void);
+
+/**
+ * @brief Core for housekeeping tasks (delayed restart, scans, console).
+ */
+BaseType_t task_plan_background_core(void);
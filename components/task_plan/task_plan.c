@@ -0,0 +1,99 @@
+#include "task_plan.h"
+#include "storage_manager.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "TASK_PLAN";
+
+/* The plan only holds if Wi-Fi and lwIP really sit on the network core. */
+#if !CONFIG_FREERTOS_UNICORE
+#if CONFIG_TASK_PLAN_NET_CORE == 0
+#if !CONFIG_ESP_WIFI_TASK_PINNED_TO_CORE_0 || !CONFIG_LWIP_TCPIP_TASK_AFFINITY_CPU0
+#error "TASK_PLAN_NET_CORE is 0: set ESP_WIFI_TASK_PINNED_TO_CORE_0 and LWIP_TCPIP_TASK_AFFINITY_CPU0"
+#endif
+#else
+#if !CONFIG_ESP_WIFI_TASK_PINNED_TO_CORE_1 || !CONFIG_LWIP_TCPIP_TASK_AFFINITY_CPU1
+#error "TASK_PLAN_NET_CORE is 1: set ESP_WIFI_TASK_PINNED_TO_CORE_1 and LWIP_TCPIP_TASK_AFFINITY_CPU1"
+#endif
+#endif
+#endif
+
+#if CONFIG_TASK_PLAN_SPLIT
+#define DEFAULT_MODE TASK_PLAN_MODE_SPLIT
+#elif CONFIG_TASK_PLAN_SHARED
+#define DEFAULT_MODE TASK_PLAN_MODE_SHARED
+#else
+#define DEFAULT_MODE TASK_PLAN_MODE_FLOATING
+#endif
+
+static const char *const s_names[TASK_PLAN_MODE_MAX] = {"split", "shared", "floating"};
+
+// Fixed at boot: tasks already pinned by the old plan would not move.
+static task_plan_mode_t s_mode = DEFAULT_MODE;
+
+/* --- PUBLIC API --- */
+
+void task_plan_init(void)
+{
+    uint8_t saved;
+    if (storage_get_task_plan(&saved) == ESP_OK)
+    {
+        if (saved < TASK_PLAN_MODE_MAX)
+            s_mode = (task_plan_mode_t)saved;
+        else
+            ESP_LOGW(TAG, "Unknown saved plan %u, using the default", saved);
+    }
+
+    ESP_LOGI(TAG, "Plan '%s'%s: net core %d, app core %d, httpd prio %d, background prio %d",
+             s_names[s_mode], s_mode == DEFAULT_MODE ? "" : " (selected at runtime)", TASK_PLAN_NET_CORE,
+             (int)task_plan_app_core(), TASK_PLAN_HTTPD_PRIORITY, TASK_PLAN_BACKGROUND_PRIORITY);
+}
+
+task_plan_mode_t task_plan_mode(void)
+{
+    return s_mode;
+}
+
+esp_err_t task_plan_select(task_plan_mode_t mode)
+{
+    if (mode >= TASK_PLAN_MODE_MAX)
+        return ESP_ERR_INVALID_ARG;
+    return storage_set_task_plan((uint8_t)mode);
+}
+
+const char *task_plan_name(task_plan_mode_t mode)
+{
+    return mode < TASK_PLAN_MODE_MAX ? s_names[mode] : NULL;
+}
+
+task_plan_mode_t task_plan_from_name(const char *name)
+{
+    for (int i = 0; name && i < TASK_PLAN_MODE_MAX; i++)
+    {
+        if (strcmp(name, s_names[i]) == 0)
+            return (task_plan_mode_t)i;
+    }
+    return TASK_PLAN_MODE_MAX;
+}
+
+BaseType_t task_plan_app_core(void)
+{
+    switch (s_mode)
+    {
+    case TASK_PLAN_MODE_SPLIT:
+#if CONFIG_FREERTOS_UNICORE
+        return 0; // A split plan stored over POST /task_plan: there is no second core
+#else
+        return 1 - TASK_PLAN_NET_CORE;
+#endif
+    case TASK_PLAN_MODE_SHARED:
+        return TASK_PLAN_NET_CORE;
+    default:
+        return tskNO_AFFINITY;
+    }
+}
+
+BaseType_t task_plan_background_core(void)
+{
+    return s_mode == TASK_PLAN_MODE_FLOATING ? tskNO_AFFINITY : TASK_PLAN_NET_CORE;
+}
@@ -13,10 +13,13 @@ esp_err_t wifi_manager_init(void);
 /**
  * @brief Attempts to connect to the WiFi credentials found in Storage.
  * This function BLOCKS execution until connection succeeds or fails/times out.
- * * @param[out] out_connected  Set to true if connected, false if failed.
+ * With CONFIG_WIFI_IPV6, a usable IPv6 address plus CONFIG_WIFI_IPV4_GRACE_MS
+ * counts as connected, unless need_ipv4 is set.
+ * @param[in]  need_ipv4      Only a DHCP lease counts (the caller fetches through the router).
+ * @param[out] out_connected  Set to true if connected, false if failed.
  * @return ESP_OK if the attempt logic ran correctly (even if connection failed).
  */
-esp_err_t wifi_manager_try_connect_sta(bool *out_connected);
+esp_err_t wifi_manager_try_connect_sta(bool need_ipv4, bool *out_connected);
 
 /**
  * @brief Starts the Emergency Access Point (SSID: ESP_RECOVERY).
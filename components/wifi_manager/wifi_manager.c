@@ -1,5 +1,6 @@
 #include "wifi_manager.h"
 #include "storage_manager.h"
+#include "event_bus.h"
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
@@ -11,6 +12,7 @@ static const char *TAG = "WIFI_MANAGER";
 
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT BIT1
+#define WIFI_IPV6_BIT BIT2 // Link-local (or SLAAC) address passed DAD
 #define MAX_STA_RETRIES 5
 
 // Error Check Helper
@@ -28,6 +30,23 @@ static const char *TAG = "WIFI_MANAGER";
 static EventGroupHandle_t s_wifi_event_group;
 static int s_retry_num = 0;
 
+#if CONFIG_WIFI_IPV6
+/* Logs every IPv6 address as it becomes usable, on STA and AP alike. */
+static void ip6_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    const ip_event_got_ip6_t *event = data;
+    static const char *const types[] = {"unknown", "global", "link-local", "site-local", "unique local"};
+    esp_ip6_addr_type_t type = esp_netif_ip6_get_addr_type((esp_ip6_addr_t *)&event->ip6_info.ip);
+    ESP_LOGI(TAG, "%s IPv6 address " IPV6STR " (%s)", esp_netif_get_desc(event->esp_netif),
+             IPV62STR(event->ip6_info.ip), (type < sizeof(types) / sizeof(types[0])) ? types[type] : "?");
+}
+
+static void ap_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    esp_netif_create_ip6_linklocal((esp_netif_t *)arg);
+}
+#endif
+
 /* --- Event Handler --- */
 static void sta_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
 {
@@ -41,6 +60,17 @@ static void sta_event_handler(void *arg, esp_event_base_t base, int32_t id, void
     {
         esp_wifi_connect();
     }
+#if CONFIG_WIFI_IPV6
+    else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_CONNECTED)
+    {
+        // Reachable over fe80:: within a second of association, DHCP or not
+        esp_netif_create_ip6_linklocal((esp_netif_t *)arg);
+    }
+    else if (base == IP_EVENT && id == IP_EVENT_GOT_IP6)
+    {
+        xEventGroupSetBits(s_wifi_event_group, WIFI_IPV6_BIT);
+    }
+#endif
     else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_DISCONNECTED)
     {
         if (s_retry_num < 0)
@@ -83,10 +113,13 @@ esp_err_t wifi_manager_init(void)
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     CHECK_RET(esp_wifi_init(&cfg));
 
+#if CONFIG_WIFI_IPV6
+    CHECK_RET(esp_event_handler_register(IP_EVENT, IP_EVENT_GOT_IP6, &ip6_event_handler, NULL));
+#endif
     return ESP_OK;
 }
 
-esp_err_t wifi_manager_try_connect_sta(bool *out_connected)
+esp_err_t wifi_manager_try_connect_sta(bool need_ipv4, bool *out_connected)
 {
     *out_connected = false;
     char ssid[33] = {0};
@@ -108,15 +141,20 @@ esp_err_t wifi_manager_try_connect_sta(bool *out_connected)
 
     esp_event_handler_instance_t instance_any_id = NULL;
     esp_event_handler_instance_t instance_got_ip = NULL;
+    esp_event_handler_instance_t instance_got_ip6 = NULL;
 
     // 3. Execution Block
     do
     {
         // Register Handlers
         CHECK_BREAK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
-                                                        &sta_event_handler, NULL, &instance_any_id));
+                                                        &sta_event_handler, netif, &instance_any_id));
         CHECK_BREAK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
-                                                        &sta_event_handler, NULL, &instance_got_ip));
+                                                        &sta_event_handler, netif, &instance_got_ip));
+#if CONFIG_WIFI_IPV6
+        CHECK_BREAK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_GOT_IP6,
+                                                        &sta_event_handler, netif, &instance_got_ip6));
+#endif
 
         // Configure
         wifi_config_t wifi_config = {0};
@@ -131,14 +169,31 @@ esp_err_t wifi_manager_try_connect_sta(bool *out_connected)
         // Wait
         ESP_LOGI(TAG, "Waiting for WiFi...");
         EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-                                               WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
+                                               WIFI_CONNECTED_BIT | WIFI_FAIL_BIT | (need_ipv4 ? 0 : WIFI_IPV6_BIT),
                                                pdFALSE, pdFALSE, pdMS_TO_TICKS(15000));
 
+#if CONFIG_WIFI_IPV6
+        // IPv6 is up: give DHCP a moment, but do not sit out its timeouts.
+        // The DHCP client keeps running; IPv4 is added whenever it answers.
+        if (!need_ipv4 && (bits & WIFI_IPV6_BIT) && !(bits & (WIFI_CONNECTED_BIT | WIFI_FAIL_BIT)))
+        {
+            bits = xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
+                                       pdFALSE, pdFALSE, pdMS_TO_TICKS(CONFIG_WIFI_IPV4_GRACE_MS));
+            if (!(bits & (WIFI_CONNECTED_BIT | WIFI_FAIL_BIT)))
+            {
+                ESP_LOGW(TAG, "No IPv4 address yet, continuing on IPv6.");
+                bits |= WIFI_CONNECTED_BIT;
+            }
+        }
+#endif
+
         if (bits & WIFI_CONNECTED_BIT)
             *out_connected = true;
 
     } while (0);
 
+    event_bus_publish_simple(*out_connected ? EVENT_WIFI_STA_CONNECTED : EVENT_WIFI_STA_FAILED);
+
     // 4. Cleanup (Always runs, keeping system clean)
     if (!*out_connected)
     {
@@ -150,6 +205,8 @@ esp_err_t wifi_manager_try_connect_sta(bool *out_connected)
         esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, instance_any_id);
     if (instance_got_ip)
         esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, instance_got_ip);
+    if (instance_got_ip6)
+        esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_GOT_IP6, instance_got_ip6);
 
     // Note: We destroy the default Netif implicitly via stop/cleanup or reuse it.
     // ESP-IDF Netif handling is tricky to destroy, but stopping WiFi is the key part.
@@ -159,7 +216,14 @@ esp_err_t wifi_manager_try_connect_sta(bool *out_connected)
 
 esp_err_t wifi_manager_start_ap(void)
 {
-    esp_netif_create_default_wifi_ap();
+    esp_netif_t *netif = esp_netif_create_default_wifi_ap();
+    if (!netif)
+        return ESP_FAIL;
+
+#if CONFIG_WIFI_IPV6
+    // Clients on the AP reach us at fe80:: too (announced over mDNS)
+    CHECK_RET(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_AP_START, &ap_event_handler, netif));
+#endif
 
     wifi_config_t wifi_config = {
         .ap = {
@@ -175,5 +239,6 @@ esp_err_t wifi_manager_start_ap(void)
     CHECK_RET(esp_wifi_start());
 
     ESP_LOGI(TAG, "AP Started.");
+    event_bus_publish_simple(EVENT_WIFI_AP_STARTED);
     return ESP_OK;
 }
\ No newline at end of file
@@ -8,9 +8,25 @@
 #include "wifi_manager.h"
 #include "server_manager.h"
 #include "auth_manager.h"
+#include "task_plan.h"
+#include "event_bus.h"
+#include "heap_monitor.h"
+#include "power_manager.h"
+#include "ota_manager.h"
+#include "golden_library.h"
+#include "self_update.h"
+#include "recovery_mailbox.h"
+#include "ota_fetch.h"
+#include "ota_multicast.h"
+#include "peer_share.h"
+#include "recovery_console.h"
+#include "esp_system.h"
 
 static const char *TAG = "MAIN";
 
+// Supervisor queue: every event published on the bus lands here.
+EVENT_SUBSCRIBER_DEFINE(s_supervisor, 16);
+
 #define REQUIRE(condition, error_code, msg)                                  \
     do                                                                       \
     {                                                                        \
@@ -28,6 +44,10 @@ void app_main(void)
 {
     ESP_LOGI(TAG, "=== RECOVERY MODE STARTING ===");
 
+    // Subscribe before setup so boot-time events (STA result, AP start) are seen.
+    if (event_bus_subscribe(&s_supervisor, EVENT_MASK_ALL) != ESP_OK)
+        ESP_LOGW(TAG, "Supervisor could not subscribe to the event bus.");
+
     esp_err_t status = system_setup();
 
     if (status != ESP_OK)
@@ -47,15 +67,84 @@ void app_main(void)
 
 /**
  * @brief  Initializes all subsystems in a deterministic order.
+ * Runs on the main task, whose stack (CONFIG_ESP_MAIN_TASK_STACK_SIZE, 8 KB)
+ * also carries the TLS handshake of ota_fetch_url(), the signature check of
+ * golden and peer installs, and peer_share_pull().
  */
 static esp_err_t system_setup(void)
 {
     esp_err_t err = ESP_OK;
 
+    // 0. Heap accounting first, so cJSON allocations are attributed from the start
+    err = heap_monitor_init();
+    REQUIRE(err == ESP_OK, err, "Heap Monitor Init Failed");
+
+    // Clock scaling before any boost is taken (self-update resume, scans)
+    err = power_manager_init();
+    REQUIRE(err == ESP_OK, err, "Power Manager Init Failed");
+
     // 1. Initialize Storage (NVS)
     err = storage_init();
     REQUIRE(err == ESP_OK, err, "NVS Init Failed");
 
+    // Placement plan: the Kconfig default or the one selected over POST /task_plan
+    task_plan_init();
+
+    // 1a. RTC mailbox: why we are here (strap, main-app request, boot loop) and what to do
+    recovery_mailbox_t mailbox;
+    if (recovery_mailbox_take(&mailbox) && (mailbox.entry || mailbox.action))
+        ESP_LOGW(TAG, "Mailbox: entry %s, action %s, reason %u",
+                 recovery_mailbox_entry_name(mailbox.entry), recovery_mailbox_action_name(mailbox.action),
+                 mailbox.reason);
+    const recovery_action_t action = (recovery_action_t)mailbox.action;
+
+    // 1b. Finish a recovery self-update before anything else touches flash
+    bool reboot = false;
+    err = self_update_resume(&reboot);
+    if (err != ESP_OK)
+        ESP_LOGW(TAG, "Recovery self-update step failed: %s", esp_err_to_name(err));
+    if (reboot)
+    {
+        ESP_LOGI(TAG, "Recovery self-update: rebooting.");
+        esp_restart();
+    }
+
+    // 1c. Settle the last install's health check; if the new slot failed it, go back to the previous one
+    bool reverted = false;
+    if (ota_manager_check_rollback(&reverted) != ESP_OK)
+        ESP_LOGW(TAG, "Rollback check failed.");
+    if (reverted)
+    {
+        ESP_LOGI(TAG, "Previous main app restored. Rebooting.");
+        esp_restart();
+    }
+
+    // 1d. Network-free recovery: restore a known-good image from local flash
+    bool restored = false;
+    if (action == RECOVERY_ACTION_RESTORE_GOLDEN)
+    {
+        err = golden_library_restore(mailbox.golden_index);
+        recovery_mailbox_post_result(action, err);
+        restored = (err == ESP_OK);
+        if (!restored)
+            ESP_LOGW(TAG, "Requested golden restore failed: %s", esp_err_to_name(err));
+    }
+    else if (golden_library_auto_restore(mailbox.entry == RECOVERY_ENTRY_BOOT_LOOP, &restored) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Golden restore failed, continuing in recovery.");
+    }
+    if (restored)
+    {
+        ESP_LOGI(TAG, "Golden image restored. Rebooting.");
+        esp_restart();
+    }
+
+#if CONFIG_RECOVERY_CONSOLE
+    // 1e. Serial console first: it must work when the network never comes up
+    if (recovery_console_start() != ESP_OK)
+        ESP_LOGW(TAG, "Serial console not started");
+#endif
+
     // 2. Initialize WiFi Hardware
     err = wifi_manager_init();
     REQUIRE(err == ESP_OK, err, "WiFi Init Failed");
@@ -63,19 +152,52 @@ static esp_err_t system_setup(void)
     // 3. Attempt Connection Strategy
     // We try to connect to Station. If that fails, we MUST fall back to AP.
     // We do NOT return error here if STA fails; we recover by starting AP.
+    // The mailbox may already say that nobody is waiting on the router.
     bool is_connected = false;
 
-    err = wifi_manager_try_connect_sta(&is_connected);
+#if CONFIG_PEER_SHARE_AUTO_PULL
+    // Nothing usable to boot: another unit on the segment may have it (step 5).
+    // An empty slot is known right away; a corrupt one once a scan has recorded it.
+    const esp_partition_t *active = ota_manager_active_partition();
+    ota_image_info_t info = {0};
+    if (active)
+        ota_manager_get_image_info(active, &info);
+    const bool peer_pull = (action == RECOVERY_ACTION_NONE) &&
+                           (!active || info.health == OTA_IMAGE_EMPTY || info.health == OTA_IMAGE_CORRUPT);
+#else
+    const bool peer_pull = false;
+#endif
+
+    if (action != RECOVERY_ACTION_AP_ONLY)
+    {
+        // Fetching needs the router's IPv4 and DNS; an IPv6 link-local address is not enough.
+        err = wifi_manager_try_connect_sta(action == RECOVERY_ACTION_FETCH_URL || peer_pull, &is_connected);
 
-    // Check return value of the function itself (did the logic crash?)
-    REQUIRE(err == ESP_OK, err, "WiFi Station Logic Failed");
+        // Check return value of the function itself (did the logic crash?)
+        REQUIRE(err == ESP_OK, err, "WiFi Station Logic Failed");
+    }
 
     if (is_connected)
     {
         ESP_LOGI(TAG, "Connected to Router. Ready for OTA.");
+
+        // 3b. Image URL from the main app: install it and go back
+        if (action == RECOVERY_ACTION_FETCH_URL)
+        {
+            err = ota_fetch_url(mailbox.url);
+            recovery_mailbox_post_result(action, err);
+            if (err == ESP_OK)
+            {
+                ESP_LOGI(TAG, "Fetched image installed. Rebooting.");
+                esp_restart();
+            }
+        }
     }
     else
     {
+        if (action == RECOVERY_ACTION_FETCH_URL)
+            recovery_mailbox_post_result(action, ESP_ERR_INVALID_STATE); // No network to fetch from
+
         ESP_LOGW(TAG, "Could not connect to Router. FALLBACK: Starting AP.");
         err = wifi_manager_start_ap();
         REQUIRE(err == ESP_OK, err, "WiFi AP Start Failed");
@@ -85,18 +207,66 @@ static esp_err_t system_setup(void)
     err = server_start();
     REQUIRE(err == ESP_OK, err, "Web Server Start Failed");
 
+    // Wi-Fi, lwIP and httpd tasks exist now; attribute their allocations.
+    heap_monitor_bind_tasks();
+
+    // Integrity scan of factory and the OTA slots (also feeds POST /ota/digest).
+    if (ota_manager_scan_start() != ESP_OK)
+        ESP_LOGW(TAG, "Integrity scan not started");
+
+    // Advertise our verified image to neighbours (and answer their queries)
+    if (peer_share_start() != ESP_OK)
+        ESP_LOGW(TAG, "mDNS not started, peer sharing off");
+
+#if CONFIG_PEER_SHARE_AUTO_PULL
+    // 5. Pull a usable main app from a peer
+    if (is_connected && peer_pull)
+    {
+        ESP_LOGI(TAG, "No usable main app, looking for a peer to pull from.");
+        if (peer_share_pull(NULL) == ESP_OK)
+        {
+            ESP_LOGI(TAG, "Peer image installed. Rebooting.");
+            esp_restart();
+        }
+    }
+#endif
+
+#if CONFIG_OTA_MCAST_LISTEN_AT_BOOT
+    // Wait for a fleet-wide multicast update, with no idle timeout.
+    if (ota_multicast_start(NULL, 0, 0) != ESP_OK)
+        ESP_LOGW(TAG, "Multicast receiver not started");
+#endif
+
     return ESP_OK;
 }
 
 /**
- * @brief  Main idle loop.
+ * @brief  Main loop. Observer only: logs what the components publish on the event bus.
+ * Each component acts on its own state (restarts, AP fallback); the bus may drop events
+ * when a queue is full, so nothing that must happen is left to this loop.
  */
 static void system_loop(void)
 {
     const int LOOP_DELAY_MS = 1000;
+    event_t event;
 
     while (true)
     {
-        vTaskDelay(pdMS_TO_TICKS(LOOP_DELAY_MS));
+        if (!event_bus_receive(&s_supervisor, &event, pdMS_TO_TICKS(LOOP_DELAY_MS)))
+            continue;
+
+        switch (event.type)
+        {
+        case EVENT_OTA_PROGRESS:
+            ESP_LOGI(TAG, "OTA progress: %lu/%lu bytes",
+                     (unsigned long)event.data.ota.done, (unsigned long)event.data.ota.total);
+            break;
+        case EVENT_OTA_FAILED:
+            ESP_LOGW(TAG, "OTA failed: %s", esp_err_to_name(event.data.result.err));
+            break;
+        default:
+            ESP_LOGI(TAG, "Event: %s", event_bus_type_name(event.type));
+            break;
+        }
     }
 }
\ No newline at end of file
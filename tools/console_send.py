@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""Installs an image over the recovery serial console, when Wi-Fi is not usable.
+
+The image is what POST /ota would take: signed and/or encrypted as the device
+requires. Needs pyserial (installed with ESP-IDF). Close idf.py monitor first.
+
+    python tools/console_send.py --port /dev/ttyUSB0 my_main_app.signed.bin
+
+Sends `recv <size>`, waits for READY, streams the image and prints the
+device's answer: OK (it reboots into the image) or ERR <reason>.
+Log lines the device prints meanwhile are passed through.
+At 115200 baud a 1 MB image takes about 90 s.
+"""
+import argparse
+import os
+import sys
+import time
+
+import serial
+
+CHUNK = 4096
+
+
+def read_line(port, deadline):
+    """One line from the device, or None at the deadline."""
+    buf = b""
+    while time.monotonic() < deadline:
+        c = port.read(1)
+        if not c:
+            continue
+        if c == b"\n":
+            return buf.decode(errors="replace").strip()
+        buf += c
+    return None
+
+
+def wait_for(port, words, timeout):
+    """Echoes device output until a line starts with one of words; returns that line."""
+    deadline = time.monotonic() + timeout
+    while True:
+        line = read_line(port, deadline)
+        if line is None:
+            return None
+        for word in words:
+            i = line.find(word)
+            if i >= 0:  # The prompt may precede it on the same line
+                return line[i:]
+        if line:
+            print(f"  | {line}")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("image")
+    ap.add_argument("--port", required=True, help="Serial port of the console UART")
+    ap.add_argument("--baud", type=int, default=115200, help="CONFIG_ESP_CONSOLE_UART_BAUDRATE")
+    ap.add_argument("--timeout", type=float, default=60, help="Seconds to wait for the final answer")
+    args = ap.parse_args()
+
+    size = os.path.getsize(args.image)
+    with serial.Serial(args.port, args.baud, timeout=0.2) as port, open(args.image, "rb") as f:
+        port.reset_input_buffer()
+        port.write(b"\r\n")  # A fresh prompt, in case of a half typed line
+        port.write(f"recv {size}\r\n".encode())
+
+        line = wait_for(port, ("READY", "ERR", "usage"), 10)
+        if line != "READY":
+            sys.exit(f"device not ready: {line or 'no answer'}")
+
+        start = time.monotonic()
+        sent = 0
+        while True:
+            chunk = f.read(CHUNK)
+            if not chunk:
+                break
+            port.write(chunk)
+            sent += len(chunk)
+            rate = sent / max(time.monotonic() - start, 1e-3) / 1024
+            print(f"\r  {sent}/{size} bytes, {rate:.1f} KB/s", end="", flush=True)
+        port.flush()
+        print()
+
+        line = wait_for(port, ("OK", "ERR"), args.timeout)
+        print(line or "no answer")
+        sys.exit(0 if line == "OK" else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,456 @@
+#!/usr/bin/env python3
+"""Pushes Wi-Fi settings and firmware to many recovery devices in parallel.
+
+Speaks the recovery app's HTTP API: POST /login (session cookie), POST /settings,
+POST /ota/digest and POST /ota. Devices come from --discover (mDNS,
+_recovery._tcp), a hosts file (one address per line) or the command line.
+
+    python tools/fleet.py --discover --password <master> --ota my_main_app.signed.bin
+    python tools/fleet.py --hosts-file units.txt --tokens tokens.json --ssid Plant --wifi-password secret
+
+Each device is driven by its own worker, --jobs at a time. Network errors and
+5xx answers are retried --retries times with backoff. An image a device already
+holds is not uploaded again (POST /ota/digest). A session token stays valid
+across reboots for 30 days: with --tokens, tokens from earlier runs are reused
+and new ones saved, so --password is only needed once per device.
+Settings and an image in one run: the settings go first, then the worker waits
+for the device to come back at the same address before uploading.
+With --bulk the image goes over the bulk port instead (POST /ota/bulk, then a
+bare TCP connection; see components/ota_bulk/include/ota_bulk.h).
+"""
+import argparse
+import concurrent.futures
+import hashlib
+import http.client
+import json
+import select
+import socket
+import struct
+import sys
+import threading
+import time
+
+MDNS_GROUP, MDNS_GROUP6, MDNS_PORT = "224.0.0.251", "ff02::fb", 5353
+SERVICE = "_recovery._tcp.local"
+DNS_A, DNS_PTR, DNS_TXT, DNS_AAAA, DNS_SRV = 1, 12, 16, 28, 33
+SIG_MAGIC = b"RSIG"
+ENC_MAGIC = b"ROTAENC1"
+
+
+class StepError(Exception):
+    def __init__(self, msg, retry=False):
+        super().__init__(msg)
+        self.retry = retry
+
+
+# --- Discovery ---
+
+def dns_name(data, off):
+    """Reads a (possibly compressed) name; returns (name, offset after it)."""
+    labels, end, jumps = [], None, 0
+    while True:
+        n = data[off]
+        if n & 0xC0 == 0xC0:
+            if end is None:
+                end = off + 2
+            off = struct.unpack_from(">H", data, off)[0] & 0x3FFF
+            jumps += 1
+            if jumps > 16:
+                raise ValueError("name loop")
+            continue
+        off += 1
+        if n == 0:
+            return ".".join(labels), end if end is not None else off
+        labels.append(data[off:off + n].decode("utf-8", "replace"))
+        off += n
+
+
+def dns_records(data):
+    """Yields (name, type, rdata offset, rdata length) for every record of a response."""
+    _, flags, qd, an, ns, ar = struct.unpack_from(">HHHHHH", data)
+    if not flags & 0x8000:
+        return
+    off = 12
+    for _ in range(qd):
+        _, off = dns_name(data, off)
+        off += 4
+    for _ in range(an + ns + ar):
+        name, off = dns_name(data, off)
+        rtype, _, _, rdlen = struct.unpack_from(">HHIH", data, off)
+        off += 10
+        yield name, rtype, off, rdlen
+        off += rdlen
+
+
+def discover(seconds, iface=None, iface6=None):
+    """Browses for recovery units; returns [{"host", "port", "name", "ver"}].
+    With iface6 (an interface name) it also browses over IPv6, which finds
+    units without an IPv4 address; those are reached at their link-local one."""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    if iface:
+        sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_IF, socket.inet_aton(iface))
+    sock.bind((iface or "", 0))
+    socks = {sock: (MDNS_GROUP, MDNS_PORT)}
+    if iface6:
+        index = socket.if_nametoindex(iface6)
+        sock6 = socket.socket(socket.AF_INET6, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+        sock6.setsockopt(socket.IPPROTO_IPV6, socket.IPV6_MULTICAST_IF, index)
+        sock6.bind(("", 0))
+        socks[sock6] = (MDNS_GROUP6, MDNS_PORT, 0, index)
+
+    query = struct.pack(">HHHHHH", 0, 0, 1, 0, 0, 0)
+    query += b"".join(bytes([len(p)]) + p.encode() for p in SERVICE.split(".")) + b"\0"
+    query += struct.pack(">HH", DNS_PTR, 0x8001)  # QU: answer by unicast
+
+    instances, srv, txt, addrs, addrs6, sources = set(), {}, {}, {}, {}, {}
+    deadline = time.monotonic() + seconds
+    next_query = 0.0
+    while True:
+        now = time.monotonic()
+        if now >= deadline:
+            break
+        if now >= next_query:
+            for s, group in socks.items():
+                s.sendto(query, group)
+            next_query = now + 1.0
+        ready = select.select(list(socks), [], [], min(deadline, next_query) - now)[0]
+        if not ready:
+            continue
+        data, addr = ready[0].recvfrom(9000)
+        try:
+            for name, rtype, off, rdlen in dns_records(data):
+                if rtype == DNS_PTR and name.lower() == SERVICE:
+                    inst = dns_name(data, off)[0]
+                    instances.add(inst)
+                    sources[inst] = addr[0]
+                elif rtype == DNS_SRV:
+                    port = struct.unpack_from(">H", data, off + 4)[0]
+                    srv[name] = (dns_name(data, off + 6)[0], port)
+                elif rtype == DNS_TXT:
+                    items, p = {}, off
+                    while p < off + rdlen:
+                        n = data[p]
+                        key, _, val = data[p + 1:p + 1 + n].decode("utf-8", "replace").partition("=")
+                        items[key] = val
+                        p += 1 + n
+                    txt[name] = items
+                elif rtype == DNS_A and rdlen == 4:
+                    addrs[name] = socket.inet_ntoa(data[off:off + 4])
+                elif rtype == DNS_AAAA and rdlen == 16 and iface6:
+                    a6 = socket.inet_ntop(socket.AF_INET6, data[off:off + 16])
+                    if a6.startswith("fe80:"):
+                        a6 += "%" + iface6
+                    if name not in addrs6 or not a6.startswith("fe80:"):
+                        addrs6[name] = a6  # A routable address beats the link-local one
+        except (IndexError, struct.error, ValueError):
+            continue  # Malformed answer from some other responder
+
+    units = []
+    for inst in sorted(instances):
+        target, port = srv.get(inst, (None, 80))
+        host = addrs.get(target) or addrs6.get(target) or sources[inst]
+        units.append({"host": host, "port": port,
+                      "name": (target or inst).split(".")[0], "ver": txt.get(inst, {}).get("ver", "")})
+    return units
+
+
+# --- Image ---
+
+def plain_digest(image):
+    """SHA-256 of the plain .bin, as POST /ota/digest expects; None for encrypted images."""
+    if image.startswith(ENC_MAGIC):
+        return None
+    if image.endswith(SIG_MAGIC) and len(image) >= 6:
+        sig_len = struct.unpack_from("<H", image, len(image) - 6)[0]
+        image = image[:len(image) - 6 - sig_len]
+    return hashlib.sha256(image).hexdigest()
+
+
+# --- One device ---
+
+class Device:
+    def __init__(self, args, host, port, token):
+        self.args = args
+        self.host = host
+        self.port = port
+        self.token = token
+        self.attempts = 0
+        self.times = {}
+        self.conn = None
+        self.connections = 0
+        self.requests = 0
+
+    def close(self):
+        if self.conn:
+            self.conn.close()
+            self.conn = None
+
+    def request(self, method, path, body=None, content_type="application/json", keep_alive=True):
+        """One request on the unit's persistent connection, reopened when the server closed it."""
+        headers = {"Content-Type": content_type, "Content-Length": str(len(body or b""))}
+        if self.token:
+            headers["Cookie"] = "access_token=" + self.token
+        for reuse in (True, False):
+            if not keep_alive:
+                self.close()
+            fresh = self.conn is None
+            if fresh:
+                self.conn = http.client.HTTPConnection(self.host, self.port, timeout=self.args.timeout)
+                self.connections += 1
+            try:
+                self.conn.request(method, path, body=body, headers=headers)
+                resp = self.conn.getresponse()
+                text = resp.read().decode("utf-8", "replace")
+            except (http.client.RemoteDisconnected, BrokenPipeError, ConnectionResetError):
+                self.close()
+                if fresh or not reuse:
+                    raise
+                continue  # Idle connection closed by the server before this request: not sent
+            except Exception:
+                self.close()
+                raise
+            self.requests += 1
+            if resp.will_close:
+                self.close()
+            return resp.status, text, resp.getheader("Set-Cookie") or ""
+
+    def step(self, name, fn):
+        """Runs fn with retries; records the time of the successful try."""
+        delay = 1.0
+        for attempt in range(self.args.retries + 1):
+            self.attempts += 1
+            t0 = time.monotonic()
+            try:
+                result = fn()
+                self.times[name] = time.monotonic() - t0
+                return result
+            except (OSError, http.client.HTTPException) as e:
+                err = StepError("%s: %s" % (name, e), retry=True)
+            except StepError as e:
+                err = e
+            if not err.retry or attempt == self.args.retries:
+                raise err
+            time.sleep(delay)
+            delay *= 2
+
+    def call(self, method, path, body=None, content_type="application/json", ok=(200,)):
+        status, text, _ = self.request(method, path, body, content_type)
+        if status == 401 and self.args.password:
+            self.login()
+            status, text, _ = self.request(method, path, body, content_type)
+        if status not in ok:
+            raise StepError("%s %s: HTTP %d %s" % (method, path, status, text.strip()[:80]), retry=status >= 500)
+        return text
+
+    def login(self):
+        if not self.args.password:
+            raise StepError("no token for this device and no --password")
+        self.token = None
+        status, text, cookie = self.request("POST", "/login", json.dumps({"password": self.args.password}).encode())
+        if status != 200 or "access_token=" not in cookie:
+            raise StepError("login: HTTP %d %s" % (status, text.strip()[:80]), retry=status >= 500)
+        self.token = cookie.split("access_token=", 1)[1].split(";", 1)[0]
+
+    def wait_reboot(self):
+        time.sleep(3)  # The device restarts 2 s after answering
+        deadline = time.monotonic() + self.args.reboot_timeout
+        while time.monotonic() < deadline:
+            try:
+                socket.create_connection((self.host, self.port), timeout=2).close()
+                return
+            except OSError:
+                time.sleep(1)
+        raise StepError("did not come back within %d s" % self.args.reboot_timeout)
+
+    def bench(self):
+        """Authenticated request rate, on one connection and with a new connection each."""
+        rates = []
+        for keep_alive in (True, False):
+            t0 = time.monotonic()
+            for _ in range(self.args.bench):
+                status, text, _ = self.request("GET", "/ota/health", keep_alive=keep_alive)
+                if status != 200:
+                    raise StepError("GET /ota/health: HTTP %d %s" % (status, text.strip()[:80]))
+            rates.append(self.args.bench / (time.monotonic() - t0))
+        self.close()
+        return "%.1f req/s keep-alive, %.1f req/s new connections" % tuple(rates)
+
+    def bulk_upload(self, image):
+        """Arms the bulk port, then sends the ticket and the image over it."""
+        info = json.loads(self.call("POST", "/ota/bulk", json.dumps({"size": len(image)}).encode()))
+        with socket.create_connection((self.host, info["port"]), timeout=self.args.timeout) as sock:
+            sock.sendall(bytes.fromhex(info["ticket"]))
+            sock.sendall(image)
+            status = sock.makefile("rb").readline().decode("ascii", "replace").strip()
+        if status != "OK":
+            raise StepError("bulk upload: %s" % (status or "closed without a status"), retry=not status)
+
+    def run(self, image, digest):
+        if not self.token:
+            self.step("login", self.login)
+
+        if self.args.bench:
+            return self.step("bench", self.bench)
+
+        # Settings first: a digest hit or an upload reboots into the main app.
+        if self.args.ssid is not None:
+            body = json.dumps({"ssid": self.args.ssid, "password": self.args.wifi_password}).encode()
+            self.step("settings", lambda: self.call("POST", "/settings", body))
+            if image is None:
+                return "settings saved"
+            self.step("reboot", self.wait_reboot)
+
+        if image is not None and digest and not self.args.no_digest:
+            text = self.step("digest", lambda: self.call("POST", "/ota/digest",
+                                                         json.dumps({"sha256": digest}).encode()))
+            if '"installed":true' in text.replace(" ", ""):
+                return "already installed"
+
+        if image is not None:
+            if self.args.bulk:
+                self.step("upload", lambda: self.bulk_upload(image))
+            else:
+                self.step("upload", lambda: self.call("POST", "/ota", image, "application/octet-stream"))
+            return "installed"
+        return "logged in"
+
+
+# --- Fleet ---
+
+def parse_target(entry):
+    """address[:port]; IPv6 as a bare address or [address%zone]:port."""
+    if entry.startswith("["):
+        host, _, rest = entry[1:].partition("]")
+        port = rest[1:] if rest.startswith(":") else ""
+    elif entry.count(":") > 1:
+        host, port = entry, ""
+    else:
+        host, _, port = entry.partition(":")
+    return {"host": host, "port": int(port or 80), "name": "", "ver": ""}
+
+
+def label(t):
+    """address:port as parse_target() reads it back."""
+    return ("[%s]:%d" if ":" in t["host"] else "%s:%d") % (t["host"], t["port"])
+
+
+def load_targets(args):
+    targets = [parse_target(entry) for entry in args.host]
+    if args.hosts_file:
+        with open(args.hosts_file) as f:
+            for line in f:
+                line = line.split("#", 1)[0].strip()
+                if line:
+                    targets.append(parse_target(line))
+    if args.discover:
+        found = discover(args.discover_time, args.iface, args.iface6)
+        print("discovered %d unit(s)" % len(found))
+        targets += found
+
+    seen, unique = set(), []
+    for t in targets:
+        if (t["host"], t["port"]) not in seen:
+            seen.add((t["host"], t["port"]))
+            unique.append(t)
+    return unique
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host", nargs="*", help="device address[:port], IPv6 as [address%%zone]:port")
+    parser.add_argument("--hosts-file", help="one address[:port] per line, # comments")
+    parser.add_argument("--discover", action="store_true", help="find units over mDNS")
+    parser.add_argument("--discover-time", type=float, default=3.0, help="seconds to browse")
+    parser.add_argument("--iface", help="local IPv4 address to browse on")
+    parser.add_argument("--iface6", metavar="NAME", help="also browse over IPv6 on this interface")
+    parser.add_argument("--password", help="master password (POST /login)")
+    parser.add_argument("--tokens", help="JSON file of session tokens per host, read and updated")
+    parser.add_argument("--ssid", help="Wi-Fi network to store (POST /settings)")
+    parser.add_argument("--wifi-password", default="")
+    parser.add_argument("--ota", metavar="IMAGE", help="image to install, as POST /ota takes it")
+    parser.add_argument("--bulk", action="store_true", help="upload over the bulk port instead of POST /ota")
+    parser.add_argument("--no-digest", action="store_true", help="always upload, skip POST /ota/digest")
+    parser.add_argument("-j", "--jobs", type=int, default=8, help="devices handled at once")
+    parser.add_argument("--retries", type=int, default=2)
+    parser.add_argument("--timeout", type=float, default=120.0, help="seconds per request")
+    parser.add_argument("--reboot-timeout", type=int, default=60)
+    parser.add_argument("--bench", type=int, default=0, metavar="N",
+                        help="only measure: N requests on one connection, then N on new connections")
+    parser.add_argument("--report", help="write the per-device report as JSON")
+    args = parser.parse_args()
+
+    if args.ssid is not None and not 0 < len(args.ssid.encode()) <= 32 or len(args.wifi_password.encode()) > 64:
+        sys.exit("--ssid must be 1..32 bytes and --wifi-password at most 64")
+    if args.jobs < 1:
+        sys.exit("--jobs must be at least 1")
+
+    image = digest = None
+    if args.ota:
+        with open(args.ota, "rb") as f:
+            image = f.read()
+        digest = plain_digest(image)
+
+    targets = load_targets(args)
+    if not targets:
+        sys.exit("no devices: give addresses, --hosts-file or --discover")
+
+    tokens = {}
+    if args.tokens:
+        try:
+            with open(args.tokens) as f:
+                tokens = json.load(f)
+        except FileNotFoundError:
+            pass
+    lock = threading.Lock()
+
+    def work(t):
+        key = label(t)
+        dev = Device(args, t["host"], t["port"], tokens.get(key))
+        t0 = time.monotonic()
+        try:
+            result, ok = dev.run(image, digest), True
+        except StepError as e:
+            result, ok = str(e), False
+        dev.close()
+        if dev.token:
+            with lock:
+                tokens[key] = dev.token
+        return dict(t, ok=ok, result=result, attempts=dev.attempts, total=time.monotonic() - t0,
+                    requests=dev.requests, connections=dev.connections,
+                    steps={k: round(v, 3) for k, v in dev.times.items()})
+
+    t0 = time.monotonic()
+    print("%d device(s), %d at a time" % (len(targets), args.jobs))
+    rows = []
+    with concurrent.futures.ThreadPoolExecutor(max_workers=args.jobs) as pool:
+        for row in pool.map(work, targets):
+            rows.append(row)
+            print("  %-21s %s" % (label(row), "ok" if row["ok"] else "FAILED"), flush=True)
+
+    if args.tokens:
+        with open(args.tokens, "w") as f:
+            json.dump(tokens, f, indent=1, sort_keys=True)
+
+    print("\n%-21s %-8s %7s %8s %8s %9s %7s %4s %7s  %s" %
+          ("device", "result", "login", "settings", "upload", "KB/s", "total", "try", "req/con", "detail"))
+    for r in rows:
+        s = r["steps"]
+        upload = s.get("upload")
+        rate = "%.0f" % (len(image) / 1024.0 / upload) if upload else "-"
+        print("%-21s %-8s %7s %8s %8s %9s %6.1fs %4d %7s  %s" %
+              (label(r), "ok" if r["ok"] else "FAILED",
+               "%.2fs" % s["login"] if "login" in s else "-",
+               "%.2fs" % s["settings"] if "settings" in s else "-",
+               "%.1fs" % upload if upload else "-", rate, r["total"], r["attempts"],
+               "%d/%d" % (r["requests"], r["connections"]), r["result"]))
+
+    failed = sum(not r["ok"] for r in rows)
+    print("\n%d ok, %d failed, %.0f s wall time" % (len(rows) - failed, failed, time.monotonic() - t0))
+    if args.report:
+        with open(args.report, "w") as f:
+            json.dump(rows, f, indent=1)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,235 @@
+#!/usr/bin/env python3
+"""Sends one image to every recovery device listening on a multicast group.
+
+Devices listen after POST /ota/multicast (or from boot with
+CONFIG_OTA_MCAST_LISTEN_AT_BOOT). The image is what POST /ota would take:
+signed and/or encrypted as the devices require.
+
+    python tools/mcast_send.py --devices 12 my_main_app.signed.bin
+    python tools/mcast_send.py --group ff02::7701 --iface wlan0 --devices 12 my_main_app.signed.bin
+
+Each round sends an announce (SHA-256 of the image), then every group still
+missing somewhere: k data blocks plus r Cauchy Reed-Solomon repair blocks,
+any k of which rebuild the group. Devices answer each round end with the
+groups they miss, and the next round resends only the union of those.
+Wire format: components/ota_multicast/include/ota_multicast.h.
+"""
+import argparse
+import hashlib
+import random
+import select
+import socket
+import struct
+import sys
+import time
+
+MAGIC = 0x31434D52  # "RMC1"
+REPORT_MAGIC = 0x52434D52  # "RMCR"
+HDR_FMT = "<IIIHBBBBHI"
+REPORT_FMT = "<IIIB3xiI"
+PKT_ANNOUNCE, PKT_BLOCK, PKT_ROUND_END = 0, 1, 2
+STATES = ("receiving", "complete", "installed", "failed")
+MIN_BLOCK, MAX_BLOCK = 256, 1408
+MAX_K, MAX_R = 32, 8
+GF_POLY = 0x11D
+ROUND_END_REPEATS = 3
+
+
+def gf_tables():
+    exp, log = [0] * 512, [0] * 256
+    x = 1
+    for i in range(255):
+        exp[i] = x
+        log[x] = i
+        x <<= 1
+        if x & 0x100:
+            x ^= GF_POLY
+    for i in range(255, 512):
+        exp[i] = exp[i - 255]
+    return exp, log
+
+
+GF_EXP, GF_LOG = gf_tables()
+_mul_rows = {}
+
+
+def mul_row(c):
+    """Translation table for bytes.translate(): v -> c * v in GF(2^8)."""
+    if c not in _mul_rows:
+        _mul_rows[c] = bytes(GF_EXP[GF_LOG[c] + GF_LOG[v]] if v else 0 for v in range(256))
+    return _mul_rows[c]
+
+
+def coef(k, j, i):
+    """Weight of data block i in repair block j: 1 / ((k + j) ^ i), as on the device."""
+    return GF_EXP[255 - GF_LOG[(k + j) ^ i]]
+
+
+def repair_blocks(data, k, r):
+    """r repair blocks for one group of data blocks (all the same length)."""
+    size = len(data[0])
+    out = []
+    for j in range(r):
+        acc = 0
+        for i, block in enumerate(data):
+            acc ^= int.from_bytes(block.translate(mul_row(coef(k, j, i))), "little")
+        out.append(acc.to_bytes(size, "little"))
+    return out
+
+
+class Sender:
+    def __init__(self, args, image):
+        self.args = args
+        self.image = image
+        self.session = random.getrandbits(32)
+        self.bs = args.block_size
+        padded = image + b"\0" * (-len(image) % self.bs)
+        self.blocks = [padded[i:i + self.bs] for i in range(0, len(padded), self.bs)]
+        self.n_groups = (len(self.blocks) + args.k - 1) // args.k
+        self.repair = {}
+        self.sent = 0
+        self.dropped = 0
+        self.next_send = time.perf_counter()
+
+        if ":" in args.group:
+            # Link-scope groups (ff02::) need the interface; devices answer from link-local addresses.
+            index = socket.if_nametoindex(args.iface) if args.iface else 0
+            self.dest = (args.group, args.port, 0, index)
+            self.sock = socket.socket(socket.AF_INET6, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+            self.sock.setsockopt(socket.IPPROTO_IPV6, socket.IPV6_MULTICAST_HOPS, args.ttl)
+            self.sock.setsockopt(socket.IPPROTO_IPV6, socket.IPV6_MULTICAST_LOOP, 1)
+            if index:
+                self.sock.setsockopt(socket.IPPROTO_IPV6, socket.IPV6_MULTICAST_IF, index)
+            self.sock.bind(("", 0))
+        else:
+            self.dest = (args.group, args.port)
+            self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+            self.sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, args.ttl)
+            self.sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_LOOP, 1)
+            if args.iface:
+                self.sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_IF, socket.inet_aton(args.iface))
+            self.sock.bind((args.iface or "", 0))
+
+    def packet(self, ptype, index, group, payload):
+        hdr = struct.pack(HDR_FMT, MAGIC, self.session, len(self.image), self.bs, self.args.k, self.args.r,
+                          ptype, index, len(payload), group)
+        return hdr + payload
+
+    def send(self, pkt, droppable=True):
+        # Paced to --rate: access points send multicast at a low basic rate.
+        delay = self.next_send - time.perf_counter()
+        if delay > 0:
+            time.sleep(delay)
+        self.next_send = max(self.next_send, time.perf_counter()) + len(pkt) / (self.args.rate * 1024.0)
+        if droppable and random.random() < self.args.loss:
+            self.dropped += 1
+            return
+        self.sock.sendto(pkt, self.dest)
+        self.sent += 1
+
+    def send_group(self, g):
+        k = self.args.k
+        data = self.blocks[g * k:(g + 1) * k]
+        if g not in self.repair:
+            self.repair[g] = repair_blocks(data, k, self.args.r)
+        for i, block in enumerate(data):
+            self.send(self.packet(PKT_BLOCK, i, g, block))
+        for j, block in enumerate(self.repair[g]):
+            self.send(self.packet(PKT_BLOCK, k + j, g, block))
+
+    def collect(self, devices, seconds):
+        """Reads reports for this session; returns {address: missing group ids} of this window."""
+        missing = {}
+        deadline = time.monotonic() + seconds
+        while True:
+            left = deadline - time.monotonic()
+            if left <= 0 or not select.select([self.sock], [], [], left)[0]:
+                return missing
+            data, addr = self.sock.recvfrom(4096)
+            head = struct.calcsize(REPORT_FMT)
+            if len(data) < head:
+                continue
+            magic, session, rnd, state, result, count = struct.unpack_from(REPORT_FMT, data)
+            if magic != REPORT_MAGIC or session != self.session or state >= len(STATES):
+                continue
+            ids = struct.unpack_from("<%dI" % ((len(data) - head) // 4), data, head)
+            devices[addr[0]] = (STATES[state], result, count)
+            if STATES[state] == "receiving":
+                missing[addr[0]] = ids
+
+
+def finished(devices, expected):
+    done = [d for d in devices.values() if d[0] in ("installed", "failed")]
+    return len(devices) >= expected and len(done) == len(devices)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--group", default="239.255.77.1", help="CONFIG_OTA_MCAST_GROUP, IPv4 or IPv6")
+    parser.add_argument("--port", type=int, default=5007, help="CONFIG_OTA_MCAST_PORT")
+    parser.add_argument("--iface", help="interface to send on: local IPv4 address, or its name for an IPv6 group")
+    parser.add_argument("--ttl", type=int, default=1)
+    parser.add_argument("--block-size", type=int, default=1024)
+    parser.add_argument("-k", type=int, default=16, help="data blocks per group")
+    parser.add_argument("-r", type=int, default=4, help="repair blocks per group")
+    parser.add_argument("--rate", type=float, default=100, help="send rate in KB/s")
+    parser.add_argument("--devices", type=int, default=1, help="devices expected to report")
+    parser.add_argument("--rounds", type=int, default=10)
+    parser.add_argument("--wait", type=float, default=2.0, help="seconds to collect reports after a round")
+    parser.add_argument("--install-wait", type=float, default=90.0,
+                        help="seconds to wait for install results once nothing is missing")
+    parser.add_argument("--loss", type=float, default=0.0, help="drop this fraction of blocks (testing)")
+    parser.add_argument("image")
+    args = parser.parse_args()
+
+    if not MIN_BLOCK <= args.block_size <= MAX_BLOCK:
+        sys.exit("--block-size must be %d..%d" % (MIN_BLOCK, MAX_BLOCK))
+    if not 1 <= args.k <= MAX_K or not 0 <= args.r <= MAX_R:
+        sys.exit("-k must be 1..%d and -r 0..%d" % (MAX_K, MAX_R))
+
+    with open(args.image, "rb") as f:
+        image = f.read()
+
+    tx = Sender(args, image)
+    print("session %08x: %d bytes, %d groups of %d+%d x %d bytes to %s port %d" %
+          (tx.session, len(image), tx.n_groups, args.k, args.r, args.block_size, args.group, args.port))
+
+    devices = {}
+    missing = set(range(tx.n_groups))
+    t0 = time.monotonic()
+
+    for rnd in range(1, args.rounds + 1):
+        tx.send(tx.packet(PKT_ANNOUNCE, 0, 0, hashlib.sha256(image).digest()), droppable=False)
+        for g in sorted(missing):
+            tx.send_group(g)
+        for _ in range(ROUND_END_REPEATS):
+            tx.send(tx.packet(PKT_ROUND_END, 0, rnd, b""), droppable=False)
+
+        reports = tx.collect(devices, args.wait)
+        missing = set()
+        for ids in reports.values():
+            missing.update(ids)
+        if len(devices) < args.devices:
+            missing = set(range(tx.n_groups))  # Someone has not been heard from yet
+        print("round %d: %d groups resent next, %d of %d devices reporting (%.0f s)" %
+              (rnd, len(missing), len(devices), args.devices, time.monotonic() - t0))
+
+        if not missing or finished(devices, args.devices):
+            break
+
+    deadline = time.monotonic() + args.install_wait
+    while not finished(devices, args.devices) and time.monotonic() < deadline:
+        tx.collect(devices, 1.0)
+
+    print("%d packets sent, %d dropped on purpose, %.0f s" % (tx.sent, tx.dropped, time.monotonic() - t0))
+    for addr, (state, result, count) in sorted(devices.items()):
+        detail = " (error 0x%x)" % (result & 0xFFFFFFFF) if state == "failed" else ""
+        detail += " (%d groups missing)" % count if state == "receiving" else ""
+        print("  %-25s %s%s" % (addr, state, detail))
+
+    ok = len(devices) >= args.devices and all(d[0] == "installed" for d in devices.values())
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
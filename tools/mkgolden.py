@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""Builds the golden image library partition for the recovery app.
+
+Each input is a main-app .bin as it would be uploaded to POST /ota (signed with
+tools/ota_sign.py when CONFIG_OTA_SIGNATURE_VERIFY is on). List the preferred
+image first; automatic restore tries them in order.
+
+    python tools/mkgolden.py --size 4096K -o golden.bin app_v3.signed.bin app_v2.signed.bin
+    parttool.py write_partition --partition-name golden --input golden.bin
+
+Layout: index sector (see components/golden_library/include/golden_library.h),
+then zlib-compressed images, each 4 KB aligned.
+"""
+import argparse
+import hashlib
+import struct
+import sys
+import zlib
+
+MAGIC = 0x42494C47  # "GLIB"
+FORMAT = 1
+MAX_ENTRIES = 8
+SECTOR = 0x1000
+ENTRY_FMT = "<32s32sIIII"
+APP_DESC_OFFSET = 0x20  # image header (24) + first segment header (8)
+APP_DESC_MAGIC = 0xABCD5432
+SIG_MAGIC = b"RSIG"
+
+
+def parse_size(text):
+    text = text.strip().upper()
+    for suffix, mult in (("K", 1024), ("M", 1024 * 1024)):
+        if text.endswith(suffix):
+            return int(text[:-1], 0) * mult
+    return int(text, 0)
+
+
+def plain_image(data):
+    """Strips the signature trailer, if any: the index SHA is over the plain .bin."""
+    if data.endswith(SIG_MAGIC):
+        sig_len = struct.unpack("<H", data[-6:-4])[0]
+        return data[:-(6 + sig_len)]
+    return data
+
+
+def app_version(image):
+    magic, = struct.unpack_from("<I", image, APP_DESC_OFFSET)
+    if magic != APP_DESC_MAGIC:
+        sys.exit("not an ESP-IDF app image (no app descriptor)")
+    version = image[APP_DESC_OFFSET + 16:APP_DESC_OFFSET + 48]
+    return version.split(b"\0", 1)[0]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--size", required=True, help="partition size, e.g. 4096K")
+    parser.add_argument("-o", "--output", required=True)
+    parser.add_argument("images", nargs="+")
+    args = parser.parse_args()
+
+    if len(args.images) > MAX_ENTRIES:
+        sys.exit("at most %d images" % MAX_ENTRIES)
+
+    size = parse_size(args.size)
+    blob = bytearray()
+    entries = []
+    offset = SECTOR
+
+    for path in args.images:
+        with open(path, "rb") as f:
+            data = f.read()
+        plain = plain_image(data)
+        comp = zlib.compress(data, 9)
+
+        entries.append(struct.pack(ENTRY_FMT, app_version(plain), hashlib.sha256(plain).digest(),
+                                   offset, len(comp), len(data), 0))
+        blob += comp
+        pad = (-len(comp)) % SECTOR
+        blob += b"\xff" * pad
+        print("%-40s %8d -> %8d bytes at 0x%06x" % (path, len(data), len(comp), offset))
+        offset += len(comp) + pad
+
+    if offset > size:
+        sys.exit("library needs %d bytes, partition has %d" % (offset, size))
+
+    index = struct.pack("<IHH", MAGIC, FORMAT, len(entries)) + b"".join(entries)
+    index += b"\0" * (struct.calcsize(ENTRY_FMT) * (MAX_ENTRIES - len(entries)))
+    index += struct.pack("<I", zlib.crc32(index) & 0xFFFFFFFF)
+
+    with open(args.output, "wb") as f:
+        f.write(index + b"\xff" * (SECTOR - len(index)) + blob)
+
+    print("%s: %d images, %d of %d bytes used" % (args.output, len(entries), offset, size))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
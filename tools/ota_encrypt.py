@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+"""Encrypts a firmware .bin for upload to the recovery app's POST /ota.
+
+Output layout: b"ROTAENC1" | IV (12) | AES-256-GCM ciphertext | tag (16).
+The magic is authenticated as associated data.
+
+    pip install cryptography
+    python tools/ota_encrypt.py --genkey ota_key.bin
+    python tools/ota_encrypt.py --key ota_key.bin my_main_app.bin my_main_app.enc
+
+Provision the same 32-byte key into NVS (namespace "app_settings", blob "ota_key")
+or set it as CONFIG_OTA_FLEET_KEY (hex).
+"""
+import argparse
+import os
+import sys
+
+from cryptography.hazmat.primitives.ciphers.aead import AESGCM
+
+MAGIC = b"ROTAENC1"
+KEY_LEN = 32
+IV_LEN = 12
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--genkey", metavar="KEY_FILE", help="write a new random key and exit")
+    parser.add_argument("--key", metavar="KEY_FILE", help="32-byte raw key")
+    parser.add_argument("input", nargs="?")
+    parser.add_argument("output", nargs="?")
+    args = parser.parse_args()
+
+    if args.genkey:
+        with open(args.genkey, "wb") as f:
+            f.write(os.urandom(KEY_LEN))
+        with open(args.genkey, "rb") as f:
+            print("CONFIG_OTA_FLEET_KEY=\"%s\"" % f.read().hex())
+        return 0
+
+    if not (args.key and args.input and args.output):
+        parser.error("--key, input and output are required")
+
+    with open(args.key, "rb") as f:
+        key = f.read()
+    if len(key) != KEY_LEN:
+        sys.exit("key must be %d bytes, got %d" % (KEY_LEN, len(key)))
+
+    with open(args.input, "rb") as f:
+        image = f.read()
+
+    iv = os.urandom(IV_LEN)
+    sealed = AESGCM(key).encrypt(iv, image, MAGIC)  # ciphertext | tag
+
+    with open(args.output, "wb") as f:
+        f.write(MAGIC + iv + sealed)
+
+    print("%s: %d -> %d bytes" % (args.output, len(image), len(MAGIC) + len(iv) + len(sealed)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""Appends a signature trailer to a firmware .bin for the recovery app's POST /ota.
+
+Output layout: image | signature (DER) | sig_len (u16 LE) | b"RSIG".
+The signature is over SHA-256(image); ECDSA and RSA keys both work.
+Sign first, then encrypt (tools/ota_encrypt.py) if needed.
+
+    python tools/ota_sign.py --key keys/ota_signing_dev.pem my_main_app.bin my_main_app.signed.bin
+
+--genkey writes a new P-256 key pair, KEY_FILE and KEY_FILE with _pub before
+the extension (the half CONFIG_OTA_SIGNING_PUBKEY points at). The build runs
+it once for the development pair in keys/.
+
+Needs the openssl command line tool.
+"""
+import argparse
+import os
+import struct
+import subprocess
+import sys
+
+MAGIC = b"RSIG"
+SIG_MAX_LEN = 512
+
+
+def genkey(path):
+    stem, ext = os.path.splitext(path)
+    pub = stem + "_pub" + (ext or ".pem")
+    if os.path.dirname(path):
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+    old_mask = os.umask(0o077)  # Private half readable by the owner only
+    try:
+        subprocess.run(["openssl", "ecparam", "-name", "prime256v1", "-genkey", "-noout", "-out", path], check=True)
+    finally:
+        os.umask(old_mask)
+    subprocess.run(["openssl", "ec", "-in", path, "-pubout", "-out", pub], check=True, stderr=subprocess.DEVNULL)
+    print("%s: private key\n%s: public key" % (path, pub))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--genkey", metavar="KEY_FILE", help="write a new key pair and exit")
+    parser.add_argument("--key", help="private key (PEM)")
+    parser.add_argument("input", nargs="?")
+    parser.add_argument("output", nargs="?")
+    args = parser.parse_args()
+
+    if args.genkey:
+        genkey(args.genkey)
+        return 0
+
+    if not (args.key and args.input and args.output):
+        parser.error("--key, input and output are required")
+
+    with open(args.input, "rb") as f:
+        image = f.read()
+
+    sig = subprocess.run(["openssl", "dgst", "-sha256", "-sign", args.key],
+                         input=image, stdout=subprocess.PIPE, check=True).stdout
+    if not 0 < len(sig) <= SIG_MAX_LEN:
+        sys.exit("unexpected signature length %d" % len(sig))
+
+    with open(args.output, "wb") as f:
+        f.write(image + sig + struct.pack("<H", len(sig)) + MAGIC)
+
+    print("%s: %d bytes + %d byte signature" % (args.output, len(image), len(sig)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""Compares task placement plans on one recovery device: OTA throughput and request latency.
+
+For each plan it selects the plan (POST /task_plan, the device reboots),
+measures the latency of --requests authenticated GET /ota/health calls on one
+keep-alive connection, then uploads --uploads copies of the image with its last
+byte flipped. The device receives and programs the whole stream, rejects it in
+ota_manager_finish() and stays in recovery, so the upload rate is measured
+without installing anything. The target slot is overwritten: use a bench unit.
+
+    python tools/plan_bench.py --password <master> --image my_main_app.bin 192.168.4.1
+
+The plan that was active at the start is selected again at the end.
+Device-side figures (flash time, worst stall) are in the `OTA:` log lines.
+"""
+import argparse
+import json
+import statistics
+import sys
+import time
+
+from fleet import Device, StepError, parse_target
+
+PLANS = ("split", "shared", "floating")
+
+
+def select_plan(dev, plan):
+    dev.call("POST", "/task_plan", json.dumps({"plan": plan}).encode())
+    dev.close()
+    dev.wait_reboot()
+    active = json.loads(dev.call("GET", "/task_plan"))["plan"]
+    if active != plan:
+        raise StepError("asked for plan %s, device runs %s" % (plan, active))
+
+
+def latency(dev, n):
+    """Per-request milliseconds on one keep-alive connection."""
+    samples = []
+    for _ in range(n):
+        t0 = time.monotonic()
+        dev.call("GET", "/ota/health")
+        samples.append((time.monotonic() - t0) * 1000)
+    dev.close()
+    samples.sort()
+    return statistics.median(samples), samples[min(len(samples) - 1, int(len(samples) * 0.95))]
+
+
+def upload_rate(dev, image):
+    """KB/s of one full upload that the device rejects at the end."""
+    t0 = time.monotonic()
+    status, text, _ = dev.request("POST", "/ota", image, "application/octet-stream", keep_alive=False)
+    elapsed = time.monotonic() - t0
+    dev.close()
+    if status != 500:
+        raise StepError("expected the corrupted image to be rejected, got HTTP %d %s" % (status, text.strip()[:80]))
+    return len(image) / 1024 / elapsed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host", help="device address[:port]")
+    parser.add_argument("--password", required=True, help="master password (POST /login)")
+    parser.add_argument("--image", required=True, help="image as POST /ota takes it; sent corrupted")
+    parser.add_argument("--plans", default=",".join(PLANS), help="comma separated, default all")
+    parser.add_argument("--requests", type=int, default=50, help="latency samples per plan")
+    parser.add_argument("--uploads", type=int, default=3, help="uploads per plan")
+    parser.add_argument("--timeout", type=float, default=120.0, help="seconds per request")
+    parser.add_argument("--reboot-timeout", type=int, default=60)
+    args = parser.parse_args()
+    args.retries = 0
+
+    plans = [p.strip() for p in args.plans.split(",") if p.strip()]
+    if not plans or any(p not in PLANS for p in plans):
+        sys.exit("--plans takes %s" % ", ".join(PLANS))
+    with open(args.image, "rb") as f:
+        image = bytearray(f.read())
+    image[-1] ^= 0xFF  # Fails the final check, after the whole stream was programmed
+
+    t = parse_target(args.host)
+    dev = Device(args, t["host"], t["port"], None)
+    rows = []
+    try:
+        dev.login()
+        initial = json.loads(dev.call("GET", "/task_plan"))["plan"]
+        for plan in plans:
+            print("plan %s ..." % plan, flush=True)
+            if plan != initial or rows:
+                select_plan(dev, plan)
+            median, p95 = latency(dev, args.requests)
+            rates = [upload_rate(dev, bytes(image)) for _ in range(args.uploads)]
+            rows.append((plan, median, p95, statistics.mean(rates), min(rates)))
+        if plans[-1] != initial:
+            select_plan(dev, initial)
+    except (StepError, OSError) as e:
+        sys.exit("%s: %s" % (args.host, e))
+
+    print("\n%-9s %12s %10s %12s %10s" % ("plan", "median ms", "p95 ms", "mean KB/s", "min KB/s"))
+    for plan, median, p95, mean_rate, min_rate in rows:
+        print("%-9s %12.1f %10.1f %12.1f %10.1f" % (plan, median, p95, mean_rate, min_rate))
+
+
+if __name__ == "__main__":
+    main()